@@ -0,0 +1,251 @@
+/*
+ * asset_image.c
+ *
+ * Builds an assets partition in RAM for tests. Art is given as strings, one
+ * char per pixel, row by row:
+ *   '#' is white
+ *   '+' is black
+ *   '.' is transparent in bitmaps and black in gifs
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include "asset_image.h"
+#include "fastlz.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define MAX_ASSETS 16
+#define ASSET_NAME_LEN 16
+// Each index item is a 16 byte name, an address and a length
+#define ASSET_INDEX_WORDS ((ASSET_NAME_LEN / sizeof(uint32_t)) + 2)
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    char name[ASSET_NAME_LEN];
+    uint32_t* words;
+    uint32_t numWords;
+    uint32_t len;
+} imageAsset_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+// Read by assets.c instead of memory mapped flash
+extern uint32_t* hostAssetPartition;
+
+static imageAsset_t imageAssets[MAX_ASSETS];
+static uint8_t numImageAssets = 0;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Forget every asset added so far
+ */
+void assetImageReset(void)
+{
+    uint8_t i;
+    for(i = 0; i < numImageAssets; i++)
+    {
+        free(imageAssets[i].words);
+    }
+    numImageAssets = 0;
+    free(hostAssetPartition);
+    hostAssetPartition = NULL;
+}
+
+/**
+ * @brief Append bits to a word buffer, most significant bit first
+ *
+ * @param words  The buffer, which must be zeroed and big enough
+ * @param bitIdx The bit to write next, advanced past the written bits
+ * @param bits   The bits to append, right aligned
+ * @param n      The number of bits to append
+ */
+static void appendBits(uint32_t* words, uint32_t* bitIdx, uint32_t bits, uint8_t n)
+{
+    while(n--)
+    {
+        if(bits & (1 << n))
+        {
+            words[*bitIdx / 32] |= (0x80000000 >> (*bitIdx % 32));
+        }
+        (*bitIdx)++;
+    }
+}
+
+/**
+ * @brief Add a bitmap. Each pixel is coded as 1 for black, 00 for white or
+ * 01 for transparent
+ *
+ * @param name The asset name
+ * @param w    The width
+ * @param h    The height
+ * @param art  w * h chars of art
+ * @return true if it was added, false if there are too many assets
+ */
+bool assetImageAddBitmap(const char* name, uint16_t w, uint16_t h, const char* art)
+{
+    if(numImageAssets >= MAX_ASSETS)
+    {
+        return false;
+    }
+    imageAsset_t* asset = &imageAssets[numImageAssets++];
+    strncpy(asset->name, name, ASSET_NAME_LEN);
+
+    // Two words of size, then at most two bits per pixel
+    asset->numWords = 2 + (((2 * w * h) + 31) / 32);
+    asset->words = (uint32_t*)calloc(asset->numWords, sizeof(uint32_t));
+    asset->words[0] = w;
+    asset->words[1] = h;
+
+    uint32_t bitIdx = 0;
+    uint32_t i;
+    for(i = 0; i < (uint32_t)(w * h); i++)
+    {
+        switch(art[i])
+        {
+            case '+':
+            {
+                appendBits(&asset->words[2], &bitIdx, 0x1, 1);
+                break;
+            }
+            case '#':
+            {
+                appendBits(&asset->words[2], &bitIdx, 0x0, 2);
+                break;
+            }
+            default:
+            {
+                appendBits(&asset->words[2], &bitIdx, 0x1, 2);
+                break;
+            }
+        }
+    }
+    asset->len = asset->numWords * sizeof(uint32_t);
+    return true;
+}
+
+/**
+ * @brief Pack a frame of art into bits, most significant bit first, 1 is white
+ *
+ * @param art   w * h chars of art
+ * @param n     The number of pixels
+ * @param frame The bytes to pack into, which must be big enough
+ * @param size  The size of frame, in bytes
+ */
+static void packFrame(const char* art, uint32_t n, uint8_t* frame, uint32_t size)
+{
+    memset(frame, 0, size);
+    uint32_t i;
+    for(i = 0; i < n; i++)
+    {
+        if('#' == art[i])
+        {
+            frame[i / 8] |= (0x80 >> (i % 8));
+        }
+    }
+}
+
+/**
+ * @brief Add a gif. The first frame is compressed whole, every other frame is
+ * compressed as the XOR with the frame before it
+ *
+ * @param name     The asset name
+ * @param w        The width
+ * @param h        The height
+ * @param duration The milliseconds per frame
+ * @param nFrames  The number of frames
+ * @param frames   nFrames strings of w * h chars of art
+ * @return true if it was added, false if there are too many assets
+ */
+bool assetImageAddGif(const char* name, uint16_t w, uint16_t h, uint16_t duration,
+                      uint16_t nFrames, const char* const* frames)
+{
+    if(numImageAssets >= MAX_ASSETS)
+    {
+        return false;
+    }
+    imageAsset_t* asset = &imageAssets[numImageAssets++];
+    strncpy(asset->name, name, ASSET_NAME_LEN);
+
+    // Same size as gifHandle.allocedSize
+    uint32_t frameSize = ((w * h) + 8) / 8;
+    // fastlz needs 5% more, and at least 66 bytes
+    uint32_t maxCompressed = frameSize + (frameSize / 16) + 66;
+
+    asset->numWords = 4 + (nFrames * (1 + ((maxCompressed + 3) / 4)));
+    asset->words = (uint32_t*)calloc(asset->numWords, sizeof(uint32_t));
+    asset->words[0] = w;
+    asset->words[1] = h;
+    asset->words[2] = nFrames;
+    asset->words[3] = duration;
+
+    uint8_t* prior = (uint8_t*)calloc(frameSize, 1);
+    uint8_t* curr = (uint8_t*)calloc(frameSize, 1);
+    uint8_t* delta = (uint8_t*)calloc(frameSize, 1);
+    uint32_t idx = 4;
+    uint16_t f;
+    for(f = 0; f < nFrames; f++)
+    {
+        packFrame(frames[f], w * h, curr, frameSize);
+        uint32_t i;
+        for(i = 0; i < frameSize; i++)
+        {
+            delta[i] = (0 == f) ? curr[i] : (curr[i] ^ prior[i]);
+        }
+
+        int cLen = fastlz_compress(delta, frameSize, &asset->words[idx + 1]);
+        asset->words[idx] = cLen;
+        idx += 1 + ((cLen + 3) / 4);
+        memcpy(prior, curr, frameSize);
+    }
+    free(prior);
+    free(curr);
+    free(delta);
+
+    asset->numWords = idx;
+    asset->len = idx * sizeof(uint32_t);
+    return true;
+}
+
+/**
+ * @brief Lay out the index and the assets, then point assets.c at them
+ */
+void assetImageLoad(void)
+{
+    uint32_t totalWords = 1 + (numImageAssets * ASSET_INDEX_WORDS);
+    uint8_t i;
+    for(i = 0; i < numImageAssets; i++)
+    {
+        totalWords += imageAssets[i].numWords;
+    }
+
+    free(hostAssetPartition);
+    hostAssetPartition = (uint32_t*)calloc(totalWords, sizeof(uint32_t));
+    hostAssetPartition[0] = numImageAssets;
+
+    uint32_t dataIdx = 1 + (numImageAssets * ASSET_INDEX_WORDS);
+    for(i = 0; i < numImageAssets; i++)
+    {
+        uint32_t* entry = &hostAssetPartition[1 + (i * ASSET_INDEX_WORDS)];
+        memcpy(entry, imageAssets[i].name, ASSET_NAME_LEN);
+        // The address is in bytes from the start of the partition
+        entry[4] = dataIdx * sizeof(uint32_t);
+        entry[5] = imageAssets[i].len;
+        memcpy(&hostAssetPartition[dataIdx], imageAssets[i].words,
+               imageAssets[i].numWords * sizeof(uint32_t));
+        dataIdx += imageAssets[i].numWords;
+    }
+}
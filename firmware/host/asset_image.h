@@ -0,0 +1,19 @@
+/*
+ * asset_image.h
+ *
+ * Builds an assets partition in RAM for tests, in the same format as the
+ * asset packer, so assets.c can read it like memory mapped flash
+ */
+
+#ifndef _ASSET_IMAGE_H_
+#define _ASSET_IMAGE_H_
+
+#include <c_types.h>
+
+void assetImageReset(void);
+bool assetImageAddBitmap(const char* name, uint16_t w, uint16_t h, const char* art);
+bool assetImageAddGif(const char* name, uint16_t w, uint16_t h, uint16_t duration,
+                      uint16_t nFrames, const char* const* frames);
+void assetImageLoad(void);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * bench_colorchord.c
+ *
+ * Throughput benchmarks for ColorChord. Each clip is filtered by the front
+ * end model first, then run through ColorChord a frame at a time, timing
+ * PushSamples32(), HandleFrameInfo() and both output drivers separately.
+ * Cycles are the host's time stamp counter, so only compare them against
+ * other host runs, not against the ESP8266.
+ *
+ * Usage: bench_colorchord <clip.wav> ...
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define HAVE_CYCLES 1
+#else
+    #define HAVE_CYCLES 0
+#endif
+
+#include "wav.h"
+#include "cc_pipeline.h"
+#include "embeddedout.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+// Each clip is run this many times, to time more than a few hundred frames
+#define BENCH_PASSES 20
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef enum
+{
+    STAGE_PUSH,
+    STAGE_FRAME,
+    STAGE_LINEAR,
+    STAGE_SAME,
+    NUM_STAGES
+} benchStage_t;
+
+typedef struct
+{
+    uint64_t ns;
+    uint64_t cycles;
+} benchTime_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static const char* const stageNames[NUM_STAGES] =
+{
+    "PushSamples32",
+    "HandleFrameInfo",
+    "UpdateLinearLEDs",
+    "UpdateAllSameLEDs",
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @return A monotonic time in nanoseconds
+ */
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
+}
+
+/**
+ * @return The time stamp counter, or 0 if the host doesn't have one
+ */
+static uint64_t nowCycles(void)
+{
+#if HAVE_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Start timing a stage
+ *
+ * @param t Returns the start time
+ */
+static void stageStart(benchTime_t* t)
+{
+    t->ns = nowNs();
+    t->cycles = nowCycles();
+}
+
+/**
+ * @brief Stop timing a stage and add the time to its total
+ *
+ * @param start The time from stageStart()
+ * @param total The stage's total
+ */
+static void stageEnd(const benchTime_t* start, benchTime_t* total)
+{
+    total->cycles += nowCycles() - start->cycles;
+    total->ns += nowNs() - start->ns;
+}
+
+/**
+ * @brief Run a clip through ColorChord, adding the time of each stage to the
+ * totals
+ *
+ * @param samples The front end's samples
+ * @param n       The number of samples
+ * @param totals  The time spent in each stage, NUM_STAGES long
+ * @return The number of samples pushed
+ */
+static uint32_t runClip(const int16_t* samples, uint32_t n, benchTime_t* totals)
+{
+    benchTime_t start;
+    uint32_t pushed = 0;
+    for(pushed = 0; pushed + CC_FRAME_SAMPLES <= n; pushed += CC_FRAME_SAMPLES)
+    {
+        stageStart(&start);
+        PushSamples32(&samples[pushed], CC_FRAME_SAMPLES);
+        stageEnd(&start, &totals[STAGE_PUSH]);
+
+        stageStart(&start);
+        HandleFrameInfo();
+        stageEnd(&start, &totals[STAGE_FRAME]);
+
+        stageStart(&start);
+        UpdateLinearLEDs();
+        stageEnd(&start, &totals[STAGE_LINEAR]);
+
+        stageStart(&start);
+        UpdateAllSameLEDs();
+        stageEnd(&start, &totals[STAGE_SAME]);
+    }
+    return pushed;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s <clip.wav> ...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    benchTime_t totals[NUM_STAGES] = {{0}};
+    uint64_t totalSamples = 0;
+    int arg;
+    for(arg = 1; arg < argc; arg++)
+    {
+        wav_t wav;
+        if(!wavRead(argv[arg], &wav) || CC_SAMPLE_RATE != wav.sampleRate)
+        {
+            fprintf(stderr, "%s: not a 16 bit mono PCM WAV at %u Hz\n", argv[arg],
+                    (unsigned int)CC_SAMPLE_RATE);
+            wavFree(&wav);
+            return EXIT_FAILURE;
+        }
+
+        // The front end is a model of the mic, not part of ColorChord, so it
+        // isn't timed
+        int16_t* samples = (int16_t*)malloc(wav.numSamples * sizeof(int16_t));
+        ccPipelineInit();
+        uint32_t i;
+        for(i = 0; i + CC_FRAME_SAMPLES <= wav.numSamples; i += CC_FRAME_SAMPLES)
+        {
+            ccFrontEnd(&wav.samples[i], &samples[i], CC_FRAME_SAMPLES);
+        }
+
+        uint8_t pass;
+        for(pass = 0; pass < BENCH_PASSES; pass++)
+        {
+            ccPipelineInit();
+            totalSamples += runClip(samples, wav.numSamples, totals);
+        }
+        free(samples);
+        wavFree(&wav);
+    }
+
+#if CC_USE_FFT32
+    printf("bench_colorchord: FFT32, ");
+#else
+    printf("bench_colorchord: DFT32, ");
+#endif
+    printf("%u samples a frame, %llu samples, real time is %u samples/s\n",
+           (unsigned int)CC_FRAME_SAMPLES, (unsigned long long)totalSamples,
+           (unsigned int)CC_SAMPLE_RATE);
+    printf("%-18s %12s %14s %14s\n", "stage", "ns/frame", "cycles/sample", "samples/s");
+
+    uint64_t frames = totalSamples / CC_FRAME_SAMPLES;
+    benchTime_t all = {0};
+    uint8_t s;
+    for(s = 0; s <= NUM_STAGES; s++)
+    {
+        const benchTime_t* t = &all;
+        const char* name = "total";
+        if(s < NUM_STAGES)
+        {
+            t = &totals[s];
+            name = stageNames[s];
+            all.ns += t->ns;
+            all.cycles += t->cycles;
+        }
+        printf("%-18s %12.0f %14.1f %14.0f\n", name,
+               (double)t->ns / frames,
+               HAVE_CYCLES ? (double)t->cycles / totalSamples : 0.0,
+               (double)totalSamples * 1e9 / (double)t->ns);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,503 @@
+/*
+ * bench_oled.c
+ *
+ * Bytes per frame benchmarks for the display code. Each scenario draws a
+ * sequence of frames the way a mode would, flushes every frame by difference
+ * to the emulated OLED and reports the I2C traffic. The host time is only a
+ * rough guide, the traffic is what the Swadge pays for
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "oled_emu.h"
+#include "asset_image.h"
+#include "wav.h"
+#include "cc_pipeline.h"
+
+#include "oled.h"
+#include "sprite.h"
+#include "font.h"
+#include "bresenham.h"
+#include "assets.h"
+#include "mode_waterfall.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define BENCH_FRAMES 1000
+
+// The framebuffer, to check fills against each other
+extern uint8_t currentFb[];
+
+// Cheapest possible full update, one byte of display RAM per column per page
+#define FULL_FRAME_DATA (OLED_WIDTH * (OLED_HEIGHT / 8))
+
+// One column of display RAM, a byte per page
+#define COLUMN_DATA (OLED_HEIGHT / 8)
+
+// The waterfall is fed this clip, over and over
+#define WATERFALL_CLIP "clips/sweep.wav"
+
+// The size of colorchord's king.png, and how far it turns each frame
+#define KING_W 37
+#define KING_H 42
+#define KING_STEP_DEG 4
+#define ROT_SPINS 20
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    const char* name;
+    void (*setup)(void);
+    void (*frame)(uint32_t f);
+} benchScenario_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static const sprite_t benchSprite =
+{
+    .width = 8,
+    .height = 8,
+    .data =
+    {
+        0x3C, 0x42, 0xA5, 0x81, 0xA5, 0x99, 0x42, 0x3C,
+    },
+};
+
+static wav_t waterfallClip;
+static uint32_t waterfallClipPos;
+
+// Filled in by makeKingArt()
+static char kingArt[(KING_W * KING_H) + 1];
+
+//==============================================================================
+// Scenarios
+//==============================================================================
+
+static void setupBlank(void)
+{
+    clearDisplay();
+}
+
+static void setupBusy(void)
+{
+    clearDisplay();
+    plotText(0, 0, "SCORE", IBM_VGA_8, WHITE);
+    plotRect(0, 16, 127, 63, WHITE);
+    int16_t x;
+    for(x = 4; x < 124; x += 8)
+    {
+        plotLine(x, 20, 127 - x, 59, WHITE);
+    }
+}
+
+/**
+ * Everything changes, every frame
+ */
+static void frameInvert(uint32_t f)
+{
+    fillDisplayArea(0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1, INVERSE);
+}
+
+/**
+ * An 8x8 sprite bouncing around a blank display
+ */
+static void frameSprite(uint32_t f)
+{
+    static int16_t x = 0, y = 0, dx = 1, dy = 1;
+    plotSprite(x, y, &benchSprite, BLACK);
+    if(x + dx < 0 || x + dx > OLED_WIDTH - 8)
+    {
+        dx = -dx;
+    }
+    if(y + dy < 0 || y + dy > OLED_HEIGHT - 8)
+    {
+        dy = -dy;
+    }
+    x += dx;
+    y += dy;
+    plotSprite(x, y, &benchSprite, WHITE);
+}
+
+/**
+ * A counter redrawn over a busy frame
+ */
+static void frameScore(uint32_t f)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%05u", (unsigned int)f);
+    fillDisplayArea(60, 0, OLED_WIDTH - 1, 13, BLACK);
+    plotText(60, 0, text, IBM_VGA_8, WHITE);
+}
+
+/**
+ * Two counters at either end of the same rows, like a game's score and timer
+ */
+static void frameTwoCounters(uint32_t f)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%03u", (unsigned int)(f % 1000));
+    fillDisplayArea(0, 0, 23, 7, BLACK);
+    plotText(0, 0, text, TOM_THUMB, WHITE);
+    snprintf(text, sizeof(text), "%03u", (unsigned int)((f / 3) % 1000));
+    fillDisplayArea(104, 0, OLED_WIDTH - 1, 7, BLACK);
+    plotText(104, 0, text, TOM_THUMB, WHITE);
+}
+
+/**
+ * The menu bar grows a pixel per frame, then starts again
+ */
+static void frameMenuBar(uint32_t f)
+{
+    if(OLED_WIDTH - 1 == (f % OLED_WIDTH))
+    {
+        zeroMenuBar();
+    }
+    else
+    {
+        incrementMenuBar();
+    }
+}
+
+/**
+ * Random boxes, like the test's random flushes
+ */
+static void frameRandom(uint32_t f)
+{
+    if(0 == rand() % 5)
+    {
+        clearDisplay();
+    }
+    int16_t x1 = rand() % OLED_WIDTH;
+    int16_t y1 = rand() % OLED_HEIGHT;
+    fillDisplayArea(x1, y1, x1 + (rand() % 20), y1 + (rand() % 20), rand() % 3);
+}
+
+static void setupWaterfall(void)
+{
+    waterfallClipPos = 0;
+    ccPipelineInit();
+    waterfallMode.fnEnterMode();
+}
+
+/**
+ * The real waterfall mode, fed a frame of the sweep clip through the mic front
+ * end. It draws a column and blanks the one after it, which are sent as one
+ * column window except when the head wraps from the right edge to the left
+ */
+static void frameWaterfall(uint32_t f)
+{
+    int16_t samples[CC_FRAME_SAMPLES];
+    if(waterfallClipPos + CC_FRAME_SAMPLES > waterfallClip.numSamples)
+    {
+        waterfallClipPos = 0;
+    }
+    ccFrontEnd(&waterfallClip.samples[waterfallClipPos], samples, CC_FRAME_SAMPLES);
+    waterfallClipPos += CC_FRAME_SAMPLES;
+    waterfallMode.fnAudioBlockCallback(samples, CC_FRAME_SAMPLES);
+}
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief user_main.c isn't built on a PC, and nothing here decimates audio
+ */
+void setAudioDecimation(uint8_t factor)
+{
+}
+
+/**
+ * @return A monotonic time in nanoseconds
+ */
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
+}
+
+/**
+ * @brief Run a scenario and print a line of results
+ *
+ * @param sc The scenario to run
+ */
+static void runScenario(const benchScenario_t* sc)
+{
+    srand(1);
+    zeroMenuBar();
+    sc->setup();
+    updateOLED(false);
+
+    resetOLEDStats();
+    oledEmuResetStats();
+
+    uint64_t hostNs = 0;
+    uint32_t f;
+    for(f = 0; f < BENCH_FRAMES; f++)
+    {
+        sc->frame(f);
+        uint64_t start = nowNs();
+        updateOLED(true);
+        hostNs += nowNs() - start;
+    }
+
+    oledStats_t stats;
+    getOLEDStats(&stats);
+    oledEmuStats_t bus;
+    oledEmuGetStats(&bus);
+
+    printf("%-10s %8.1f %8u %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.0f\n",
+           sc->name,
+           (double)bus.bytes / BENCH_FRAMES,
+           (unsigned int)stats.maxFrameBytes,
+           (double)bus.transfers / BENCH_FRAMES,
+           (double)stats.totalRuns / BENCH_FRAMES,
+           (double)bus.dataBytes / BENCH_FRAMES,
+           (double)bus.cmdBytes / BENCH_FRAMES,
+           (double)stats.totalCompared / BENCH_FRAMES,
+           (double)stats.totalCopied / BENCH_FRAMES,
+           (double)hostNs / BENCH_FRAMES);
+}
+
+/**
+ * @brief Fill a rectangle a pixel at a time, the way fillDisplayArea() did
+ * before the column blitter
+ */
+static void fillByPixels(int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c)
+{
+    int16_t x, y;
+    for(x = x1; x <= x2; x++)
+    {
+        for(y = y1; y <= y2; y++)
+        {
+            drawPixel(x, y, c);
+        }
+    }
+}
+
+/**
+ * @brief Time fillDisplayArea() against a drawPixel() loop for a rectangle,
+ * and check they draw the same thing
+ *
+ * @param name The name to print
+ * @param x1 The left edge
+ * @param y1 The top edge
+ * @param x2 The right edge
+ * @param y2 The bottom edge
+ */
+static void benchFill(const char* name, int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+{
+    static uint8_t blitFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+    const color colors[] = {WHITE, INVERSE, BLACK};
+    uint32_t reps = 200000 / ((x2 - x1 + 1) * (y2 - y1 + 1)) + 100;
+    uint32_t i;
+
+    clearDisplay();
+    uint64_t start = nowNs();
+    for(i = 0; i < reps; i++)
+    {
+        fillDisplayArea(x1, y1, x2, y2, colors[i % 3]);
+    }
+    uint64_t blitNs = nowNs() - start;
+    memcpy(blitFb, currentFb, sizeof(blitFb));
+
+    clearDisplay();
+    start = nowNs();
+    for(i = 0; i < reps; i++)
+    {
+        fillByPixels(x1, y1, x2, y2, colors[i % 3]);
+    }
+    uint64_t pixelNs = nowNs() - start;
+
+    uint32_t pixels = (x2 - x1 + 1) * (y2 - y1 + 1);
+    printf("%-10s %8u %10.0f %10.0f %8.1f %s\n",
+           name,
+           (unsigned int)pixels,
+           (double)blitNs / reps,
+           (double)pixelNs / reps,
+           (double)pixelNs / (double)blitNs,
+           (0 == memcmp(blitFb, currentFb, sizeof(blitFb))) ? "same" : "DIFFERENT");
+    clearDisplay();
+}
+
+/**
+ * @brief Fill in art the size of king.png, a white oval with a black border
+ * and some black details, transparent around it
+ */
+static void makeKingArt(void)
+{
+    int16_t x, y;
+    for(y = 0; y < KING_H; y++)
+    {
+        for(x = 0; x < KING_W; x++)
+        {
+            // Distance from the center, squared, scaled so the edge is 1024
+            int32_t dx = (2 * x) - (KING_W - 1);
+            int32_t dy = (2 * y) - (KING_H - 1);
+            int32_t d = ((dx * dx * 1024) / (KING_W * KING_W)) + ((dy * dy * 1024) / (KING_H * KING_H));
+            char px = '.';
+            if(d < 800)
+            {
+                px = (0 == (x / 5 + y / 7) % 3) ? '+' : '#';
+            }
+            else if(d < 1024)
+            {
+                px = '+';
+            }
+            kingArt[(y * KING_W) + x] = px;
+        }
+    }
+    kingArt[KING_W * KING_H] = 0;
+}
+
+/**
+ * @brief Spin a bitmap the size of king.png the way colorchord does, drawn
+ * with every pixel transformed and then from the rotation cache. Check each
+ * cached angle draws the same as transforming at that angle
+ *
+ * @param stepDeg The rotation cache's angle step
+ */
+static void benchRotation(uint8_t stepDeg)
+{
+    static uint8_t pixelFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+    assetHandle_t king;
+    getAssetHandle("king.png", &king);
+    const uint32_t framesPerSpin = 360 / KING_STEP_DEG;
+    const int16_t xp = (OLED_WIDTH - KING_W) / 2;
+    uint32_t f;
+
+    // Transforming every pixel
+    setAssetRotationCache(0, 1);
+    uint64_t start = nowNs();
+    for(f = 0; f < ROT_SPINS * framesPerSpin; f++)
+    {
+        drawBitmapFromHandle(&king, xp, 0, false, false, (f * KING_STEP_DEG) % 360);
+    }
+    uint64_t pixelNs = nowNs() - start;
+
+    // From the cache, the first spin fills it
+    setAssetRotationCache(UINT32_MAX, stepDeg);
+    start = nowNs();
+    for(f = 0; f < framesPerSpin; f++)
+    {
+        drawBitmapFromHandle(&king, xp, 0, false, false, (f * KING_STEP_DEG) % 360);
+    }
+    uint64_t fillNs = nowNs() - start;
+    start = nowNs();
+    for(f = 0; f < ROT_SPINS * framesPerSpin; f++)
+    {
+        drawBitmapFromHandle(&king, xp, 0, false, false, (f * KING_STEP_DEG) % 360);
+    }
+    uint64_t cachedNs = nowNs() - start;
+    uint32_t cacheBytes = getAssetRotationCacheBytes();
+
+    // Every cached angle against transforming every pixel at that angle
+    uint16_t different = 0;
+    int16_t deg;
+    for(deg = stepDeg; deg < 360; deg += stepDeg)
+    {
+        setAssetRotationCache(0, 1);
+        clearDisplay();
+        drawBitmapFromHandle(&king, xp, 0, false, false, deg);
+        memcpy(pixelFb, currentFb, sizeof(pixelFb));
+        setAssetRotationCache(UINT32_MAX, stepDeg);
+        clearDisplay();
+        drawBitmapFromHandle(&king, xp, 0, false, false, deg);
+        if(0 != memcmp(pixelFb, currentFb, sizeof(pixelFb)))
+        {
+            different++;
+        }
+    }
+    setAssetRotationCache(0, 1);
+    clearDisplay();
+
+    printf("%8u %8u %8u %10.0f %10.0f %10.0f %8.1f %s\n",
+           stepDeg, 360 / stepDeg, (unsigned int)cacheBytes,
+           (double)pixelNs / (ROT_SPINS * framesPerSpin),
+           (double)fillNs / framesPerSpin,
+           (double)cachedNs / (ROT_SPINS * framesPerSpin),
+           (double)pixelNs / (double)cachedNs,
+           (0 == different) ? "same" : "DIFFERENT");
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(void)
+{
+    static const benchScenario_t scenarios[] =
+    {
+        {"invert", setupBusy, frameInvert},
+        {"sprite", setupBlank, frameSprite},
+        {"score", setupBusy, frameScore},
+        {"counters", setupBlank, frameTwoCounters},
+        {"menu_bar", setupBusy, frameMenuBar},
+        {"random", setupBlank, frameRandom},
+        {"waterfall", setupWaterfall, frameWaterfall},
+    };
+
+    if(!wavRead(WATERFALL_CLIP, &waterfallClip) || 0 == waterfallClip.numSamples)
+    {
+        printf("couldn't read %s\n", WATERFALL_CLIP);
+        return EXIT_FAILURE;
+    }
+    initOLED(true);
+    makeKingArt();
+    assetImageReset();
+    assetImageAddBitmap("king.png", KING_W, KING_H, kingArt);
+    assetImageLoad();
+
+    printf("bench_oled: %d frames per scenario, averages per frame, a full frame is %d data bytes, a column is %d\n",
+           BENCH_FRAMES, FULL_FRAME_DATA, COLUMN_DATA);
+#ifdef MAX_RUNS_PER_PAGE
+    printf("built with MAX_RUNS_PER_PAGE=%d\n", MAX_RUNS_PER_PAGE);
+#endif
+    // Without dirty spans, every frame compared and copied the whole framebuffer
+    printf("framebuffer bytes compared and copied per frame without dirty spans: %d and %d\n",
+           FULL_FRAME_DATA, FULL_FRAME_DATA);
+    printf("%-10s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+           "scenario", "bytes", "max", "xfers", "runs", "data", "cmds", "compared", "copied", "host ns");
+
+    uint8_t i;
+    for(i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        runScenario(&scenarios[i]);
+    }
+
+    printf("\nfillDisplayArea() against a drawPixel() loop, host ns per call\n");
+    printf("%-10s %8s %10s %10s %8s\n", "rect", "pixels", "blit", "pixels", "speedup");
+    benchFill("full", 0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1);
+    benchFill("half", 0, 0, OLED_WIDTH - 1, (OLED_HEIGHT / 2) - 1);
+    benchFill("box", 10, 13, 41, 44);
+    benchFill("odd", 3, 5, 20, 10);
+    benchFill("row", 0, 21, OLED_WIDTH - 1, 21);
+    benchFill("column", 77, 0, 77, OLED_HEIGHT - 1);
+    benchFill("8x8", 60, 30, 67, 37);
+
+    printf("\na %dx%d bitmap turning %d degrees a frame, host ns per draw, transforming every pixel\n"
+           "against the rotation cache, for its first spin and after\n", KING_W, KING_H, KING_STEP_DEG);
+    printf("%8s %8s %8s %10s %10s %10s %8s\n", "step", "angles", "bytes", "pixels", "filling", "cached", "speedup");
+    benchRotation(4);
+    benchRotation(8);
+    benchRotation(12);
+    benchRotation(15);
+
+    wavFree(&waterfallClip);
+    return EXIT_SUCCESS;
+}
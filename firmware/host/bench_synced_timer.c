@@ -0,0 +1,123 @@
+/*
+ * bench_synced_timer.c
+ *
+ * Host time of the synced timers' deadline heap, with the table partly and
+ * completely full. procTask() checks the timers every pass, so the check with
+ * nothing due is what matters most. The times are only a rough guide to the
+ * ESP8266, compare them against each other
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_host.h"
+#include "synced_timer.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define BENCH_REPS 1000000
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static syncedTimer_t timers[SYNCED_TIMER_MAX_SLOTS];
+static volatile uint32_t benchCalls;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @return A monotonic time in nanoseconds
+ */
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + ts.tv_nsec;
+}
+
+/**
+ * @brief A timer function which does nothing but count
+ */
+static void benchTimerFn(void* arg)
+{
+    benchCalls++;
+}
+
+/**
+ * @brief Arm some repeating timers with different periods, and time the heap
+ *
+ * @param numTimers How many timers to arm
+ */
+static void benchTimers(uint8_t numTimers)
+{
+    hostSetTime(0);
+    uint8_t i;
+    for(i = 0; i < numTimers; i++)
+    {
+        syncedTimerSetFn(&timers[i], benchTimerFn, NULL);
+        // Periods from 1 to 8ms, so several are often due at once
+        syncedTimerArm(&timers[i], 1 + (i % 8), true);
+    }
+
+    // Nothing is due, so only the top of the heap is looked at
+    uint32_t rep;
+    uint64_t start = nowNs();
+    for(rep = 0; rep < BENCH_REPS; rep++)
+    {
+        syncedTimersCheck();
+    }
+    double idleNs = (double)(nowNs() - start) / BENCH_REPS;
+
+    // Move 100us a check, so some checks call timers and put them back in the
+    // heap, and some find nothing due
+    benchCalls = 0;
+    start = nowNs();
+    for(rep = 0; rep < BENCH_REPS; rep++)
+    {
+        hostAdvanceTime(100);
+        syncedTimersCheck();
+    }
+    double busyNs = (double)(nowNs() - start) / BENCH_REPS;
+
+    // Rearming a timer moves it within the heap
+    start = nowNs();
+    for(rep = 0; rep < BENCH_REPS; rep++)
+    {
+        syncedTimerArm(&timers[rep % numTimers], 1 + (rep % 8), true);
+    }
+    double armNs = (double)(nowNs() - start) / BENCH_REPS;
+
+    printf("%8u %12.1f %12.1f %12.2f %12.1f\n", numTimers, idleNs, busyNs,
+           (double)benchCalls / BENCH_REPS, armNs);
+
+    for(i = 0; i < numTimers; i++)
+    {
+        syncedTimerDisarm(&timers[i]);
+    }
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(void)
+{
+    printf("bench_synced_timer: host ns, a table of %d slots\n", SYNCED_TIMER_MAX_SLOTS);
+    printf("%8s %12s %12s %12s %12s\n", "timers", "idle check", "busy check", "calls/check", "rearm");
+    benchTimers(1);
+    benchTimers(4);
+    benchTimers(8);
+    benchTimers(16);
+    benchTimers(SYNCED_TIMER_MAX_SLOTS);
+    return EXIT_SUCCESS;
+}
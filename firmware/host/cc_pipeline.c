@@ -0,0 +1,95 @@
+/*
+ * cc_pipeline.c
+ *
+ * ColorChord's settings and a model of the mic front end, for the audio
+ * harnesses. The ADC's 8 bit samples are made from 16 bit PCM, then filtered
+ * and amplified like filterAudioBlock() in user_main.c at the default gain,
+ * without the AGC or decimation
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include "cc_pipeline.h"
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+// The same defaults as mode_colorchord.c
+struct CCSettings CCS =
+{
+    .gSETTINGS_KEY         = 0,
+    .gROOT_NOTE_OFFSET     = 0,
+    .gDFTIIR               = 6,
+    .gFUZZ_IIR_BITS        = 1,
+    .gFILTER_BLUR_PASSES   = 2,
+    .gSEMIBITSPERBIN       = 3,
+    .gMAX_JUMP_DISTANCE    = 4,
+    .gMAX_COMBINE_DISTANCE = 7,
+    .gAMP_1_IIR_BITS       = 4,
+    .gAMP_2_IIR_BITS       = 2,
+    .gMIN_AMP_FOR_NOTE     = 80,
+    .gMINIMUM_AMP_FOR_NOTE_TO_DISAPPEAR = 64,
+    .gNOTE_FINAL_AMP       = 12,
+    .gNERF_NOTE_PORP       = 15,
+    .gUSE_NUM_LIN_LEDS     = NUM_LIN_LEDS,
+    .gCOLORCHORD_ACTIVE    = 1,
+    .gCOLORCHORD_OUTPUT_DRIVER = 1,
+    .gINITIAL_AMP          = 80,
+    .gAGC_ENABLE           = 0,
+    .gAGC_TARGET           = 64,
+    .gAGC_ATTACK_BITS      = 1,
+    .gAGC_RELEASE_BITS     = 8
+};
+
+static uint32_t sampIir = 0;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Reset ColorChord and the front end's filter
+ */
+void ccPipelineInit(void)
+{
+    InitColorChord();
+    // Start the DC filter settled at the ADC's midpoint, as it would be long
+    // after boot
+    sampIir = 128 << 10;
+}
+
+/**
+ * @brief Turn PCM into the samples the mic front end gives ColorChord
+ *
+ * @param pcm     16 bit PCM
+ * @param samples Returns the filtered, amplified samples
+ * @param n       The number of samples
+ */
+void ccFrontEnd(const int16_t* pcm, int16_t* samples, uint16_t n)
+{
+    int32_t gain = CCS.gINITIAL_AMP << 4;
+    uint16_t i;
+    for(i = 0; i < n; i++)
+    {
+        // The ADC's samples are 8 bits, centered on 128
+        int32_t samp = (pcm[i] >> 8) + 128;
+
+        // The same IIR filter and gain as filterAudioBlock()
+        sampIir = sampIir - (sampIir >> 10) + samp;
+        samp = (samp - (int32_t)(sampIir >> 10)) * 16;
+        samp = (samp * gain) >> 8;
+
+        if(samp > INT16_MAX)
+        {
+            samp = INT16_MAX;
+        }
+        else if(samp < INT16_MIN)
+        {
+            samp = INT16_MIN;
+        }
+        samples[i] = samp;
+    }
+}
@@ -0,0 +1,19 @@
+/*
+ * cc_pipeline.h
+ *
+ * Feeds PCM to the ColorChord pipeline the way the Swadge does: through a
+ * model of the mic front end, a frame of samples at a time
+ */
+
+#ifndef _CC_PIPELINE_H_
+#define _CC_PIPELINE_H_
+
+#include "embeddednf.h"
+
+// Samples pushed between frames, as in mode_colorchord.c
+#define CC_FRAME_SAMPLES (128 / CC_DECIMATION)
+
+void ccPipelineInit(void);
+void ccFrontEnd(const int16_t* pcm, int16_t* samples, uint16_t n);
+
+#endif
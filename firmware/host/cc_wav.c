@@ -0,0 +1,132 @@
+/*
+ * cc_wav.c
+ *
+ * Runs a WAV file through ColorChord and writes what it made of every frame
+ * as CSV: the folded bins, the note tables, then the LEDs from each output
+ * driver. One clip is run per process, so nothing carries over between clips.
+ *
+ * Usage: cc_wav <in.wav> <out.csv>
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wav.h"
+#include "cc_pipeline.h"
+#include "embeddedout.h"
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Write the CSV header
+ *
+ * @param csv The file to write to
+ */
+static void writeHeader(FILE* csv)
+{
+    uint8_t i;
+    fprintf(csv, "frame");
+    for(i = 0; i < FIXBPERO; i++)
+    {
+        fprintf(csv, ",bin%u", i);
+    }
+    for(i = 0; i < MAXNOTES; i++)
+    {
+        fprintf(csv, ",freq%u,amp%u,amp2_%u", i, i, i);
+    }
+    for(i = 0; i < NUM_LIN_LEDS * 3; i++)
+    {
+        fprintf(csv, ",lin%u", i);
+    }
+    for(i = 0; i < NUM_LIN_LEDS * 3; i++)
+    {
+        fprintf(csv, ",same%u", i);
+    }
+    fprintf(csv, "\n");
+}
+
+/**
+ * @brief Write the LEDs an output driver made
+ *
+ * @param csv The file to write to
+ */
+static void writeLeds(FILE* csv)
+{
+    uint8_t i;
+    for(i = 0; i < NUM_LIN_LEDS * 3; i++)
+    {
+        fprintf(csv, ",%u", ledOut[i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 3)
+    {
+        fprintf(stderr, "usage: %s <in.wav> <out.csv>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    wav_t wav;
+    if(!wavRead(argv[1], &wav))
+    {
+        fprintf(stderr, "%s: not a 16 bit mono PCM WAV\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if(CC_SAMPLE_RATE != wav.sampleRate)
+    {
+        fprintf(stderr, "%s: %u Hz, ColorChord runs at %u Hz\n", argv[1],
+                (unsigned int)wav.sampleRate, (unsigned int)CC_SAMPLE_RATE);
+        wavFree(&wav);
+        return EXIT_FAILURE;
+    }
+
+    FILE* csv = fopen(argv[2], "w");
+    if(NULL == csv)
+    {
+        fprintf(stderr, "couldn't write %s\n", argv[2]);
+        wavFree(&wav);
+        return EXIT_FAILURE;
+    }
+    writeHeader(csv);
+
+    ccPipelineInit();
+    int16_t samples[CC_FRAME_SAMPLES];
+    uint32_t frame;
+    for(frame = 0; (frame + 1) * CC_FRAME_SAMPLES <= wav.numSamples; frame++)
+    {
+        ccFrontEnd(&wav.samples[frame * CC_FRAME_SAMPLES], samples, CC_FRAME_SAMPLES);
+        PushSamples32(samples, CC_FRAME_SAMPLES);
+        NewFrameInfo();
+        PullFrameStage(FRAME_STAGE_NOTES);
+
+        fprintf(csv, "%u", (unsigned int)frame);
+        uint8_t i;
+        for(i = 0; i < FIXBPERO; i++)
+        {
+            fprintf(csv, ",%u", folded_bins[i]);
+        }
+        for(i = 0; i < MAXNOTES; i++)
+        {
+            fprintf(csv, ",%u,%u,%u", note_peak_freqs[i], note_peak_amps[i], note_peak_amps2[i]);
+        }
+
+        // The linear driver keeps state between frames, the all same driver
+        // doesn't, so running both doesn't change what either makes
+        UpdateLinearLEDs();
+        writeLeds(csv);
+        UpdateAllSameLEDs();
+        writeLeds(csv);
+        fprintf(csv, "\n");
+    }
+
+    fclose(csv);
+    wavFree(&wav);
+    return EXIT_SUCCESS;
+}
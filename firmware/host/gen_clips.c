@@ -0,0 +1,244 @@
+/*
+ * gen_clips.c
+ *
+ * Writes the reference clips in clips/ which the audio harnesses run. They
+ * are synthesized so what's in them is known exactly. The clips are committed,
+ * this only needs to run again to change them.
+ *
+ * The clips in clips/beat/ are labelled. Each has a .txt beside it with the
+ * tempo, then the time of every onset and every beat, in seconds:
+ *   bpm 120
+ *   onset 0.500
+ *   beat 0.500
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wav.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define CLIP_RATE 16000
+#define CLIP_DIR "clips/"
+#define BEAT_CLIP_LEN (10 * CLIP_RATE)
+
+// Fades at the start and end of tones, so they don't click
+#define FADE_SAMPLES (CLIP_RATE / 100)
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Add a sine tone to a clip, faded in and out
+ *
+ * @param clip  The clip to add to
+ * @param start The first sample of the tone
+ * @param len   The length of the tone, in samples
+ * @param freq  The frequency, in Hz
+ * @param amp   The peak amplitude
+ */
+static void addTone(float* clip, uint32_t start, uint32_t len, float freq, float amp)
+{
+    uint32_t i;
+    for(i = 0; i < len; i++)
+    {
+        float env = 1.0f;
+        if(i < FADE_SAMPLES)
+        {
+            env = (float)i / FADE_SAMPLES;
+        }
+        else if(len - i < FADE_SAMPLES)
+        {
+            env = (float)(len - i) / FADE_SAMPLES;
+        }
+        clip[start + i] += amp * env * sinf(2.0f * (float)M_PI * freq * i / CLIP_RATE);
+    }
+}
+
+/**
+ * @brief Round a clip to 16 bits and write it
+ *
+ * @param name The file name, in CLIP_DIR
+ * @param clip The clip
+ * @param n    The number of samples
+ * @return true if it was written
+ */
+static bool writeClip(const char* name, const float* clip, uint32_t n)
+{
+    int16_t* pcm = (int16_t*)malloc(n * sizeof(int16_t));
+    uint32_t i;
+    for(i = 0; i < n; i++)
+    {
+        float s = roundf(clip[i]);
+        pcm[i] = (s > INT16_MAX) ? INT16_MAX : ((s < INT16_MIN) ? INT16_MIN : (int16_t)s);
+    }
+    char path[64];
+    snprintf(path, sizeof(path), CLIP_DIR "%s", name);
+    bool ok = wavWrite(path, pcm, n, CLIP_RATE);
+    free(pcm);
+    printf("%s %s\n", ok ? "wrote" : "couldn't write", path);
+    return ok;
+}
+
+/**
+ * @brief An A major triad, A3 C#4 E4, held
+ */
+static bool genChord(void)
+{
+    uint32_t n = (3 * CLIP_RATE) / 2;
+    float* clip = (float*)calloc(n, sizeof(float));
+    addTone(clip, 0, n, 220.00f, 6000);
+    addTone(clip, 0, n, 277.18f, 6000);
+    addTone(clip, 0, n, 329.63f, 6000);
+    bool ok = writeClip("chord.wav", clip, n);
+    free(clip);
+    return ok;
+}
+
+/**
+ * @brief An exponential sweep from A2 to A6, across every octave ColorChord
+ * hears
+ */
+static bool genSweep(void)
+{
+    uint32_t n = 2 * CLIP_RATE;
+    float* clip = (float*)calloc(n, sizeof(float));
+    float phase = 0;
+    uint32_t i;
+    for(i = 0; i < n; i++)
+    {
+        float freq = 110.0f * powf(16.0f, (float)i / n);
+        phase += 2.0f * (float)M_PI * freq / CLIP_RATE;
+        clip[i] = 12000 * sinf(phase);
+    }
+    bool ok = writeClip("sweep.wav", clip, n);
+    free(clip);
+    return ok;
+}
+
+/**
+ * @brief Silence, then a C major scale of plucked notes over quiet noise
+ */
+static bool genMelody(void)
+{
+    static const float scale[] = {261.63f, 293.66f, 329.63f, 349.23f, 392.00f, 440.00f, 493.88f, 523.25f};
+    uint32_t silence = (3 * CLIP_RATE) / 10;
+    uint32_t noteLen = CLIP_RATE / 5;
+    uint32_t n = silence + (noteLen * (sizeof(scale) / sizeof(scale[0])));
+    float* clip = (float*)calloc(n, sizeof(float));
+
+    uint32_t i, note;
+    for(note = 0; note < sizeof(scale) / sizeof(scale[0]); note++)
+    {
+        uint32_t start = silence + (note * noteLen);
+        for(i = 0; i < noteLen; i++)
+        {
+            float env = (i < FADE_SAMPLES) ? ((float)i / FADE_SAMPLES) : expf(-4.0f * i / noteLen);
+            clip[start + i] += 10000 * env * sinf(2.0f * (float)M_PI * scale[note] * i / CLIP_RATE);
+        }
+    }
+
+    // A fixed LCG, so the noise is the same every time
+    uint32_t lcg = 1;
+    for(i = silence; i < n; i++)
+    {
+        lcg = (lcg * 1103515245u) + 12345u;
+        clip[i] += (int32_t)((lcg >> 16) % 601) - 300;
+    }
+
+    bool ok = writeClip("melody.wav", clip, n);
+    free(clip);
+    return ok;
+}
+
+/**
+ * @brief A kick drum on every beat over a quiet held note and noise, with an
+ * optional snare between beats. Writes the clip and its labels
+ *
+ * @param name    The file name without an extension, in CLIP_DIR
+ * @param bpm     The tempo
+ * @param offbeat true to add a snare halfway between beats
+ * @return true if both were written
+ */
+static bool genBeat(const char* name, uint8_t bpm, bool offbeat)
+{
+    uint32_t n = BEAT_CLIP_LEN;
+    float* clip = (float*)calloc(n, sizeof(float));
+    uint32_t period = (60 * CLIP_RATE) / bpm;
+
+    char path[64];
+    snprintf(path, sizeof(path), CLIP_DIR "%s.txt", name);
+    FILE* labels = fopen(path, "w");
+    if(NULL == labels)
+    {
+        free(clip);
+        return false;
+    }
+    fprintf(labels, "bpm %u\n", bpm);
+
+    // The first beat is half a period in, so it doesn't start at the first
+    // sample
+    uint32_t lcg = (uint32_t)bpm;
+    uint32_t beat, i;
+    for(beat = period / 2; beat < n; beat += period)
+    {
+        fprintf(labels, "onset %.3f\nbeat %.3f\n", (double)beat / CLIP_RATE, (double)beat / CLIP_RATE);
+        // A falling sine, like a kick drum
+        float phase = 0;
+        for(i = 0; i < period && beat + i < n; i++)
+        {
+            float t = (float)i / CLIP_RATE;
+            phase += 2.0f * (float)M_PI * (80.0f + 200.0f * expf(-t * 40.0f)) / CLIP_RATE;
+            clip[beat + i] += 12000 * expf(-t * 30.0f) * sinf(phase);
+        }
+
+        uint32_t snare = beat + (period / 2);
+        if(offbeat && snare < n)
+        {
+            fprintf(labels, "onset %.3f\n", (double)snare / CLIP_RATE);
+            // A tone and a burst of noise, like a snare
+            for(i = 0; i < period / 2 && snare + i < n; i++)
+            {
+                float t = (float)i / CLIP_RATE;
+                lcg = (lcg * 1103515245u) + 12345u;
+                int32_t noise = (int32_t)((lcg >> 16) & 0x7FFF) - 0x4000;
+                clip[snare + i] += expf(-t * 40.0f) * ((0.4f * noise) +
+                                                      (4000 * sinf(2.0f * (float)M_PI * 200.0f * t)));
+            }
+        }
+    }
+    fclose(labels);
+
+    for(i = 0; i < n; i++)
+    {
+        lcg = (lcg * 1103515245u) + 12345u;
+        clip[i] += (1200 * sinf(2.0f * (float)M_PI * 440.0f * i / CLIP_RATE)) +
+                   (int32_t)((lcg >> 16) % 801) - 400;
+    }
+
+    snprintf(path, sizeof(path), "%s.wav", name);
+    bool ok = writeClip(path, clip, n);
+    free(clip);
+    return ok;
+}
+
+int main(void)
+{
+    bool ok = genChord();
+    ok = genSweep() && ok;
+    ok = genMelody() && ok;
+    ok = genBeat("beat/kick_75", 75, false) && ok;
+    ok = genBeat("beat/kick_120", 120, false) && ok;
+    ok = genBeat("beat/kick_snare_100", 100, true) && ok;
+    ok = genBeat("beat/kick_snare_150", 150, true) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
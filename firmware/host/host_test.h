@@ -0,0 +1,54 @@
+/*
+ * host_test.h
+ *
+ * The bare minimum for the host tests. Each test program runs its checks,
+ * prints a summary and exits nonzero if any check failed
+ */
+
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern int hostTestChecks;
+extern int hostTestFailures;
+
+#define CHECK(cond) \
+    do \
+    { \
+        hostTestChecks++; \
+        if(!(cond)) \
+        { \
+            hostTestFailures++; \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while(0)
+
+#define CHECK_EQ(a, b) \
+    do \
+    { \
+        long long _a = (long long)(a); \
+        long long _b = (long long)(b); \
+        hostTestChecks++; \
+        if(_a != _b) \
+        { \
+            hostTestFailures++; \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", \
+                   __FILE__, __LINE__, #a, #b, _a, _b); \
+        } \
+    } while(0)
+
+// Define these once, in the file with main()
+#define HOST_TEST_GLOBALS \
+    int hostTestChecks = 0; \
+    int hostTestFailures = 0
+
+static inline int hostTestSummary(const char* name)
+{
+    printf("%s: %d checks, %d failed\n", name, hostTestChecks, hostTestFailures);
+    return (0 == hostTestFailures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,542 @@
+/*
+ * oled_emu.c
+ *
+ * A virtual SSD1306 on a virtual I2C bus. The command and data stream which
+ * oled.c sends is decoded into the controller's display RAM and registers.
+ * The picture is then built the same way the glass shows it, so tests check
+ * what a person would see, not what oled.c meant to send
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+
+#include "cnlohr_i2c.h"
+#include "gpio_user.h"
+#include "oled.h"
+#include "oled_emu.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define EMU_PAGES 8
+#define EMU_COLS 128
+#define EMU_ROWS 64
+
+#define CTRL_CONTINUATION 0x80
+#define CTRL_DATA 0x40
+
+#define OLED_EMU_ADDRESS (0x78 >> 1)
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    uint8_t ram[EMU_PAGES][EMU_COLS];
+
+    // Addressing
+    uint8_t addrMode;
+    uint8_t page;
+    uint8_t col;
+    uint8_t colStart;
+    uint8_t colEnd;
+    uint8_t pageStart;
+    uint8_t pageEnd;
+
+    // Hardware configuration
+    bool displayOn;
+    bool entireOn;
+    bool inverse;
+    bool segRemap;
+    bool comScanDec;
+    bool comPinsAlt;
+    bool comLRRemap;
+    uint8_t startLine;
+    uint8_t offset;
+    uint8_t muxRatio;
+
+    // Command parsing
+    uint8_t cmd;
+    uint8_t argsLeft;
+    uint8_t args[6];
+    uint8_t argIdx;
+
+    // Bus
+    uint8_t slaveAddress;
+    oledEmuStats_t stats;
+} ssd1306Emu_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static ssd1306Emu_t emu;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Put the controller in its power on state. Display RAM is not
+ * cleared by a reset, but it is zeroed here so tests are repeatable
+ */
+void oledEmuReset(void)
+{
+    ets_memset(emu.ram, 0, sizeof(emu.ram));
+    emu.addrMode = 0x02;
+    emu.page = 0;
+    emu.col = 0;
+    emu.colStart = 0;
+    emu.colEnd = EMU_COLS - 1;
+    emu.pageStart = 0;
+    emu.pageEnd = EMU_PAGES - 1;
+    emu.displayOn = false;
+    emu.entireOn = false;
+    emu.inverse = false;
+    emu.segRemap = false;
+    emu.comScanDec = false;
+    emu.comPinsAlt = true;
+    emu.comLRRemap = false;
+    emu.startLine = 0;
+    emu.offset = 0;
+    emu.muxRatio = EMU_ROWS - 1;
+    emu.argsLeft = 0;
+}
+
+/**
+ * @brief The number of argument bytes which follow a command
+ *
+ * @param cmd The command byte
+ * @return The number of arguments
+ */
+static uint8_t cmdArgCount(uint8_t cmd)
+{
+    switch(cmd)
+    {
+        case 0x20: // Memory addressing mode
+        case 0x81: // Contrast
+        case 0x8D: // Charge pump
+        case 0xA8: // Multiplex ratio
+        case 0xD3: // Display offset
+        case 0xD5: // Clock divide
+        case 0xD9: // Precharge
+        case 0xDA: // COM pins
+        case 0xDB: // VCOMH deselect
+        {
+            return 1;
+        }
+        case 0x21: // Column address
+        case 0x22: // Page address
+        case 0xA3: // Vertical scroll area
+        {
+            return 2;
+        }
+        case 0x29: // Vertical and right scroll
+        case 0x2A: // Vertical and left scroll
+        {
+            return 5;
+        }
+        case 0x26: // Right scroll
+        case 0x27: // Left scroll
+        {
+            return 6;
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Execute a command once all of its arguments arrived
+ *
+ * @param cmd  The command byte
+ * @param args The arguments
+ */
+static void runCmd(uint8_t cmd, const uint8_t* args)
+{
+    if(0xB0 <= cmd && cmd <= 0xB7)
+    {
+        emu.page = cmd & 0x07;
+    }
+    else if(cmd <= 0x0F)
+    {
+        emu.col = (emu.col & 0xF0) | (cmd & 0x0F);
+    }
+    else if(cmd <= 0x1F)
+    {
+        emu.col = (emu.col & 0x0F) | ((cmd & 0x07) << 4);
+    }
+    else if(0x40 <= cmd && cmd <= 0x7F)
+    {
+        emu.startLine = cmd & 0x3F;
+    }
+    else
+    {
+        switch(cmd)
+        {
+            case 0x20:
+            {
+                emu.addrMode = args[0] & 0x03;
+                break;
+            }
+            case 0x21:
+            {
+                emu.colStart = args[0] & 0x7F;
+                emu.colEnd = args[1] & 0x7F;
+                emu.col = emu.colStart;
+                break;
+            }
+            case 0x22:
+            {
+                emu.pageStart = args[0] & 0x07;
+                emu.pageEnd = args[1] & 0x07;
+                emu.page = emu.pageStart;
+                break;
+            }
+            case 0xA0:
+            case 0xA1:
+            {
+                emu.segRemap = (cmd & 0x01);
+                break;
+            }
+            case 0xA4:
+            case 0xA5:
+            {
+                emu.entireOn = (cmd & 0x01);
+                break;
+            }
+            case 0xA6:
+            case 0xA7:
+            {
+                emu.inverse = (cmd & 0x01);
+                break;
+            }
+            case 0xA8:
+            {
+                emu.muxRatio = args[0] & 0x3F;
+                break;
+            }
+            case 0xAE:
+            case 0xAF:
+            {
+                emu.displayOn = (cmd & 0x01);
+                break;
+            }
+            case 0xC0:
+            case 0xC8:
+            {
+                emu.comScanDec = (cmd & 0x08);
+                break;
+            }
+            case 0xD3:
+            {
+                emu.offset = args[0] & 0x3F;
+                break;
+            }
+            case 0xDA:
+            {
+                emu.comPinsAlt = (args[0] & 0x10);
+                emu.comLRRemap = (args[0] & 0x20);
+                break;
+            }
+            default:
+            {
+                // Timing, power and scrolling don't change the picture
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Write a byte to display RAM and advance the address like the
+ * current addressing mode does
+ *
+ * @param data The byte to write
+ */
+static void writeRam(uint8_t data)
+{
+    emu.ram[emu.page][emu.col] = data;
+    emu.stats.dataBytes++;
+
+    switch(emu.addrMode)
+    {
+        case 0x00:
+        {
+            // Horizontal, wrap to the next page
+            if(emu.col >= emu.colEnd)
+            {
+                emu.col = emu.colStart;
+                emu.page = (emu.page >= emu.pageEnd) ? emu.pageStart : (emu.page + 1);
+            }
+            else
+            {
+                emu.col++;
+            }
+            break;
+        }
+        case 0x01:
+        {
+            // Vertical, wrap to the next column
+            if(emu.page >= emu.pageEnd)
+            {
+                emu.page = emu.pageStart;
+                emu.col = (emu.col >= emu.colEnd) ? emu.colStart : (emu.col + 1);
+            }
+            else
+            {
+                emu.page++;
+            }
+            break;
+        }
+        default:
+        {
+            // Page, wrap within the page
+            emu.col = (emu.col + 1) % EMU_COLS;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Get a pixel as the glass shows it. The module routes the COM pins
+ * so that pins 0-31 drive the even rows and pins 32-63 drive the odd rows,
+ * counted from the top of the Swadge
+ *
+ * @param x Column of display, 0 is at the left
+ * @param y Row of the display, 0 is at the top
+ * @return true if the pixel is lit, false if it's dark or off the display
+ */
+bool oledEmuGetPixel(int16_t x, int16_t y)
+{
+    if(x < 0 || x >= EMU_COLS || y < 0 || y >= EMU_ROWS || false == emu.displayOn)
+    {
+        return false;
+    }
+    if(emu.entireOn)
+    {
+        return true;
+    }
+
+    // The glass row is wired to a COM pin
+    uint8_t pin = (0 == (y % 2)) ? (y / 2) : (32 + (y / 2));
+
+    // The COM pin configuration picks which COM signal drives the pin
+    uint8_t com;
+    if(emu.comPinsAlt)
+    {
+        com = (pin < 32) ? (2 * pin) : ((2 * (pin - 32)) + 1);
+        if(emu.comLRRemap)
+        {
+            com ^= 0x01;
+        }
+    }
+    else
+    {
+        com = pin;
+        if(emu.comLRRemap)
+        {
+            com = (com + 32) % EMU_ROWS;
+        }
+    }
+
+    // Then the scan direction, offset and start line pick the RAM row
+    if(com > emu.muxRatio)
+    {
+        return false;
+    }
+    uint8_t line = emu.comScanDec ? (emu.muxRatio - com) : com;
+    uint8_t row = (line + emu.offset + emu.startLine) % EMU_ROWS;
+    uint8_t col = emu.segRemap ? ((EMU_COLS - 1) - x) : x;
+
+    bool lit = (emu.ram[row / 8][col] >> (row % 8)) & 0x01;
+    return lit != emu.inverse;
+}
+
+/**
+ * @brief Get the bus traffic since the stats were reset
+ *
+ * @param stats Returns a copy of the stats
+ */
+void oledEmuGetStats(oledEmuStats_t* stats)
+{
+    *stats = emu.stats;
+}
+
+/**
+ * @brief Reset the bus traffic stats to zero
+ */
+void oledEmuResetStats(void)
+{
+    ets_memset(&emu.stats, 0, sizeof(emu.stats));
+}
+
+/**
+ * @brief Write the picture as a plain PBM, 1 is lit
+ *
+ * @param path The file to write
+ * @return true if it was written, false otherwise
+ */
+bool oledEmuWritePbm(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if(NULL == f)
+    {
+        return false;
+    }
+    fprintf(f, "P1\n%d %d\n", EMU_COLS, EMU_ROWS);
+    int16_t x, y;
+    for(y = 0; y < EMU_ROWS; y++)
+    {
+        for(x = 0; x < EMU_COLS; x++)
+        {
+            fputc(oledEmuGetPixel(x, y) ? '1' : '0', f);
+        }
+        fputc('\n', f);
+    }
+    return (0 == fclose(f));
+}
+
+/**
+ * @brief Compare the picture to a plain PBM written by oledEmuWritePbm()
+ *
+ * @param path The file to compare to
+ * @return The number of pixels which differ, or -1 if the file couldn't be read
+ */
+int32_t oledEmuComparePbm(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if(NULL == f)
+    {
+        return -1;
+    }
+    int w, h;
+    if(2 != fscanf(f, "P1 %d %d", &w, &h) || EMU_COLS != w || EMU_ROWS != h)
+    {
+        fclose(f);
+        return -1;
+    }
+
+    int32_t diffs = 0;
+    int16_t x = 0, y = 0;
+    int c;
+    while(y < EMU_ROWS && EOF != (c = fgetc(f)))
+    {
+        if('0' != c && '1' != c)
+        {
+            continue;
+        }
+        if(('1' == c) != oledEmuGetPixel(x, y))
+        {
+            diffs++;
+        }
+        if(++x == EMU_COLS)
+        {
+            x = 0;
+            y++;
+        }
+    }
+    fclose(f);
+    return (y == EMU_ROWS) ? diffs : -1;
+}
+
+//==============================================================================
+// cnlohr_i2c.c and gpio_user.c replacements
+//==============================================================================
+
+void cnlohr_i2c_setup(uint32_t clock_stretch_time_out_usec __attribute__((unused)))
+{
+}
+
+void cnlohr_i2c_start_transaction(uint8_t slave_address,
+                                  uint16_t SCL_frequency_KHz __attribute__((unused)))
+{
+    emu.slaveAddress = slave_address;
+    emu.stats.transactions++;
+}
+
+/**
+ * @brief Decode a write to the SSD1306. The first byte is a control byte,
+ * which says if the rest is commands or display data
+ */
+void cnlohr_i2c_write(const uint8_t* data, uint32_t no_of_bytes,
+                      bool repeated_start __attribute__((unused)))
+{
+    emu.stats.transfers++;
+    emu.stats.bytes += 1 + no_of_bytes;
+
+    // A stop and start condition abandons a half sent command
+    emu.argsLeft = 0;
+
+    uint32_t i = 0;
+    while(i < no_of_bytes)
+    {
+        uint8_t ctrl = data[i++];
+        bool single = (ctrl & CTRL_CONTINUATION);
+        bool isData = (ctrl & CTRL_DATA);
+
+        // Without the continuation bit, everything else is the same kind
+        uint32_t end = single ? (i + 1) : no_of_bytes;
+        for(; i < end && i < no_of_bytes; i++)
+        {
+            if(isData)
+            {
+                writeRam(data[i]);
+                continue;
+            }
+
+            emu.stats.cmdBytes++;
+            if(0 == emu.argsLeft)
+            {
+                emu.cmd = data[i];
+                emu.argIdx = 0;
+                emu.argsLeft = cmdArgCount(emu.cmd);
+            }
+            else
+            {
+                emu.args[emu.argIdx++] = data[i];
+                emu.argsLeft--;
+            }
+            if(0 == emu.argsLeft)
+            {
+                runCmd(emu.cmd, emu.args);
+            }
+        }
+    }
+}
+
+void cnlohr_i2c_read(uint8_t* data, uint32_t nr_of_bytes,
+                     bool repeated_start __attribute__((unused)))
+{
+    emu.stats.transfers++;
+    emu.stats.bytes += 1 + nr_of_bytes;
+    ets_memset(data, 0, nr_of_bytes);
+}
+
+uint8_t cnlohr_i2c_end_transaction(void)
+{
+    // Only the OLED is on this bus, anything else is NAKed
+    return (OLED_EMU_ADDRESS == emu.slaveAddress) ? 0 : 1;
+}
+
+void cnlohr_i2c_get_stats(uint32_t* bytes, uint32_t* transfers)
+{
+    *bytes = emu.stats.bytes;
+    *transfers = emu.stats.transfers;
+}
+
+void setOledResetOn(bool on)
+{
+    // The reset line is active low
+    if(false == on)
+    {
+        oledEmuReset();
+    }
+}
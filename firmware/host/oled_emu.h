@@ -0,0 +1,29 @@
+/*
+ * oled_emu.h
+ *
+ * A virtual SSD1306 on a virtual I2C bus, for building the display code on a
+ * PC. This replaces cnlohr_i2c.c and gpio_user.c's setOledResetOn()
+ */
+
+#ifndef _OLED_EMU_H_
+#define _OLED_EMU_H_
+
+#include <c_types.h>
+
+typedef struct
+{
+    uint32_t bytes;        ///< I2C bytes, including slave addresses
+    uint32_t transfers;    ///< Addressed writes or reads, each costs a start condition
+    uint32_t transactions; ///< Start to end transaction pairs
+    uint32_t cmdBytes;     ///< Command and argument bytes decoded
+    uint32_t dataBytes;    ///< Bytes written to display RAM
+} oledEmuStats_t;
+
+void oledEmuReset(void);
+bool oledEmuGetPixel(int16_t x, int16_t y);
+void oledEmuGetStats(oledEmuStats_t* stats);
+void oledEmuResetStats(void);
+bool oledEmuWritePbm(const char* path);
+int32_t oledEmuComparePbm(const char* path);
+
+#endif
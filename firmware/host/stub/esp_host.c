@@ -0,0 +1,154 @@
+/*
+ * esp_host.c
+ *
+ * PC implementations of the SDK functions declared in esp_host.h. Time is
+ * simulated, so tests are repeatable. It only moves when a test moves it, or
+ * by a fixed step every time it is read
+ */
+
+#include "esp_host.h"
+
+static uint32_t hostTimeUs = 0;
+static uint32_t hostTimeStepUs = 0;
+static int32_t hostMallocsLeft = -1;
+static uint32_t hostPosts = 0;
+
+/**
+ * @brief Allocate memory, or fail if a test asked for it
+ *
+ * @param size The number of bytes to allocate
+ * @return The memory, or NULL
+ */
+void* os_malloc(size_t size)
+{
+    if(0 == hostMallocsLeft)
+    {
+        return NULL;
+    }
+    if(0 < hostMallocsLeft)
+    {
+        hostMallocsLeft--;
+    }
+    return malloc(size);
+}
+
+/**
+ * @brief Allocate zeroed memory, or fail if a test asked for it
+ *
+ * @param size The number of bytes to allocate
+ * @return The memory, or NULL
+ */
+void* os_zalloc(size_t size)
+{
+    void* ptr = os_malloc(size);
+    if(NULL != ptr)
+    {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void os_free(void* ptr)
+{
+    free(ptr);
+}
+
+/**
+ * @return The simulated time, in microseconds. It wraps like the real one
+ */
+uint32_t system_get_time(void)
+{
+    uint32_t now = hostTimeUs;
+    hostTimeUs += hostTimeStepUs;
+    return now;
+}
+
+bool system_os_post(uint8_t prio __attribute__((unused)),
+                    uint32_t sig __attribute__((unused)),
+                    uint32_t par __attribute__((unused)))
+{
+    hostPosts++;
+    return true;
+}
+
+bool system_os_task(os_task_t task __attribute__((unused)),
+                    uint8_t prio __attribute__((unused)),
+                    os_event_t* queue __attribute__((unused)),
+                    uint8_t qlen __attribute__((unused)))
+{
+    return true;
+}
+
+void ets_intr_lock(void)
+{
+}
+
+void ets_intr_unlock(void)
+{
+}
+
+void os_timer_disarm(os_timer_t* timer)
+{
+    timer->timer_period = 0;
+}
+
+void os_timer_setfn(os_timer_t* timer, os_timer_func_t* fn, void* arg)
+{
+    timer->timer_func = fn;
+    timer->timer_arg = arg;
+}
+
+void os_timer_arm(os_timer_t* timer, uint32_t ms, bool repeat)
+{
+    timer->timer_expire = hostTimeUs + (ms * 1000);
+    timer->timer_period = repeat ? ms : 0;
+}
+
+/**
+ * @brief Set the simulated time
+ *
+ * @param us The new time, in microseconds
+ */
+void hostSetTime(uint32_t us)
+{
+    hostTimeUs = us;
+}
+
+/**
+ * @brief Move the simulated time forward
+ *
+ * @param us How far to move it, in microseconds
+ */
+void hostAdvanceTime(uint32_t us)
+{
+    hostTimeUs += us;
+}
+
+/**
+ * @brief Make every system_get_time() call move the time forward, so code
+ * which loops until a time budget runs out still finishes
+ *
+ * @param us How far each read moves the time, 0 to only move it by hand
+ */
+void hostSetTimeStep(uint32_t us)
+{
+    hostTimeStepUs = us;
+}
+
+/**
+ * @brief Make os_malloc() fail after some number of allocations
+ *
+ * @param allocs The number of allocations which succeed first, -1 to never fail
+ */
+void hostFailMallocAfter(int32_t allocs)
+{
+    hostMallocsLeft = allocs;
+}
+
+/**
+ * @return The number of system_os_post() calls so far
+ */
+uint32_t hostOsPosts(void)
+{
+    return hostPosts;
+}
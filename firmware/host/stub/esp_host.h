@@ -0,0 +1,108 @@
+/*
+ * esp_host.h
+ *
+ * Just enough of the ESP8266 NONOS SDK to build the portable parts of the
+ * firmware on a PC. Every SDK header the firmware includes is redirected here
+ */
+
+#ifndef _ESP_HOST_H_
+#define _ESP_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*==============================================================================
+ * Attributes and types
+ *============================================================================*/
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define ICACHE_RAM_ATTR
+
+#define BIT(n) (1u << (n))
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t sint8;
+typedef int16_t sint16;
+typedef int32_t sint32;
+
+typedef void os_timer_func_t(void* timer_arg);
+
+typedef struct _os_timer_t
+{
+    struct _os_timer_t* timer_next;
+    uint32_t timer_expire;
+    uint32_t timer_period;
+    os_timer_func_t* timer_func;
+    void* timer_arg;
+} os_timer_t;
+
+typedef struct
+{
+    uint32_t sig;
+    uint32_t par;
+} os_event_t;
+
+typedef void (*os_task_t)(os_event_t* e);
+
+/*==============================================================================
+ * libc wrappers
+ *============================================================================*/
+
+#define ets_memcpy  memcpy
+#define ets_memset  memset
+#define ets_memcmp  memcmp
+#define ets_memmove memmove
+#define ets_strlen  strlen
+#define ets_strcmp  strcmp
+#define ets_strncmp strncmp
+#define ets_strncpy strncpy
+#define ets_snprintf snprintf
+#define ets_sprintf sprintf
+#define os_memcpy   memcpy
+#define os_memset   memset
+#define os_memcmp   memcmp
+#define os_strlen   strlen
+#define os_strcmp   strcmp
+#define os_sprintf  sprintf
+#define os_snprintf snprintf
+#define os_printf   printf
+
+#define ets_delay_us(us) ((void)(us))
+#define os_delay_us(us)  ((void)(us))
+
+/*==============================================================================
+ * SDK functions, implemented in esp_host.c
+ *============================================================================*/
+
+void* os_malloc(size_t size);
+void* os_zalloc(size_t size);
+void os_free(void* ptr);
+
+uint32_t system_get_time(void);
+bool system_os_post(uint8_t prio, uint32_t sig, uint32_t par);
+bool system_os_task(os_task_t task, uint8_t prio, os_event_t* queue, uint8_t qlen);
+void ets_intr_lock(void);
+void ets_intr_unlock(void);
+
+void os_timer_disarm(os_timer_t* timer);
+void os_timer_setfn(os_timer_t* timer, os_timer_func_t* fn, void* arg);
+void os_timer_arm(os_timer_t* timer, uint32_t ms, bool repeat);
+
+/*==============================================================================
+ * Host controls, for tests
+ *============================================================================*/
+
+void hostSetTime(uint32_t us);
+void hostAdvanceTime(uint32_t us);
+void hostSetTimeStep(uint32_t us);
+void hostFailMallocAfter(int32_t allocs);
+uint32_t hostOsPosts(void);
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * test_beat.c
+ *
+ * Runs the labelled clips in clips/beat through the mic front end and
+ * embeddedbeat.c, the way mode_colorchord.c does, and scores what it finds
+ * against the labels. Onsets and beats are matched to labels within
+ * BEAT_TOLERANCE_MS, then precision, recall and F-measure are reported with the
+ * final tempo. The checks fail if any of them drop below the thresholds here
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <math.h>
+
+#include "host_test.h"
+#include "wav.h"
+#include "cc_pipeline.h"
+#include "embeddedbeat.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define BEAT_CLIP_DIR "clips/beat/"
+
+// How far a detection can be from its label and still count
+#define BEAT_TOLERANCE_MS 70
+
+// Detections before these times aren't scored, while the threshold and the
+// tempo settle
+#define ONSET_SETTLE_MS 1000
+#define BEAT_SETTLE_MS  4000
+
+#define MAX_LABELS 256
+
+// The worst each clip may score
+#define MIN_ONSET_F  0.9
+#define MIN_BEAT_F   0.8
+#define MAX_BPM_ERR  0.04
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    uint32_t ms[MAX_LABELS];
+    uint16_t n;
+} beatTimes_t;
+
+typedef struct
+{
+    uint8_t bpm;
+    beatTimes_t onsets;
+    beatTimes_t beats;
+} beatLabels_t;
+
+typedef struct
+{
+    uint16_t hits;
+    uint16_t detections;
+    uint16_t labels;
+} beatScore_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+HOST_TEST_GLOBALS;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Read the labels for a clip, written by gen_clips
+ *
+ * @param path   The .txt file
+ * @param labels Returns the labels
+ * @return true if they were read
+ */
+static bool readLabels(const char* path, beatLabels_t* labels)
+{
+    memset(labels, 0, sizeof(beatLabels_t));
+    FILE* f = fopen(path, "r");
+    if(NULL == f)
+    {
+        return false;
+    }
+
+    char kind[16];
+    double value;
+    while(2 == fscanf(f, "%15s %lf", kind, &value))
+    {
+        beatTimes_t* times = NULL;
+        if(0 == strcmp(kind, "bpm"))
+        {
+            labels->bpm = (uint8_t)value;
+        }
+        else if(0 == strcmp(kind, "onset"))
+        {
+            times = &labels->onsets;
+        }
+        else if(0 == strcmp(kind, "beat"))
+        {
+            times = &labels->beats;
+        }
+
+        if(NULL != times && times->n < MAX_LABELS)
+        {
+            times->ms[times->n++] = (uint32_t)lround(value * 1000);
+        }
+    }
+    fclose(f);
+    return (0 != labels->bpm);
+}
+
+/**
+ * @brief Match detections to labels, each label at most once
+ *
+ * @param found    The detections
+ * @param labels   The labels
+ * @param settleMs Detections and labels before this aren't scored
+ * @return The score
+ */
+static beatScore_t scoreTimes(const beatTimes_t* found, const beatTimes_t* labels, uint32_t settleMs)
+{
+    beatScore_t score = {0};
+    bool used[MAX_LABELS] = {false};
+    uint16_t i, j;
+    for(j = 0; j < labels->n; j++)
+    {
+        if(labels->ms[j] >= settleMs)
+        {
+            score.labels++;
+        }
+    }
+    for(i = 0; i < found->n; i++)
+    {
+        if(found->ms[i] < settleMs)
+        {
+            continue;
+        }
+        score.detections++;
+        for(j = 0; j < labels->n; j++)
+        {
+            uint32_t dist = (found->ms[i] > labels->ms[j]) ? (found->ms[i] - labels->ms[j]) :
+                            (labels->ms[j] - found->ms[i]);
+            if(!used[j] && dist <= BEAT_TOLERANCE_MS)
+            {
+                used[j] = true;
+                score.hits++;
+                break;
+            }
+        }
+    }
+    return score;
+}
+
+/**
+ * @brief The F-measure of a score, and print it
+ *
+ * @param what  What was scored
+ * @param score The score
+ * @return The F-measure, 0 to 1
+ */
+static double printScore(const char* what, beatScore_t score)
+{
+    double precision = score.detections ? (double)score.hits / score.detections : 0;
+    double recall = score.labels ? (double)score.hits / score.labels : 0;
+    double f = (precision + recall > 0) ? (2 * precision * recall) / (precision + recall) : 0;
+    printf("  %-6s %3u of %3u found, %3u detected, precision %.2f recall %.2f F %.2f\n",
+           what, score.hits, score.labels, score.detections, precision, recall, f);
+    return f;
+}
+
+/**
+ * @brief Run a labelled clip through the beat tracker and check its scores
+ *
+ * @param name The clip's name, without an extension, in BEAT_CLIP_DIR
+ */
+static void testClip(const char* name)
+{
+    char path[64];
+    beatLabels_t labels;
+    snprintf(path, sizeof(path), BEAT_CLIP_DIR "%s.txt", name);
+    CHECK(readLabels(path, &labels));
+
+    wav_t wav;
+    snprintf(path, sizeof(path), BEAT_CLIP_DIR "%s.wav", name);
+    CHECK(wavRead(path, &wav));
+    CHECK_EQ(wav.sampleRate, CC_SAMPLE_RATE);
+    if(0 == labels.bpm || NULL == wav.samples)
+    {
+        wavFree(&wav);
+        return;
+    }
+
+    static beatTimes_t onsets, beats;
+    memset(&onsets, 0, sizeof(onsets));
+    memset(&beats, 0, sizeof(beats));
+
+    ccPipelineInit();
+    InitBeat();
+    int16_t samples[CC_FRAME_SAMPLES];
+    uint32_t frame;
+    for(frame = 0; (frame + 1) * CC_FRAME_SAMPLES <= wav.numSamples; frame++)
+    {
+        ccFrontEnd(&wav.samples[frame * CC_FRAME_SAMPLES], samples, CC_FRAME_SAMPLES);
+        PushSamples32(samples, CC_FRAME_SAMPLES);
+        NewFrameInfo();
+        uint8_t flags = HandleBeatFrame();
+
+        // A detection is timed at the end of the frame it was found in
+        uint32_t ms = ((frame + 1) * CC_FRAME_SAMPLES * 1000) / CC_SAMPLE_RATE;
+        if((flags & BEAT_FLAG_ONSET) && onsets.n < MAX_LABELS)
+        {
+            onsets.ms[onsets.n++] = ms;
+        }
+        if((flags & BEAT_FLAG_BEAT) && beats.n < MAX_LABELS)
+        {
+            beats.ms[beats.n++] = ms;
+        }
+    }
+    wavFree(&wav);
+
+    double bpmErr = fabs((double)beat_bpm - labels.bpm) / labels.bpm;
+    printf("%s: %u bpm, found %u bpm with confidence %u\n", name, labels.bpm, beat_bpm, beat_confidence);
+    double onsetF = printScore("onsets", scoreTimes(&onsets, &labels.onsets, ONSET_SETTLE_MS));
+    double beatF = printScore("beats", scoreTimes(&beats, &labels.beats, BEAT_SETTLE_MS));
+
+    CHECK(bpmErr <= MAX_BPM_ERR);
+    CHECK(onsetF >= MIN_ONSET_F);
+    CHECK(beatF >= MIN_BEAT_F);
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(void)
+{
+    static const char* const clips[] =
+    {
+        "kick_75",
+        "kick_120",
+        "kick_snare_100",
+        "kick_snare_150",
+    };
+
+    uint8_t i;
+    for(i = 0; i < sizeof(clips) / sizeof(clips[0]); i++)
+    {
+        testClip(clips[i]);
+    }
+    return hostTestSummary("test_beat");
+}
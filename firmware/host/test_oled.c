@@ -0,0 +1,1004 @@
+/*
+ * test_oled.c
+ *
+ * Golden frame tests for the display code. Each case draws with one family of
+ * routines, flushes to the emulated OLED and compares what the glass shows to
+ * a PBM in golden/oled. Run with --update to rewrite the PBMs, then look at
+ * them before committing
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include "host_test.h"
+#include "oled_emu.h"
+#include "asset_image.h"
+
+#include "oled.h"
+#include "sprite.h"
+#include "font.h"
+#include "bresenham.h"
+#include "assets.h"
+#include "synced_timer.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define GOLDEN_DIR "golden/oled/"
+#define OUT_DIR "build/out/"
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    const char* name;
+    void (*draw)(void);
+    bool matchesFb; ///< false if overlays are shown, which aren't in currentFb
+} goldenCase_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+HOST_TEST_GLOBALS;
+
+// The framebuffer, to compare draws against each other
+extern uint8_t currentFb[];
+
+// Not in oled.h, it's internal to the flush
+uint8_t findDiffRuns(uint8_t* prior, uint8_t* curr, int16_t* searchBounds, int16_t runs[][2]);
+
+static bool updateGoldens = false;
+
+static const sprite_t testSprite =
+{
+    .width = 8,
+    .height = 8,
+    .data =
+    {
+        0x3C, 0x42, 0xA5, 0x81, 0xA5, 0x99, 0x42, 0x3C,
+    },
+};
+
+static const char boxArt[] =
+    "..########.."
+    ".#++++++++#."
+    "#++#....#++#"
+    "#+#......#+#"
+    "#+..####..+#"
+    "#+..#++#..+#"
+    "#+..#++#..+#"
+    "#+..####..+#"
+    "#+#......#+#"
+    "#++#....#++#"
+    ".#++++++++#."
+    "..########..";
+
+static const char arrowArt[] =
+    "....##......"
+    "...####....."
+    "..######...."
+    ".##.##.##..."
+    "##..##..##.."
+    "....##......"
+    "....##......"
+    "....##......"
+    "....##++++++"
+    "....##++++++";
+
+static const char* const blinkFrames[] =
+{
+    "################"
+    "#..............#"
+    "#..##......##..#"
+    "#..##......##..#"
+    "#..............#"
+    "#..............#"
+    "#...#......#...#"
+    "#....######....#"
+    "#..............#"
+    "################",
+
+    "################"
+    "#..............#"
+    "#..............#"
+    "#..##......##..#"
+    "#..............#"
+    "#..............#"
+    "#...#......#...#"
+    "#....######....#"
+    "#..............#"
+    "################",
+
+    "################"
+    "#..............#"
+    "#..............#"
+    "#.####....####.#"
+    "#..............#"
+    "#..............#"
+    "#..............#"
+    "#....######....#"
+    "#..............#"
+    "################",
+};
+
+// Taller than a 32 row band, filled in by makeTallArt()
+#define TALL_ART_W 12
+#define TALL_ART_H 40
+#define TALL_GIF_FRAMES 3
+static char tallArt[(TALL_ART_W * TALL_ART_H) + 1];
+static char tallGifArt[TALL_GIF_FRAMES][(TALL_ART_W * TALL_ART_H) + 1];
+
+static gifHandle testGif;
+
+static uint8_t overlayData[2 * OLED_WIDTH];
+static uint8_t overlayMask[2 * OLED_WIDTH];
+static oledOverlay_t testOverlay =
+{
+    .data = overlayData,
+    .mask = overlayMask,
+    .visible = true,
+};
+
+//==============================================================================
+// Draw routines for each case
+//==============================================================================
+
+static void drawPixels(void)
+{
+    int16_t x, y;
+    for(x = 0; x < OLED_WIDTH; x += 3)
+    {
+        drawPixel(x, x / 2, WHITE);
+        drawPixel(x, OLED_HEIGHT - 1 - (x / 2), WHITE);
+    }
+    for(y = 0; y < OLED_HEIGHT; y++)
+    {
+        drawPixel(y % 7, y, WHITE);
+        drawPixel(OLED_WIDTH - 1 - (y % 5), y, WHITE);
+    }
+    // Corners, and some off the edge which must be ignored
+    drawPixel(0, 0, WHITE);
+    drawPixel(OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
+    drawPixel(-1, 10, WHITE);
+    drawPixel(OLED_WIDTH, 10, WHITE);
+    drawPixel(10, OLED_HEIGHT, WHITE);
+    // Black and inverse over white
+    drawPixel(0, 0, INVERSE);
+    drawPixel(3, 1, BLACK);
+}
+
+static void drawFills(void)
+{
+    fillDisplayArea(4, 4, 60, 30, WHITE);
+    fillDisplayArea(10, 10, 50, 20, BLACK);
+    fillDisplayArea(30, 0, 90, 40, INVERSE);
+    // Clipped at every edge
+    fillDisplayArea(-10, 50, 10, 80, WHITE);
+    fillDisplayArea(120, -5, 140, 5, WHITE);
+    // Single rows and columns, odd and even
+    fillDisplayArea(70, 45, 127, 45, WHITE);
+    fillDisplayArea(70, 48, 127, 48, WHITE);
+    fillDisplayArea(100, 20, 100, 63, WHITE);
+    // Empty, must do nothing
+    fillDisplayArea(50, 50, 40, 60, WHITE);
+}
+
+static void drawBlits(void)
+{
+    int16_t x;
+    for(x = 0; x < 32; x++)
+    {
+        // Walk the start row through both halves of the display
+        oledBlitColumn(x * 4, (x * 2) - 8, 0xF0F0F0F5, 32, WHITE);
+        oledBlitColumn((x * 4) + 1, x, 0x7, 3, WHITE);
+    }
+    oledBlitColumn(2, 0, 0xFFFFFFFF, 32, WHITE);
+    oledBlitColumn(2, 4, 0x5, 4, BLACK);
+    oledBlitColumn(2, 32, 0xFFFFFFFF, 32, INVERSE);
+}
+
+static void drawSprites(void)
+{
+    plotSprite(0, 0, &testSprite, WHITE);
+    plotSprite(20, 28, &testSprite, WHITE);
+    fillDisplayArea(40, 20, 80, 40, WHITE);
+    plotSprite(44, 24, &testSprite, BLACK);
+    plotSprite(60, 30, &testSprite, INVERSE);
+    // Partly off the display
+    plotSprite(124, 60, &testSprite, WHITE);
+    plotSprite(-4, 40, &testSprite, WHITE);
+}
+
+static void drawFontTomThumb(void)
+{
+    plotText(0, 0, "THE QUICK BROWN FOX", TOM_THUMB, WHITE);
+    plotText(0, 8, "jumps over 0123456789", TOM_THUMB, WHITE);
+    plotText(0, 16, "!\"#$%&'()*+,-./:;<=>?@", TOM_THUMB, WHITE);
+    fillDisplayArea(0, 30, 127, 40, WHITE);
+    plotText(2, 33, "BLACK ON WHITE", TOM_THUMB, BLACK);
+    plotText(60, 50, "INVERSE", TOM_THUMB, INVERSE);
+}
+
+static void drawFontIbmVga8(void)
+{
+    plotText(0, 0, "ABCDEFGHIJKLM", IBM_VGA_8, WHITE);
+    plotText(0, 12, "nopqrstuvwxyz", IBM_VGA_8, WHITE);
+    plotText(0, 24, "0123456789!?", IBM_VGA_8, WHITE);
+    plotChar(0, 40, '@', font_IbmVga8, WHITE);
+    plotText(20, 40, "off the edge", IBM_VGA_8, WHITE);
+}
+
+static void drawFontRadiostars(void)
+{
+    plotText(0, 0, "SWADGE", RADIOSTARS, WHITE);
+    plotText(0, 16, "2019", RADIOSTARS, WHITE);
+    plotText(0, 32, "magfest", RADIOSTARS, WHITE);
+    plotText(0, 50, "?!", RADIOSTARS, INVERSE);
+}
+
+static void drawLinesRects(void)
+{
+    plotLine(0, 0, 127, 63, WHITE);
+    plotLine(0, 63, 127, 0, WHITE);
+    plotLine(64, 0, 64, 63, WHITE);
+    plotLine(0, 32, 127, 32, INVERSE);
+    plotLine(10, 5, 30, 60, WHITE);
+    plotRect(5, 5, 40, 25, WHITE);
+    plotRect(90, 40, 127, 63, WHITE);
+    plotRect(100, 10, 100, 10, WHITE);
+}
+
+static void drawEllipses(void)
+{
+    plotCircle(20, 20, 15, WHITE);
+    plotCircle(20, 20, 3, WHITE);
+    plotEllipse(70, 20, 30, 10, WHITE);
+    plotOptimizedEllipse(70, 45, 20, 12, WHITE);
+    plotEllipseRect(100, 35, 127, 63, WHITE);
+    plotRotatedEllipse(30, 48, 20, 8, 0.5, WHITE);
+    plotRotatedEllipseRect(2, 36, 30, 62, 100, WHITE);
+    // Partly off the display
+    plotCircle(127, 0, 12, WHITE);
+}
+
+static void drawBeziers(void)
+{
+    plotQuadBezier(0, 63, 64, -40, 127, 63, WHITE);
+    plotQuadRationalBezier(0, 0, 64, 80, 127, 0, 2.0, WHITE);
+    plotCubicBezier(0, 32, 40, 0, 80, 63, 127, 32, WHITE);
+    plotQuadBezierSeg(10, 10, 30, 10, 30, 30, WHITE);
+    plotCubicBezierSeg(60, 5, 70, 5, 80, 20, 90, 20, WHITE);
+}
+
+static void drawSplines(void)
+{
+    int xq[] = {0, 20, 40, 60, 80, 100, 127};
+    int yq[] = {10, 30, 5, 40, 10, 30, 10};
+    plotQuadSpline(6, xq, yq, WHITE);
+
+    int xc[] = {0, 25, 50, 75, 100, 127};
+    int yc[] = {60, 35, 60, 35, 60, 40};
+    plotCubicSpline(5, xc, yc, WHITE);
+}
+
+static void drawBitmaps(void)
+{
+    fillDisplayArea(64, 0, 127, 63, WHITE);
+    // Transparent pixels must leave the white fill alone
+    drawBitmapFromAsset("box.png", 2, 2, false, false, 0);
+    drawBitmapFromAsset("box.png", 70, 2, false, false, 0);
+    drawBitmapFromAsset("arrow.png", 20, 30, false, false, 0);
+    drawBitmapFromAsset("arrow.png", 90, 30, false, false, 0);
+    // Off the edges
+    drawBitmapFromAsset("box.png", -6, 56, false, false, 0);
+    drawBitmapFromAsset("box.png", 122, -6, false, false, 0);
+    // Missing, must do nothing
+    drawBitmapFromAsset("missing.png", 40, 40, false, false, 0);
+}
+
+static void drawBitmapsFlipped(void)
+{
+    drawBitmapFromAsset("arrow.png", 0, 0, false, false, 0);
+    drawBitmapFromAsset("arrow.png", 20, 0, true, false, 0);
+    drawBitmapFromAsset("arrow.png", 40, 0, false, true, 0);
+    drawBitmapFromAsset("arrow.png", 60, 0, true, true, 0);
+    // Straddling the middle row, where the page interleave changes
+    drawBitmapFromAsset("arrow.png", 0, 28, false, true, 0);
+    drawBitmapFromAsset("arrow.png", 20, 27, true, false, 0);
+}
+
+static void drawBitmapsRotated(void)
+{
+    int16_t i;
+    for(i = 0; i < 8; i++)
+    {
+        int16_t deg = (i * 45) + 10;
+        drawBitmapFromAsset("arrow.png", (i % 4) * 32, (i / 4) * 32, false, false, deg);
+    }
+    drawBitmapFromAsset("box.png", 110, 20, true, false, 90);
+}
+
+/**
+ * @brief Step the synced timers far enough for one gif frame
+ */
+static void runGifFrame(void)
+{
+    hostAdvanceTime((testGif.duration * 1000) + 1);
+    syncedTimersCheck();
+}
+
+static void drawGifFirstFrame(void)
+{
+    ets_memset(&testGif, 0, sizeof(testGif));
+    drawGifFromAsset("blink.gif", 56, 27, false, false, 0, &testGif);
+    runGifFrame();
+}
+
+static void drawGifLastFrame(void)
+{
+    // Frames are only redrawn where they changed, so don't clear
+    runGifFrame();
+    runGifFrame();
+}
+
+static void drawGifFlippedRotated(void)
+{
+    freeGifMemory(&testGif);
+    ets_memset(&testGif, 0, sizeof(testGif));
+    drawGifFromAsset("blink.gif", 10, 10, true, false, 30, &testGif);
+    runGifFrame();
+    freeGifMemory(&testGif);
+}
+
+static void drawMenuBar(void)
+{
+    fillDisplayArea(0, 50, 127, 63, WHITE);
+    uint8_t i;
+    for(i = 0; i < 40; i++)
+    {
+        incrementMenuBar();
+    }
+}
+
+static void drawOverlay(void)
+{
+    // The menu bar from the last case must go away
+    zeroMenuBar();
+    fillDisplayArea(0, 0, 127, 63, WHITE);
+    testOverlay.pageMask = oledOverlayPagesForRows(0, 7);
+    oledOverlayClear(&testOverlay);
+    oledAddOverlay(&testOverlay);
+    fillOverlayArea(&testOverlay, 10, 2, 60, 5, BLACK);
+    oledOverlayDrawPixel(&testOverlay, 70, 3, BLACK);
+    oledOverlayDrawPixel(&testOverlay, 71, 3, BLACK);
+    oledOverlayErasePixel(&testOverlay, 71, 3);
+}
+
+static void drawOverlayRemoved(void)
+{
+    oledRemoveOverlay(&testOverlay);
+}
+
+//==============================================================================
+// Test helpers
+//==============================================================================
+
+/**
+ * @brief Count the pixels where the glass doesn't show currentFb
+ *
+ * @return The number of pixels which differ
+ */
+static uint32_t fbMismatches(void)
+{
+    uint32_t diffs = 0;
+    int16_t x, y;
+    for(y = 0; y < OLED_HEIGHT; y++)
+    {
+        for(x = 0; x < OLED_WIDTH; x++)
+        {
+            if(oledEmuGetPixel(x, y) != (WHITE == getPixel(x, y)))
+            {
+                diffs++;
+            }
+        }
+    }
+    return diffs;
+}
+
+/**
+ * @brief Draw a case, send it with a difference update, and check the glass
+ *
+ * @param gc The case to run
+ * @param clear true to clear the display first
+ */
+static void runGoldenCase(const goldenCase_t* gc, bool clear)
+{
+    if(clear)
+    {
+        clearDisplay();
+    }
+    gc->draw();
+    updateOLED(true);
+
+    if(gc->matchesFb)
+    {
+        CHECK_EQ(fbMismatches(), 0);
+    }
+
+    char golden[128];
+    snprintf(golden, sizeof(golden), GOLDEN_DIR "%s.pbm", gc->name);
+    if(updateGoldens)
+    {
+        CHECK(oledEmuWritePbm(golden));
+        return;
+    }
+
+    int32_t diffs = oledEmuComparePbm(golden);
+    if(0 != diffs)
+    {
+        char out[128];
+        snprintf(out, sizeof(out), OUT_DIR "%s.pbm", gc->name);
+        oledEmuWritePbm(out);
+        printf("%s: %d pixels differ from %s, see %s\n", gc->name, diffs, golden, out);
+    }
+    CHECK_EQ(diffs, 0);
+}
+
+/**
+ * @brief Fill in art which is different in every row and column, so any flip
+ * or misplaced band shows
+ *
+ * @param art   w * h + 1 chars to fill in
+ * @param w     The width
+ * @param h     The height
+ * @param phase Shifts the pattern, for the frames of a gif
+ */
+static void makeTallArt(char* art, uint16_t w, uint16_t h, uint16_t phase)
+{
+    uint16_t x, y;
+    for(y = 0; y < h; y++)
+    {
+        for(x = 0; x < w; x++)
+        {
+            char px = '.';
+            if(0 == (x + y + phase) % 5)
+            {
+                px = '#';
+            }
+            else if(3 == (x * y) % 7)
+            {
+                px = '+';
+            }
+            art[(y * w) + x] = px;
+        }
+    }
+    art[w * h] = 0;
+}
+
+/**
+ * @brief Build the assets partition the bitmap and gif cases draw from
+ */
+static void buildAssets(void)
+{
+    assetImageReset();
+    CHECK(assetImageAddBitmap("box.png", 12, 12, boxArt));
+    CHECK(assetImageAddBitmap("arrow.png", 12, 10, arrowArt));
+    makeTallArt(tallArt, TALL_ART_W, TALL_ART_H, 0);
+    CHECK(assetImageAddBitmap("tall.png", TALL_ART_W, TALL_ART_H, tallArt));
+    const char* tallFrames[TALL_GIF_FRAMES];
+    uint8_t f;
+    for(f = 0; f < TALL_GIF_FRAMES; f++)
+    {
+        makeTallArt(tallGifArt[f], TALL_ART_W, TALL_ART_H, f);
+        tallFrames[f] = tallGifArt[f];
+    }
+    CHECK(assetImageAddGif("tall.gif", TALL_ART_W, TALL_ART_H, 100, TALL_GIF_FRAMES, tallFrames));
+    CHECK(assetImageAddGif("blink.gif", 16, 10, 100, 3, blinkFrames));
+    assetImageLoad();
+}
+
+//==============================================================================
+// Tests
+//==============================================================================
+
+/**
+ * @brief Every draw routine against its golden frame
+ */
+static void testGoldenFrames(void)
+{
+    static const goldenCase_t cases[] =
+    {
+        {"pixels", drawPixels, true},
+        {"fills", drawFills, true},
+        {"blits", drawBlits, true},
+        {"sprites", drawSprites, true},
+        {"font_tomthumb", drawFontTomThumb, true},
+        {"font_ibmvga8", drawFontIbmVga8, true},
+        {"font_radiostars", drawFontRadiostars, true},
+        {"lines_rects", drawLinesRects, true},
+        {"ellipses", drawEllipses, true},
+        {"beziers", drawBeziers, true},
+        {"splines", drawSplines, true},
+        {"bitmaps", drawBitmaps, true},
+        {"bitmaps_flipped", drawBitmapsFlipped, true},
+        {"bitmaps_rotated", drawBitmapsRotated, true},
+        {"gif_first", drawGifFirstFrame, true},
+        {"gif_last", drawGifLastFrame, true},
+        {"gif_flip_rot", drawGifFlippedRotated, true},
+        {"menu_bar", drawMenuBar, false},
+        {"overlay", drawOverlay, false},
+        {"overlay_removed", drawOverlayRemoved, true},
+    };
+
+    uint8_t i;
+    for(i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        // The gif's later frames draw over its first
+        runGoldenCase(&cases[i], (cases[i].draw != drawGifLastFrame));
+    }
+    freeGifMemory(&testGif);
+}
+
+/**
+ * @brief Random drawing, flushed whole, by difference, and time sliced. The
+ * glass must always end up showing the framebuffer and menu bar
+ */
+static void testRandomFlushes(void)
+{
+    srand(2);
+    uint8_t bar = 0;
+    zeroMenuBar();
+    hostSetTimeStep(300);
+
+    uint32_t mismatchedFrames = 0;
+    uint16_t it;
+    for(it = 0; it < 2000; it++)
+    {
+        if(0 == rand() % 5)
+        {
+            clearDisplay();
+        }
+        int16_t x1 = rand() % OLED_WIDTH;
+        int16_t y1 = rand() % OLED_HEIGHT;
+        fillDisplayArea(x1, y1, x1 + (rand() % 20), y1 + (rand() % 20), rand() % 3);
+
+        int r = rand() % 20;
+        if(0 == r)
+        {
+            zeroMenuBar();
+            bar = 0;
+        }
+        else if(r < 8 && bar < OLED_WIDTH - 1)
+        {
+            bar = incrementMenuBar();
+        }
+
+        switch(rand() % 3)
+        {
+            case 0:
+            {
+                updateOLED(true);
+                break;
+            }
+            case 1:
+            {
+                while(FRAME_IN_PROGRESS == updateOLEDBudgeted(true));
+                break;
+            }
+            default:
+            {
+                updateOLED(false);
+                break;
+            }
+        }
+
+        // The menu bar covers the bottom row up to its length
+        int16_t x, y;
+        bool ok = true;
+        for(y = 0; y < OLED_HEIGHT && ok; y++)
+        {
+            for(x = 0; x < OLED_WIDTH && ok; x++)
+            {
+                bool expect = (0 < bar && OLED_HEIGHT - 1 == y) ? (x <= bar) : (WHITE == getPixel(x, y));
+                ok = (expect == oledEmuGetPixel(x, y));
+            }
+        }
+        if(false == ok)
+        {
+            mismatchedFrames++;
+        }
+    }
+    hostSetTimeStep(0);
+    zeroMenuBar();
+    updateOLED(true);
+    CHECK_EQ(mismatchedFrames, 0);
+}
+
+/**
+ * @brief The OLED's own traffic accounting must agree with the bus
+ */
+static void testTrafficStats(void)
+{
+    clearDisplay();
+    updateOLED(true);
+    resetOLEDStats();
+    oledEmuResetStats();
+
+    fillDisplayArea(0, 0, 3, 3, WHITE);
+    fillDisplayArea(120, 60, 127, 63, WHITE);
+    updateOLED(true);
+    updateOLED(false);
+
+    oledStats_t stats;
+    getOLEDStats(&stats);
+    oledEmuStats_t bus;
+    oledEmuGetStats(&bus);
+
+    CHECK_EQ(stats.framesSent, 2);
+    CHECK_EQ(stats.totalBytes, bus.bytes);
+    CHECK_EQ(stats.totalTransfers, bus.transfers);
+    // A whole frame sends every byte of display RAM
+    CHECK(bus.dataBytes >= OLED_WIDTH * (OLED_HEIGHT / 8));
+    // Only the dirty spans were compared, and only the runs were copied
+    CHECK(stats.totalCompared < OLED_WIDTH * (OLED_HEIGHT / 8));
+    CHECK(stats.totalCopied >= bus.dataBytes);
+    // Nothing changed, nothing is sent
+    CHECK_EQ(updateOLED(true), NOTHING_TO_DO);
+}
+
+/**
+ * @brief Past the most runs per page, the two closest runs are merged
+ */
+static void testDiffRunMerging(void)
+{
+    // Nine changes, 13 columns apart except for one gap of 12, which is the
+    // smallest but still too far apart to merge for free
+    static const int16_t diffCols[] = {0, 14, 27, 41, 55, 69, 83, 97, 111};
+    uint8_t prior[OLED_WIDTH] = {0};
+    uint8_t curr[OLED_WIDTH] = {0};
+    uint8_t i;
+    for(i = 0; i < sizeof(diffCols) / sizeof(diffCols[0]); i++)
+    {
+        curr[diffCols[i]] = 0x01;
+    }
+
+    int16_t bounds[2] = {0, OLED_WIDTH - 1};
+    int16_t runs[8][2];
+    CHECK_EQ(findDiffRuns(prior, curr, bounds, runs), 8);
+    CHECK_EQ(runs[0][0], 0);
+    CHECK_EQ(runs[0][1], 0);
+    CHECK_EQ(runs[1][0], 14);
+    CHECK_EQ(runs[1][1], 27);
+    CHECK_EQ(runs[2][0], 41);
+    CHECK_EQ(runs[7][0], 111);
+    CHECK_EQ(runs[7][1], 111);
+
+    // A wider gap at the end is left alone, the closest pair is merged instead
+    curr[111] = 0;
+    curr[127] = 0x01;
+    CHECK_EQ(findDiffRuns(prior, curr, bounds, runs), 8);
+    CHECK_EQ(runs[1][1], 27);
+    CHECK_EQ(runs[7][0], 127);
+
+    // Changes close together are one run
+    memset(curr, 0, sizeof(curr));
+    curr[50] = curr[55] = curr[60] = 0x01;
+    CHECK_EQ(findDiffRuns(prior, curr, bounds, runs), 1);
+    CHECK_EQ(runs[0][0], 50);
+    CHECK_EQ(runs[0][1], 60);
+}
+
+/**
+ * @brief A change a column or two wide down the display is sent as one
+ * window, and the runs sent after it are still addressed by page
+ */
+static void testColumnWindow(void)
+{
+    clearDisplay();
+    fillDisplayArea(41, 0, 41, OLED_HEIGHT - 1, WHITE);
+    updateOLED(false);
+    CHECK_EQ(fbMismatches(), 0);
+
+    // Draw a column and blank the one after it, like the waterfall
+    int16_t y;
+    for(y = 0; y < OLED_HEIGHT; y++)
+    {
+        drawPixel(40, y, (y % 3) ? BLACK : WHITE);
+    }
+    fillDisplayArea(41, 0, 41, OLED_HEIGHT - 1, BLACK);
+    oledEmuResetStats();
+    CHECK_EQ(updateOLED(true), FRAME_DRAWN);
+
+    oledStats_t stats;
+    getOLEDStats(&stats);
+    oledEmuStats_t bus;
+    oledEmuGetStats(&bus);
+    CHECK_EQ(fbMismatches(), 0);
+    CHECK_EQ(stats.lastFrameRuns, 1);
+    // Two columns of every page in one data write, plus the addressing
+    CHECK_EQ(bus.dataBytes, 2 * (OLED_HEIGHT / 8));
+    CHECK_EQ(bus.transfers, 5);
+
+    // Back in page addressing, runs in a few pages land where they should
+    fillDisplayArea(10, 5, 100, 20, WHITE);
+    fillDisplayArea(60, 50, 70, 52, WHITE);
+    updateOLED(true);
+    getOLEDStats(&stats);
+    CHECK(stats.lastFrameRuns > 1);
+    CHECK_EQ(fbMismatches(), 0);
+
+    // Columns far apart are sent as runs, not a window across them
+    fillDisplayArea(2, 0, 2, OLED_HEIGHT - 1, WHITE);
+    fillDisplayArea(120, 0, 120, OLED_HEIGHT - 1, WHITE);
+    updateOLED(true);
+    getOLEDStats(&stats);
+    CHECK(stats.lastFrameRuns > 1);
+    CHECK_EQ(fbMismatches(), 0);
+}
+
+/**
+ * @brief Check a bitmap of tallArt was drawn pixel for pixel, over a display
+ * which was white in the top half and black in the bottom
+ *
+ * @param xp     Where the bitmap was drawn
+ * @param yp     Where the bitmap was drawn
+ * @param flipLR Whether it was flipped left to right
+ * @param flipUD Whether it was flipped upside down
+ * @return The number of pixels which are wrong
+ */
+static uint32_t tallBitmapMismatches(int16_t xp, int16_t yp, bool flipLR, bool flipUD)
+{
+    uint32_t diffs = 0;
+    int16_t x, y;
+    for(y = 0; y < TALL_ART_H; y++)
+    {
+        for(x = 0; x < TALL_ART_W; x++)
+        {
+            int16_t dx = xp + (flipLR ? (TALL_ART_W - 1 - x) : x);
+            int16_t dy = yp + (flipUD ? (TALL_ART_H - 1 - y) : y);
+            color expect = (dy < OLED_HEIGHT / 2) ? WHITE : BLACK;
+            switch(tallArt[(y * TALL_ART_W) + x])
+            {
+                case '#':
+                {
+                    expect = WHITE;
+                    break;
+                }
+                case '+':
+                {
+                    expect = BLACK;
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+            if(getPixel(dx, dy) != expect)
+            {
+                diffs++;
+            }
+        }
+    }
+    return diffs;
+}
+
+/**
+ * @brief Bitmaps taller than a 32 row band use the top bit of the band's
+ * columns, with and without flipping
+ */
+static void testTallBitmaps(void)
+{
+    static const struct
+    {
+        int16_t x;
+        int16_t y;
+        bool flipLR;
+        bool flipUD;
+    } draws[] =
+    {
+        {2, 0, false, false},
+        {20, 3, false, true},
+        {40, 24, true, false},
+        {60, 17, true, true},
+    };
+
+    uint8_t i;
+    for(i = 0; i < sizeof(draws) / sizeof(draws[0]); i++)
+    {
+        clearDisplay();
+        fillDisplayArea(0, 0, OLED_WIDTH - 1, (OLED_HEIGHT / 2) - 1, WHITE);
+        drawBitmapFromAsset("tall.png", draws[i].x, draws[i].y, draws[i].flipLR, draws[i].flipUD, 0);
+        CHECK_EQ(tallBitmapMismatches(draws[i].x, draws[i].y, draws[i].flipLR, draws[i].flipUD), 0);
+    }
+    clearDisplay();
+    updateOLED(true);
+}
+
+/**
+ * @brief Gifs taller than 32 rows are blitted a band at a time too. Every
+ * frame must show, with and without flipping
+ */
+static void testTallGif(void)
+{
+    static const bool flips[] = {false, true};
+    uint8_t i;
+    for(i = 0; i < sizeof(flips) / sizeof(flips[0]); i++)
+    {
+        gifHandle gif;
+        ets_memset(&gif, 0, sizeof(gif));
+        clearDisplay();
+        drawGifFromAsset("tall.gif", 30, 12, flips[i], flips[i], 0, &gif);
+        uint8_t f;
+        for(f = 0; f < TALL_GIF_FRAMES; f++)
+        {
+            hostAdvanceTime((gif.duration * 1000) + 1);
+            syncedTimersCheck();
+
+            // Unlike a bitmap, a gif has no transparent pixels
+            uint32_t diffs = 0;
+            int16_t x, y;
+            for(y = 0; y < TALL_ART_H; y++)
+            {
+                for(x = 0; x < TALL_ART_W; x++)
+                {
+                    int16_t dx = 30 + (flips[i] ? (TALL_ART_W - 1 - x) : x);
+                    int16_t dy = 12 + (flips[i] ? (TALL_ART_H - 1 - y) : y);
+                    color expect = ('#' == tallGifArt[f][(y * TALL_ART_W) + x]) ? WHITE : BLACK;
+                    if(getPixel(dx, dy) != expect)
+                    {
+                        diffs++;
+                    }
+                }
+            }
+            CHECK_EQ(diffs, 0);
+        }
+        freeGifMemory(&gif);
+    }
+    clearDisplay();
+    updateOLED(true);
+}
+
+/**
+ * @brief Rotated bitmaps drawn from the rotation cache must match transforming
+ * every pixel, and the cache must stay within its size
+ */
+static void testRotationCache(void)
+{
+    static uint8_t pixelFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+    static const int16_t degs[] = {10, 45, 90, 135, 200, 271, 359};
+    uint8_t i;
+    for(i = 0; i < sizeof(degs) / sizeof(degs[0]); i++)
+    {
+        setAssetRotationCache(0, 1);
+        clearDisplay();
+        drawBitmapFromAsset("arrow.png", 30, 20, false, true, degs[i]);
+        drawBitmapFromAsset("tall.png", 80, 10, true, false, degs[i]);
+        memcpy(pixelFb, currentFb, sizeof(pixelFb));
+
+        // Filling the cache, then drawing from it
+        setAssetRotationCache(UINT16_MAX, 1);
+        uint8_t pass;
+        for(pass = 0; pass < 2; pass++)
+        {
+            clearDisplay();
+            drawBitmapFromAsset("arrow.png", 30, 20, false, true, degs[i]);
+            drawBitmapFromAsset("tall.png", 80, 10, true, false, degs[i]);
+            CHECK_EQ(memcmp(pixelFb, currentFb, sizeof(pixelFb)), 0);
+        }
+    }
+
+    // Angles are rounded to the step
+    setAssetRotationCache(0, 1);
+    clearDisplay();
+    drawBitmapFromAsset("arrow.png", 30, 20, false, false, 30);
+    memcpy(pixelFb, currentFb, sizeof(pixelFb));
+    setAssetRotationCache(UINT16_MAX, 15);
+    clearDisplay();
+    drawBitmapFromAsset("arrow.png", 30, 20, false, false, 37);
+    CHECK_EQ(memcmp(pixelFb, currentFb, sizeof(pixelFb)), 0);
+
+    // Room for only a few angles, the oldest are evicted
+    setAssetRotationCache(400, 1);
+    int16_t deg;
+    for(deg = 1; deg < 90; deg++)
+    {
+        drawBitmapFromAsset("arrow.png", 30, 20, false, false, deg);
+        CHECK(getAssetRotationCacheBytes() <= 400);
+    }
+    CHECK(getAssetRotationCacheBytes() > 0);
+
+    // Without memory, every pixel is transformed instead
+    setAssetRotationCache(UINT16_MAX, 1);
+    clearDisplay();
+    hostFailMallocAfter(0);
+    drawBitmapFromAsset("arrow.png", 30, 20, false, false, 30);
+    hostFailMallocAfter(-1);
+    CHECK_EQ(getAssetRotationCacheBytes(), 0);
+    CHECK_EQ(memcmp(pixelFb, currentFb, sizeof(pixelFb)), 0);
+
+    setAssetRotationCache(0, 1);
+    CHECK_EQ(getAssetRotationCacheBytes(), 0);
+    clearDisplay();
+    updateOLED(true);
+}
+
+/**
+ * @brief A gif which can't get its memory isn't started, and doesn't leak or
+ * hold the shared delta buffer
+ */
+static void testGifAllocFailure(void)
+{
+    gifHandle gif;
+    gifHandle other;
+
+    // The frame can't be allocated
+    ets_memset(&gif, 0, sizeof(gif));
+    hostFailMallocAfter(0);
+    drawGifFromAsset("blink.gif", 0, 0, false, false, 0, &gif);
+    hostFailMallocAfter(-1);
+    CHECK(NULL == gif.frame);
+    CHECK(false == gif.timer.isArmed);
+
+    // The delta buffer can't be allocated
+    hostFailMallocAfter(1);
+    drawGifFromAsset("blink.gif", 0, 0, false, false, 0, &gif);
+    hostFailMallocAfter(-1);
+    CHECK(NULL == gif.frame);
+    CHECK(false == gif.timer.isArmed);
+
+    // Trying again with memory works, and another gif shares the buffer
+    drawGifFromAsset("blink.gif", 0, 0, false, false, 0, &gif);
+    CHECK(NULL != gif.frame);
+    CHECK(gif.timer.isArmed);
+    ets_memset(&other, 0, sizeof(other));
+    hostFailMallocAfter(1);
+    drawGifFromAsset("blink.gif", 40, 0, false, false, 0, &other);
+    hostFailMallocAfter(-1);
+    CHECK(NULL != other.frame);
+
+    // Freeing one leaves the buffer for the other, which keeps drawing
+    freeGifMemory(&gif);
+    clearDisplay();
+    hostAdvanceTime((other.duration * 1000) + 1);
+    syncedTimersCheck();
+    CHECK_EQ(getPixel(40, 0), WHITE);
+    freeGifMemory(&other);
+    CHECK(false == other.timer.isArmed);
+    clearDisplay();
+    updateOLED(true);
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(int argc, char** argv)
+{
+    updateGoldens = (2 == argc && 0 == strcmp(argv[1], "--update"));
+    if(0 != system("mkdir -p " OUT_DIR))
+    {
+        return EXIT_FAILURE;
+    }
+
+    buildAssets();
+    CHECK(initOLED(true));
+    CHECK_EQ(fbMismatches(), 0);
+
+    testGoldenFrames();
+    testRandomFlushes();
+    testTrafficStats();
+    testDiffRunMerging();
+    testColumnWindow();
+    testTallBitmaps();
+    testRotationCache();
+    testTallGif();
+    testGifAllocFailure();
+
+    return hostTestSummary("test_oled");
+}
@@ -0,0 +1,243 @@
+/*
+ * test_pitch.c
+ *
+ * Checks embeddedpitch.c against synthesized tones. Each tone is run through
+ * the mic front end and the DFT the way mode_tuner.c does, then FindPitch()
+ * is compared to the tone's real pitch in cents, and PitchToNote() to the
+ * note it should name
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <math.h>
+
+#include "host_test.h"
+#include "cc_pipeline.h"
+#include "embeddedpitch.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+// The same as mode_tuner.c
+#define TUNER_MIN_AMP 256
+
+// Half a second of each tone, enough for the lowest octave's DFT to settle
+#define TONE_FRAMES ((CC_SAMPLE_RATE / 2) / CC_FRAME_SAMPLES)
+#define TONE_AMP 8000
+
+// Each step is about a quarter of a semitone, from below A1 to the top octave
+#define SWEEP_LOW_HZ  60.0
+#define SWEEP_HIGH_HZ 1700.0
+#define SWEEP_STEP    1.0137
+
+// The worst the sweep may do, in cents. Harmonics skew the lowest octave's
+// peaks a little
+#define MAX_ERR_CENTS 12.0
+#define MAX_RMS_CENTS 6.0
+#define MAX_HARMONIC_ERR_CENTS 15.0
+
+// A bin is half a semitone
+#define CENTS_PER_BIN (1200.0 / (FIXBINS / OCTAVES))
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+HOST_TEST_GLOBALS;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Run a tone and its harmonics through the front end and the DFT, then
+ * find its pitch
+ *
+ * @param hz        The fundamental, or 0 for silence
+ * @param harmonics The amplitude of the 2nd harmonic relative to the
+ *                  fundamental, the 3rd is 0.6 of that
+ * @return The pitch from FindPitch()
+ */
+static int32_t pitchOfTone(double hz, double harmonics)
+{
+    ccPipelineInit();
+    int16_t pcm[CC_FRAME_SAMPLES];
+    int16_t samples[CC_FRAME_SAMPLES];
+    uint32_t n = 0;
+    uint32_t frame, i;
+    for(frame = 0; frame < TONE_FRAMES; frame++)
+    {
+        for(i = 0; i < CC_FRAME_SAMPLES; i++, n++)
+        {
+            double t = (double)n / CC_SAMPLE_RATE;
+            double s = sin(2 * M_PI * hz * t) +
+                       (harmonics * sin(2 * M_PI * 2 * hz * t)) +
+                       (harmonics * 0.6 * sin(2 * M_PI * 3 * hz * t));
+            pcm[i] = (int16_t)lround(TONE_AMP * s);
+        }
+        ccFrontEnd(pcm, samples, CC_FRAME_SAMPLES);
+        PushSamples32(samples, CC_FRAME_SAMPLES);
+        NewFrameInfo();
+        PullFrameStage(FRAME_STAGE_BINS);
+    }
+    return FindPitch(TUNER_MIN_AMP);
+}
+
+/**
+ * @brief The pitch of a frequency, in the bins FindPitch() returns
+ *
+ * @param hz The frequency
+ * @return The pitch, in bins above BASE_FREQ
+ */
+static double binOf(double hz)
+{
+    return (FIXBINS / OCTAVES) * log2(hz / BASE_FREQ);
+}
+
+/**
+ * @brief Sweep tones across every octave and check the pitch error, and that
+ * PitchToNote() names the right note
+ *
+ * @param harmonics The amplitude of the 2nd harmonic relative to the
+ *                  fundamental, the 3rd is 0.6 of that
+ * @param maxErr    The worst error allowed, in cents
+ * @param maxRms    The worst RMS error allowed, in cents
+ */
+static void testSweep(double harmonics, double maxErr, double maxRms)
+{
+    double worst = 0;
+    double sumSq = 0;
+    uint16_t tones = 0;
+    uint16_t wrongNotes = 0;
+    double hz;
+    for(hz = SWEEP_LOW_HZ; hz < SWEEP_HIGH_HZ; hz *= SWEEP_STEP)
+    {
+        int32_t pitch = pitchOfTone(hz, harmonics);
+        CHECK(PITCH_NONE != pitch);
+        if(PITCH_NONE == pitch)
+        {
+            continue;
+        }
+
+        double truth = binOf(hz);
+        double err = (((double)pitch / PITCH_BIN_FRAC) - truth) * CENTS_PER_BIN;
+        if(fabs(err) > worst)
+        {
+            worst = fabs(err);
+        }
+        sumSq += err * err;
+        tones++;
+
+        // The note should be right unless the tone is within the error of the
+        // boundary between two notes
+        double semis = truth / 2;
+        double fromCenter = (semis - floor(semis + 0.5)) * 100;
+        uint8_t note, octave;
+        int8_t cents;
+        PitchToNote(pitch, &note, &octave, &cents);
+        if(fabs(fromCenter) < 50 - maxErr &&
+                note != (uint8_t)((long)floor(semis + 0.5) % 12))
+        {
+            wrongNotes++;
+            printf("  %.1f Hz named note %u\n", hz, note);
+        }
+    }
+
+    double rms = sqrt(sumSq / tones);
+    printf("sweep, harmonics %.1f: %u tones, worst %.1f cents, rms %.1f cents, %u wrong notes\n",
+           harmonics, tones, worst, rms, wrongNotes);
+    CHECK(worst <= maxErr);
+    CHECK(rms <= maxRms);
+    CHECK_EQ(wrongNotes, 0);
+}
+
+/**
+ * @brief Check notes, octaves and cents at known pitches
+ */
+static void testPitchToNote(void)
+{
+    uint8_t note, octave;
+    int8_t cents;
+
+    // BASE_FREQ is A1
+    PitchToNote(0, &note, &octave, &cents);
+    CHECK_EQ(note, 0);
+    CHECK_EQ(octave, 1);
+    CHECK_EQ(cents, 0);
+
+    // Octaves change at C, C2 is 3 semitones up
+    PitchToNote(3 * PITCH_SEMITONE, &note, &octave, &cents);
+    CHECK_EQ(note, 3);
+    CHECK_EQ(octave, 2);
+    PitchToNote((3 * PITCH_SEMITONE) - 1, &note, &octave, &cents);
+    CHECK_EQ(octave, 2);
+    PitchToNote((2 * PITCH_SEMITONE), &note, &octave, &cents);
+    CHECK_EQ(note, 2);
+    CHECK_EQ(octave, 1);
+
+    // A4 is 36 semitones up
+    PitchToNote(36 * PITCH_SEMITONE, &note, &octave, &cents);
+    CHECK_EQ(note, 0);
+    CHECK_EQ(octave, 4);
+
+    // A quarter of a semitone sharp and flat
+    PitchToNote((36 * PITCH_SEMITONE) + (PITCH_SEMITONE / 4), &note, &octave, &cents);
+    CHECK_EQ(note, 0);
+    CHECK_EQ(cents, 25);
+    PitchToNote((36 * PITCH_SEMITONE) - (PITCH_SEMITONE / 4), &note, &octave, &cents);
+    CHECK_EQ(note, 0);
+    CHECK_EQ(cents, -25);
+}
+
+/**
+ * @brief Check real tones are named as the right note
+ */
+static void testNamedTones(void)
+{
+    static const struct
+    {
+        double hz;
+        uint8_t note;
+        uint8_t octave;
+    } tones[] =
+    {
+        {82.41, 7, 2},   // E2, a guitar's low string
+        {110.00, 0, 2},  // A2
+        {261.63, 3, 4},  // C4
+        {440.00, 0, 4},  // A4
+        {659.26, 7, 5},  // E5
+        {1318.51, 7, 6}, // E6
+    };
+
+    uint8_t i;
+    for(i = 0; i < sizeof(tones) / sizeof(tones[0]); i++)
+    {
+        int32_t pitch = pitchOfTone(tones[i].hz, 0);
+        uint8_t note = 0, octave = 0;
+        int8_t cents = 0;
+        PitchToNote(pitch, &note, &octave, &cents);
+        CHECK_EQ(note, tones[i].note);
+        CHECK_EQ(octave, tones[i].octave);
+        CHECK(cents >= -MAX_ERR_CENTS && cents <= MAX_ERR_CENTS);
+    }
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(void)
+{
+    // Silence has no pitch
+    CHECK_EQ(pitchOfTone(0, 0), PITCH_NONE);
+
+    testPitchToNote();
+    testNamedTones();
+    testSweep(0, MAX_ERR_CENTS, MAX_RMS_CENTS);
+    // Loud harmonics mustn't pull the pitch up an octave
+    testSweep(1.0, MAX_HARMONIC_ERR_CENTS, MAX_RMS_CENTS);
+    return hostTestSummary("test_pitch");
+}
@@ -0,0 +1,394 @@
+/*
+ * test_synced_timer.c
+ *
+ * Tests for the synced timers' deadline heap, on the simulated clock. Every
+ * test disarms the timers it armed, so the next one starts with an empty heap
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include "host_test.h"
+#include "esp_host.h"
+#include "synced_timer.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+// A millisecond, the unit timers are armed in
+#define MS 1000
+
+#define MAX_CALL_LOG 256
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+HOST_TEST_GLOBALS;
+
+static syncedTimer_t timers[SYNCED_TIMER_MAX_SLOTS + 1];
+static uint32_t calls[SYNCED_TIMER_MAX_SLOTS + 1];
+
+// The order timer functions were called in, by timer index
+static uint8_t callLog[MAX_CALL_LOG];
+static uint16_t callLogLen;
+
+// A timer for countCall() to disarm, when it isn't NULL
+static syncedTimer_t* disarmOnCall = NULL;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief A timer function which counts and logs its calls
+ *
+ * @param arg The timer's index
+ */
+static void countCall(void* arg)
+{
+    uint8_t idx = (uint8_t)(uintptr_t)arg;
+    calls[idx]++;
+    if(callLogLen < MAX_CALL_LOG)
+    {
+        callLog[callLogLen++] = idx;
+    }
+    if(NULL != disarmOnCall)
+    {
+        syncedTimerDisarm(disarmOnCall);
+        disarmOnCall = NULL;
+    }
+}
+
+/**
+ * @brief Give every timer countCall() and clear the counts, at a given time
+ *
+ * @param now The time to start at
+ */
+static void resetTimers(uint32_t now)
+{
+    hostSetTime(now);
+    hostSetTimeStep(0);
+    memset(calls, 0, sizeof(calls));
+    callLogLen = 0;
+    disarmOnCall = NULL;
+    uint8_t i;
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS + 1; i++)
+    {
+        syncedTimerSetFn(&timers[i], countCall, (void*)(uintptr_t)i);
+    }
+}
+
+/**
+ * @brief Disarm every timer, leaving the heap empty
+ */
+static void disarmAll(void)
+{
+    uint8_t i;
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS + 1; i++)
+    {
+        syncedTimerDisarm(&timers[i]);
+    }
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), SYNCED_TIMER_NO_DEADLINE);
+}
+
+/**
+ * @brief Move the clock forward in steps, checking the timers after each. A
+ * timer is due once the clock is past its deadline, not at it
+ *
+ * @param us     How far to move the clock
+ * @param stepUs How far to move it between checks
+ */
+static void runFor(uint32_t us, uint32_t stepUs)
+{
+    uint32_t elapsed;
+    for(elapsed = 0; elapsed < us; elapsed += stepUs)
+    {
+        hostAdvanceTime(stepUs);
+        syncedTimersCheck();
+    }
+}
+
+/**
+ * @brief One shot and repeating timers are called when due and not after
+ * they're disarmed
+ */
+static void testArmDisarm(void)
+{
+    resetTimers(0);
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), SYNCED_TIMER_NO_DEADLINE);
+
+    // A one shot timer is called once, just after its deadline
+    syncedTimerArm(&timers[0], 10, false);
+    CHECK(timers[0].isArmed);
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), 10 * MS);
+    hostAdvanceTime(10 * MS);
+    syncedTimersCheck();
+    CHECK_EQ(calls[0], 0);
+    hostAdvanceTime(1);
+    syncedTimersCheck();
+    CHECK_EQ(calls[0], 1);
+    CHECK(!timers[0].isArmed);
+    runFor(50 * MS, MS);
+    CHECK_EQ(calls[0], 1);
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), SYNCED_TIMER_NO_DEADLINE);
+
+    // A timer disarmed before its deadline is never called
+    syncedTimerArm(&timers[1], 5, false);
+    runFor(4 * MS, MS);
+    syncedTimerDisarm(&timers[1]);
+    runFor(10 * MS, MS);
+    CHECK_EQ(calls[1], 0);
+
+    // A repeating timer keeps its period from its deadlines, not from when it
+    // was called, so checking late doesn't make it drift
+    uint32_t armedAt = system_get_time();
+    syncedTimerArm(&timers[2], 5, true);
+    runFor(100 * MS, 700);
+    CHECK_EQ(calls[2], 20);
+    CHECK_EQ(timers[2].stats.calls, 20);
+    CHECK_EQ((timers[2].stats.lastDeadline - armedAt) % (5 * MS), 0);
+
+    // Rearming moves the deadline rather than adding another
+    syncedTimerArm(&timers[3], 50, false);
+    runFor(20 * MS, MS);
+    syncedTimerArm(&timers[3], 50, false);
+    runFor(40 * MS, MS);
+    CHECK_EQ(calls[3], 0);
+    runFor(11 * MS, MS);
+    CHECK_EQ(calls[3], 1);
+
+    // A timer function can disarm another timer which is also due
+    syncedTimerArm(&timers[4], 1, false);
+    syncedTimerArm(&timers[5], 2, false);
+    disarmOnCall = &timers[5];
+    hostAdvanceTime(5 * MS);
+    syncedTimersCheck();
+    CHECK_EQ(calls[4], 1);
+    CHECK_EQ(calls[5], 0);
+
+    disarmAll();
+}
+
+/**
+ * @brief Timers zeroed without being disarmed, like a mode's struct cleared on
+ * entry, leave stale heap entries which must be dropped, not called
+ */
+static void testZeroAndRearm(void)
+{
+    resetTimers(0);
+
+    syncedTimerArm(&timers[0], 10, true);
+    syncedTimerArm(&timers[1], 20, false);
+
+    // Zeroed while armed, then set up and armed again
+    memset(&timers[0], 0, sizeof(timers[0]));
+    syncedTimerSetFn(&timers[0], countCall, (void*)(uintptr_t)0);
+    syncedTimerArm(&timers[0], 10, true);
+    runFor(101 * MS, MS);
+    CHECK_EQ(calls[0], 10);
+    CHECK_EQ(calls[1], 1);
+
+    // Zeroed while armed and left that way. Its function is NULL now, so
+    // calling it would crash
+    memset(&timers[0], 0, sizeof(timers[0]));
+    runFor(100 * MS, MS);
+    CHECK_EQ(calls[0], 10);
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), SYNCED_TIMER_NO_DEADLINE);
+
+    // Zeroed while armed and rearmed, more times than there are slots. The
+    // stale entries mustn't fill the heap, or the rearm would be refused
+    uint8_t i;
+    for(i = 0; i < 3 * SYNCED_TIMER_MAX_SLOTS; i++)
+    {
+        syncedTimerArm(&timers[2], 1, false);
+        memset(&timers[2], 0, sizeof(timers[2]));
+        syncedTimerSetFn(&timers[2], countCall, (void*)(uintptr_t)2);
+        syncedTimerArm(&timers[2], 1, false);
+        CHECK(timers[2].isArmed);
+        runFor(2 * MS, MS);
+    }
+    CHECK_EQ(calls[2], 3 * SYNCED_TIMER_MAX_SLOTS);
+
+    disarmAll();
+}
+
+/**
+ * @brief Every slot can be used, timers are called in deadline order, and a
+ * timer which doesn't fit isn't left armed
+ */
+static void testFullTable(void)
+{
+    resetTimers(0);
+
+    // Deadlines in a scrambled order, so the heap has to sort them
+    uint8_t i;
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS; i++)
+    {
+        syncedTimerArm(&timers[i], 1 + ((i * 7) % SYNCED_TIMER_MAX_SLOTS), false);
+        CHECK(timers[i].isArmed);
+    }
+
+    // There's no room for one more
+    syncedTimerArm(&timers[SYNCED_TIMER_MAX_SLOTS], 1, false);
+    CHECK(!timers[SYNCED_TIMER_MAX_SLOTS].isArmed);
+
+    // Checked once after every deadline passed, they're still called in order
+    hostAdvanceTime((SYNCED_TIMER_MAX_SLOTS + 1) * MS);
+    syncedTimersCheck();
+    CHECK_EQ(callLogLen, SYNCED_TIMER_MAX_SLOTS);
+    for(i = 0; i < callLogLen; i++)
+    {
+        CHECK_EQ(1 + ((callLog[i] * 7) % SYNCED_TIMER_MAX_SLOTS), i + 1);
+    }
+    CHECK_EQ(calls[SYNCED_TIMER_MAX_SLOTS], 0);
+
+    // Now the table is empty, so the extra timer fits
+    syncedTimerArm(&timers[SYNCED_TIMER_MAX_SLOTS], 1, false);
+    CHECK(timers[SYNCED_TIMER_MAX_SLOTS].isArmed);
+    runFor(2 * MS, MS);
+    CHECK_EQ(calls[SYNCED_TIMER_MAX_SLOTS], 1);
+
+    // A full table of repeating timers, some disarmed from the middle of the
+    // heap, keeps calling the rest on time
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS; i++)
+    {
+        syncedTimerArm(&timers[i], 1 + (i % 4), true);
+    }
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS; i += 3)
+    {
+        syncedTimerDisarm(&timers[i]);
+    }
+    memset(calls, 0, sizeof(calls));
+    runFor((120 * MS) + 250, 250);
+    for(i = 0; i < SYNCED_TIMER_MAX_SLOTS; i++)
+    {
+        CHECK_EQ(calls[i], (0 == i % 3) ? 0 : 120 / (1 + (i % 4)));
+    }
+
+    disarmAll();
+}
+
+/**
+ * @brief system_get_time() wraps about every 71 minutes. Timers armed before
+ * the wrap must still be due in order after it
+ */
+static void testClockWrap(void)
+{
+    resetTimers(0xFFFFFFFF - 2500);
+
+    // Deadlines either side of the wrap
+    syncedTimerArm(&timers[0], 1, true);
+    syncedTimerArm(&timers[1], 3, false);
+    syncedTimerArm(&timers[2], 2, false);
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), MS);
+
+    runFor((10 * MS) + 100, 100);
+    CHECK_EQ(calls[0], 10);
+    CHECK_EQ(calls[1], 1);
+    CHECK_EQ(calls[2], 1);
+
+    // The one shots were called in deadline order, across the wrap
+    uint8_t i;
+    int8_t pos1 = -1, pos2 = -1;
+    for(i = 0; i < callLogLen; i++)
+    {
+        if(1 == callLog[i])
+        {
+            pos1 = i;
+        }
+        else if(2 == callLog[i])
+        {
+            pos2 = i;
+        }
+    }
+    CHECK(0 <= pos2 && pos2 < pos1);
+
+    // The time until the next deadline doesn't jump at the wrap
+    CHECK(syncedTimersUsUntilNextDeadline() <= MS);
+
+    disarmAll();
+}
+
+/**
+ * @brief A repeating timer which fell behind is called back to back, but only
+ * up to SYNCED_TIMER_MAX_CATCH_UP times, and the rest are skipped
+ */
+static void testCatchUp(void)
+{
+    resetTimers(0);
+    syncedTimerArm(&timers[0], 1, true);
+
+    // Five periods late, all five calls are made in one check
+    hostAdvanceTime(5500);
+    syncedTimersCheck();
+    CHECK_EQ(calls[0], 5);
+    CHECK_EQ(timers[0].stats.skipped, 0);
+    CHECK(0 < timers[0].stats.catchUps);
+
+    // 100 periods late, only SYNCED_TIMER_MAX_CATCH_UP calls are made. The
+    // next deadline was 6ms, so at 105.5ms 100 are due
+    hostAdvanceTime(100 * MS);
+    syncedTimersCheck();
+    CHECK_EQ(calls[0], 5 + SYNCED_TIMER_MAX_CATCH_UP);
+    CHECK_EQ(timers[0].stats.skipped, 100 - SYNCED_TIMER_MAX_CATCH_UP);
+
+    // Then it's back on its period, without drifting
+    CHECK_EQ(syncedTimersUsUntilNextDeadline(), 500);
+    runFor(10 * MS, 100);
+    CHECK_EQ(calls[0], 5 + SYNCED_TIMER_MAX_CATCH_UP + 10);
+    CHECK_EQ(timers[0].stats.lastDeadline % MS, 0);
+
+    disarmAll();
+}
+
+/**
+ * @brief A budgeted check stops starting timer functions once its budget is
+ * spent, and the rest run on the next check
+ */
+static void testBudget(void)
+{
+    resetTimers(0);
+    uint8_t i;
+    for(i = 0; i < 8; i++)
+    {
+        syncedTimerArm(&timers[i], 1, false);
+    }
+    hostAdvanceTime(2 * MS);
+
+    // Every read of the clock moves it 100us, so each call costs time
+    hostSetTimeStep(100);
+    syncedTimersCheckBudgeted(500);
+    uint8_t ran = 0;
+    for(i = 0; i < 8; i++)
+    {
+        ran += calls[i];
+    }
+    CHECK(0 < ran && ran < 8);
+
+    syncedTimersCheck();
+    for(i = 0; i < 8; i++)
+    {
+        CHECK_EQ(calls[i], 1);
+    }
+    hostSetTimeStep(0);
+
+    disarmAll();
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(void)
+{
+    testArmDisarm();
+    testZeroAndRearm();
+    testFullTable();
+    testClockWrap();
+    testCatchUp();
+    testBudget();
+    return hostTestSummary("test_synced_timer");
+}
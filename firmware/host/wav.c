@@ -0,0 +1,180 @@
+/*
+ * wav.c
+ *
+ * Reads and writes 16 bit mono PCM WAV files. Chunks other than "fmt " and
+ * "data" are skipped
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wav.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define WAV_FORMAT_PCM 1
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Read a little endian integer
+ *
+ * @param b The bytes to read
+ * @param n The number of bytes, 2 or 4
+ * @return The integer
+ */
+static uint32_t readLE(const uint8_t* b, uint8_t n)
+{
+    uint32_t v = 0;
+    while(n--)
+    {
+        v = (v << 8) | b[n];
+    }
+    return v;
+}
+
+/**
+ * @brief Write a little endian integer
+ *
+ * @param f The file to write to
+ * @param v The integer
+ * @param n The number of bytes, 2 or 4
+ */
+static void writeLE(FILE* f, uint32_t v, uint8_t n)
+{
+    while(n--)
+    {
+        fputc(v & 0xFF, f);
+        v >>= 8;
+    }
+}
+
+/**
+ * @brief Read a WAV file, which must be 16 bit mono PCM
+ *
+ * @param path The file to read
+ * @param wav  Returns the samples, which must be freed with wavFree()
+ * @return true if it was read, false if it couldn't be read or isn't 16 bit
+ *         mono PCM
+ */
+bool wavRead(const char* path, wav_t* wav)
+{
+    memset(wav, 0, sizeof(wav_t));
+    FILE* f = fopen(path, "rb");
+    if(NULL == f)
+    {
+        return false;
+    }
+
+    uint8_t hdr[12];
+    if(1 != fread(hdr, sizeof(hdr), 1, f) || 0 != memcmp(hdr, "RIFF", 4) || 0 != memcmp(&hdr[8], "WAVE", 4))
+    {
+        fclose(f);
+        return false;
+    }
+
+    bool fmtOk = false;
+    uint8_t chunk[8];
+    while(1 == fread(chunk, sizeof(chunk), 1, f))
+    {
+        uint32_t len = readLE(&chunk[4], 4);
+        if(0 == memcmp(chunk, "fmt ", 4) && len >= 16)
+        {
+            uint8_t fmt[16];
+            if(1 != fread(fmt, sizeof(fmt), 1, f))
+            {
+                break;
+            }
+            fmtOk = (WAV_FORMAT_PCM == readLE(&fmt[0], 2) && 1 == readLE(&fmt[2], 2) &&
+                     16 == readLE(&fmt[14], 2));
+            wav->sampleRate = readLE(&fmt[4], 4);
+            fseek(f, (len - sizeof(fmt)) + (len & 1), SEEK_CUR);
+        }
+        else if(0 == memcmp(chunk, "data", 4) && fmtOk)
+        {
+            wav->numSamples = len / 2;
+            wav->samples = (int16_t*)malloc(wav->numSamples * sizeof(int16_t));
+            uint32_t i;
+            for(i = 0; i < wav->numSamples; i++)
+            {
+                uint8_t b[2];
+                if(1 != fread(b, sizeof(b), 1, f))
+                {
+                    wav->numSamples = i;
+                    break;
+                }
+                wav->samples[i] = (int16_t)readLE(b, 2);
+            }
+            fclose(f);
+            return true;
+        }
+        else
+        {
+            // Chunks are padded to an even length
+            fseek(f, len + (len & 1), SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return false;
+}
+
+/**
+ * @brief Write a 16 bit mono PCM WAV file
+ *
+ * @param path       The file to write
+ * @param samples    The samples to write
+ * @param numSamples The number of samples
+ * @param sampleRate The sample rate, in Hz
+ * @return true if it was written, false otherwise
+ */
+bool wavWrite(const char* path, const int16_t* samples, uint32_t numSamples, uint32_t sampleRate)
+{
+    FILE* f = fopen(path, "wb");
+    if(NULL == f)
+    {
+        return false;
+    }
+    uint32_t dataLen = numSamples * 2;
+
+    fwrite("RIFF", 4, 1, f);
+    writeLE(f, 36 + dataLen, 4);
+    fwrite("WAVE", 4, 1, f);
+
+    fwrite("fmt ", 4, 1, f);
+    writeLE(f, 16, 4);
+    writeLE(f, WAV_FORMAT_PCM, 2);
+    writeLE(f, 1, 2);              // Channels
+    writeLE(f, sampleRate, 4);
+    writeLE(f, sampleRate * 2, 4); // Bytes per second
+    writeLE(f, 2, 2);              // Bytes per frame
+    writeLE(f, 16, 2);             // Bits per sample
+
+    fwrite("data", 4, 1, f);
+    writeLE(f, dataLen, 4);
+    uint32_t i;
+    for(i = 0; i < numSamples; i++)
+    {
+        writeLE(f, (uint16_t)samples[i], 2);
+    }
+    return (0 == fclose(f));
+}
+
+/**
+ * @brief Free the samples read by wavRead()
+ *
+ * @param wav The WAV to free
+ */
+void wavFree(wav_t* wav)
+{
+    free(wav->samples);
+    memset(wav, 0, sizeof(wav_t));
+}
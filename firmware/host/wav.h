@@ -0,0 +1,24 @@
+/*
+ * wav.h
+ *
+ * Just enough of the WAV format for the audio harnesses: 16 bit mono PCM
+ */
+
+#ifndef _WAV_H_
+#define _WAV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    int16_t* samples;
+    uint32_t numSamples;
+    uint32_t sampleRate;
+} wav_t;
+
+bool wavRead(const char* path, wav_t* wav);
+bool wavWrite(const char* path, const int16_t* samples, uint32_t numSamples, uint32_t sampleRate);
+void wavFree(wav_t* wav);
+
+#endif
@@ -27,6 +27,14 @@
 
 void ICACHE_FLASH_ATTR plotLine(int x0, int y0, int x1, int y1, color col)
 {
+    /* Horizontal and vertical lines are just thin rectangles */
+    if (x0 == x1 || y0 == y1)
+    {
+        fillDisplayArea(x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1,
+                        x0 < x1 ? x1 : x0, y0 < y1 ? y1 : y0, col);
+        return;
+    }
+
     int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
     int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
     int err = dx + dy, e2; /* error value e_xy */
@@ -10,6 +10,7 @@
 //==============================================================================
 
 #include <osapi.h>
+#include <user_interface.h>
 
 #include "oled.h"
 #include "cnlohr_i2c.h"
@@ -25,6 +26,35 @@
 #define SSD1306_NUM_PAGES 8
 #define SSD1306_NUM_COLS 128
 
+// An empty column span, min > max
+#define SPAN_EMPTY_MIN SSD1306_NUM_COLS
+#define SPAN_EMPTY_MAX -1
+
+// Every cnlohr_i2c_write() costs about two bytes worth of bus time before the
+// payload: the stop/start condition and the slave address
+#define I2C_WRITE_OVERHEAD 2
+// Starting another run within an already addressed page costs a lower and an
+// upper column command (prefix + command each) and a new data prefix
+#define RUN_SETUP_COST ((2 * (I2C_WRITE_OVERHEAD + 2)) + (I2C_WRITE_OVERHEAD + 1))
+// The most runs sent per page. Past this, the two runs with the smallest gap
+// between them are merged. 1 sends one span per page, covering every change
+#ifndef MAX_RUNS_PER_PAGE
+#define MAX_RUNS_PER_PAGE 8
+#endif
+// The most runs queued for one frame
+#define MAX_FLUSH_RUNS (SSD1306_NUM_PAGES * MAX_RUNS_PER_PAGE)
+// Starting a new run in another page also costs a page command
+#define PAGE_SETUP_COST (I2C_WRITE_OVERHEAD + 2)
+// A column window costs switching to vertical addressing and back, setting
+// the column and page windows, and one data prefix
+#define WINDOW_SETUP_COST ((2 * (I2C_WRITE_OVERHEAD + 3)) + (2 * (I2C_WRITE_OVERHEAD + 4)) + (I2C_WRITE_OVERHEAD + 1))
+// The widest change, in columns, which may be sent as one window across pages
+#define WINDOW_MAX_COLS 2
+
+// Default limits for one pass of a budgeted flush, 0 is unlimited
+#define OLED_FLUSH_MAX_RUNS 0
+#define OLED_FLUSH_MAX_US   4000
+
 typedef enum
 {
     HORIZONTAL_ADDRESSING = 0x00,
@@ -85,6 +115,32 @@ typedef enum
     SSD1306_SET_VERTICAL_SCROLL_AREA = 0xA3,
 } SSD1306_cmd;
 
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    uint8_t page;
+    uint8_t lastPage; ///< Past page for a column window, the same otherwise
+    uint8_t firstCol;
+    uint8_t lastCol;
+} oledRun_t;
+
+typedef struct
+{
+    oledRun_t runs[MAX_FLUSH_RUNS];
+    uint8_t numRuns;
+    uint8_t nextRun;
+    bool inProgress;
+    bool err;
+    uint8_t maxRunsPerPass;
+    uint32_t maxUsPerPass;
+    uint32_t frameBytes;
+    uint32_t frameTransfers;
+    uint8_t framePasses;
+} oledFlush_t;
+
 //==============================================================================
 // Internal Function Declarations
 //==============================================================================
@@ -117,11 +173,26 @@ void ICACHE_FLASH_ATTR setPageAddressPagingMode(uint8_t page);
 void ICACHE_FLASH_ATTR setLowerColAddrPagingMode(uint8_t col);
 void ICACHE_FLASH_ATTR setUpperColAddrPagingMode(uint8_t col);
 
-bool ICACHE_FLASH_ATTR findDiffBounds(uint8_t* prior, uint8_t* curr, int16_t* bounds);
-void ICACHE_FLASH_ATTR checkPage(uint8_t page, uint8_t* prior, uint8_t* curr, int16_t* bounds);
+static inline void markSpan(int16_t* span, int16_t col);
+void ICACHE_FLASH_ATTR resetSpans(int16_t spans[][2]);
+
+static inline uint32_t evenBits(uint32_t v);
+static inline uint32_t reverseBits(uint32_t v);
+static inline uint32_t rowRangeMask(int16_t first, int16_t last);
+void ICACHE_FLASH_ATTR columnToPages(uint32_t lo, uint32_t hi, uint8_t* pages);
+void ICACHE_FLASH_ATTR applyColumn(int16_t x, const uint8_t* pages, color c);
 
-void ICACHE_FLASH_ATTR saveOverwriteMenuBar(color* bottomBar);
-void ICACHE_FLASH_ATTR restoreMenuBar(color* bottomBar);
+uint8_t ICACHE_FLASH_ATTR findDiffRuns(uint8_t* prior, uint8_t* curr, int16_t* searchBounds, int16_t runs[][2]);
+void ICACHE_FLASH_ATTR sendRun(uint8_t* fb, oledRun_t* run, bool addressPage);
+void ICACHE_FLASH_ATTR sendColumnWindow(uint8_t* fb, oledRun_t* run);
+void ICACHE_FLASH_ATTR queueColumnWindow(void);
+bool ICACHE_FLASH_ATTR beginFlush(bool drawDifference);
+oledResult_t ICACHE_FLASH_ATTR pumpFlush(uint8_t maxRuns, uint32_t maxUs);
+
+static inline bool fbLocation(int16_t x, int16_t y, int16_t* col, int16_t* row);
+static inline uint16_t overlayOffset(oledOverlay_t* overlay, uint8_t page);
+void ICACHE_FLASH_ATTR markOverlayDirty(oledOverlay_t* overlay);
+uint8_t* ICACHE_FLASH_ATTR composePage(uint8_t page, int16_t firstCol, int16_t lastCol);
 
 //==============================================================================
 // Variables
@@ -132,72 +203,452 @@ uint8_t priorFb[(OLED_WIDTH * (OLED_HEIGHT / 8))] = {0};
 uint8_t mBarLen = 0;
 bool fbChanges = false;
 
+// The return-to-menu progress bar is drawn as an overlay on the bottom row,
+// which is stored in page 0
+uint8_t menuBarData[OLED_WIDTH] = {0};
+uint8_t menuBarMask[OLED_WIDTH] = {0};
+oledOverlay_t menuBarOverlay =
+{
+    .pageMask = (1 << 0),
+    .data = menuBarData,
+    .mask = menuBarMask,
+    .visible = false,
+};
+
+// Overlays composited over currentFb when sending, later ones are on top
+oledOverlay_t* overlays[OLED_MAX_OVERLAYS] = {&menuBarOverlay};
+uint8_t numOverlays = 1;
+
+// A composited page, built while snapshotting the frame
+uint8_t composedPage[SSD1306_NUM_COLS] = {0};
+
+// The frame being sent to the OLED. Runs are sent from priorFb, which holds a
+// snapshot of the frame taken when the flush began, so drawing during a flush
+// never mixes into it
+oledFlush_t oledFlush =
+{
+    .numRuns = 0,
+    .nextRun = 0,
+    .inProgress = false,
+    .err = false,
+    .maxRunsPerPass = OLED_FLUSH_MAX_RUNS,
+    .maxUsPerPass = OLED_FLUSH_MAX_US,
+};
+
+oledStats_t oledStats = {0};
+
+// Per-page column spans of currentFb which may differ from priorFb
+int16_t dirtySpans[SSD1306_NUM_PAGES][2] =
+{
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+};
+
+// Per-page column spans of currentFb which may have set bits. clearDisplay()
+// only has to zero these
+int16_t inkSpans[SSD1306_NUM_PAGES][2] =
+{
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+    {SPAN_EMPTY_MIN, SPAN_EMPTY_MAX},
+};
+
 //==============================================================================
 // Functions
 //==============================================================================
 
 /**
- * Clear the display.
+ * @brief Grow a column span to include the given column
+ *
+ * @param span The span to grow, {min, max}
+ * @param col  The column to include
+ */
+static inline void markSpan(int16_t* span, int16_t col)
+{
+    if(col < span[0])
+    {
+        span[0] = col;
+    }
+    if(col > span[1])
+    {
+        span[1] = col;
+    }
+}
+
+/**
+ * @brief Set every page's span to empty
+ *
+ * @param spans The spans to reset, one {min, max} pair per page
+ */
+void ICACHE_FLASH_ATTR resetSpans(int16_t spans[][2])
+{
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        spans[page][0] = SPAN_EMPTY_MIN;
+        spans[page][1] = SPAN_EMPTY_MAX;
+    }
+}
+
+/**
+ * Clear the display. Only the columns which may have been drawn on since the
+ * last clear are zeroed
  */
 void ICACHE_FLASH_ATTR clearDisplay(void)
 {
-    ets_memset(currentFb, 0, sizeof(currentFb));
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        if(inkSpans[page][0] <= inkSpans[page][1])
+        {
+            ets_memset(&currentFb[(page * SSD1306_NUM_COLS) + inkSpans[page][0]], 0,
+                       inkSpans[page][1] - inkSpans[page][0] + 1);
+            markSpan(dirtySpans[page], inkSpans[page][0]);
+            markSpan(dirtySpans[page], inkSpans[page][1]);
+        }
+    }
+    resetSpans(inkSpans);
     fbChanges = true;
 }
 
 /**
- * TODO
+ * @brief Fill a rectangle of the display with a color. The rectangle is
+ * clipped to the display. The page masks are computed once and applied a
+ * whole byte at a time to each column of each touched page
  *
- * @param x1
- * @param y1
- * @param x2
- * @param y2
- * @param c
+ * @param x1 The left column of the rectangle, inclusive
+ * @param y1 The top row of the rectangle, inclusive
+ * @param x2 The right column of the rectangle, inclusive
+ * @param y2 The bottom row of the rectangle, inclusive
+ * @param c  WHITE, BLACK or INVERSE
  */
 void ICACHE_FLASH_ATTR fillDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c)
 {
-    int16_t x, y;
-    for (x = x1; x <= x2; x++)
+    // Clip to the display
+    if(x1 < 0)
     {
-        for (y = y1; y <= y2; y++)
+        x1 = 0;
+    }
+    if(x2 >= OLED_WIDTH)
+    {
+        x2 = OLED_WIDTH - 1;
+    }
+    if(y1 < 0)
+    {
+        y1 = 0;
+    }
+    if(y2 >= OLED_HEIGHT)
+    {
+        y2 = OLED_HEIGHT - 1;
+    }
+    if(x1 > x2 || y1 > y2)
+    {
+        return;
+    }
+
+    // Build the page bytes for one column
+    uint8_t pages[SSD1306_NUM_PAGES];
+    columnToPages(rowRangeMask(y1, y2), rowRangeMask(y1 - 32, y2 - 32), pages);
+
+    // Then apply them a page at a time, so the spans are only marked once and
+    // untouched pages are skipped entirely. Columns are stored right to left
+    int16_t firstCol = (OLED_WIDTH - 1) - x2;
+    int16_t lastCol = (OLED_WIDTH - 1) - x1;
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        uint8_t mask = pages[page];
+        if(0 == mask)
+        {
+            continue;
+        }
+        markSpan(dirtySpans[page], firstCol);
+        markSpan(dirtySpans[page], lastCol);
+        if(BLACK != c)
         {
-            drawPixel(x, y, c);
+            markSpan(inkSpans[page], firstCol);
+            markSpan(inkSpans[page], lastCol);
+        }
+
+        uint8_t* fb = &currentFb[page * OLED_WIDTH];
+        int16_t col;
+        switch (c)
+        {
+            case WHITE:
+            {
+                for (col = firstCol; col <= lastCol; col++)
+                {
+                    fb[col] |= mask;
+                }
+                break;
+            }
+            case BLACK:
+            {
+                for (col = firstCol; col <= lastCol; col++)
+                {
+                    fb[col] &= ~mask;
+                }
+                break;
+            }
+            case INVERSE:
+            {
+                for (col = firstCol; col <= lastCol; col++)
+                {
+                    fb[col] ^= mask;
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
         }
     }
+    fbChanges = true;
 }
 
 /**
- * Set/clear/invert a single pixel.
+ * @brief Draw up to 32 vertical pixels of one column at once. Only the set
+ * bits are drawn, clear bits leave the framebuffer alone
  *
- * @param x Column of display, 0 is at the left
- * @param y Row of the display, 0 is at the top
- * @param c Pixel color, one of: BLACK, WHITE or INVERT
+ * @param x    Column of display, 0 is at the left
+ * @param y    The row of the first bit, 0 is at the top. May be negative
+ * @param bits The pixels to draw, bit 0 is at row y, bit 1 at row y + 1, etc.
+ * @param h    The number of bits to draw, 1 to 32
+ * @param c    Pixel color, one of: BLACK, WHITE or INVERSE
  */
-void ICACHE_FLASH_ATTR drawPixel(int16_t x, int16_t y, color c)
+void ICACHE_FLASH_ATTR oledBlitColumn(int16_t x, int16_t y, uint32_t bits, uint8_t h, color c)
+{
+    if(x < 0 || x >= OLED_WIDTH || y >= OLED_HEIGHT || y <= -32 || 0 == h)
+    {
+        return;
+    }
+
+    // Trim to the requested height
+    if(h < 32)
+    {
+        bits &= ((1u << h) - 1);
+    }
+
+    // Split the bits into rows 0-31 and rows 32-63
+    uint32_t lo, hi;
+    if(y < 0)
+    {
+        lo = bits >> (-y);
+        hi = 0;
+    }
+    else if(0 == y)
+    {
+        lo = bits;
+        hi = 0;
+    }
+    else if(y < 32)
+    {
+        lo = bits << y;
+        hi = bits >> (32 - y);
+    }
+    else
+    {
+        lo = 0;
+        hi = bits << (y - 32);
+    }
+
+    if(0 == (lo | hi))
+    {
+        return;
+    }
+
+    uint8_t pages[SSD1306_NUM_PAGES];
+    columnToPages(lo, hi, pages);
+    applyColumn(x, pages, c);
+}
+
+/**
+ * @brief Compress the even bits of a word into the lower half of the result
+ *
+ * @param v The word to compress, bits 0, 2, 4... are kept
+ * @return The kept bits, packed into bits 0 through 15
+ */
+static inline uint32_t evenBits(uint32_t v)
+{
+    v &= 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0F0F0F0F;
+    v = (v | (v >> 4)) & 0x00FF00FF;
+    v = (v | (v >> 8)) & 0x0000FFFF;
+    return v;
+}
+
+/**
+ * @brief Reverse the order of bits in a word
+ *
+ * @param v The word to reverse
+ * @return The reversed word, bit 0 swapped with bit 31, etc.
+ */
+static inline uint32_t reverseBits(uint32_t v)
+{
+    v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+    v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F) | ((v & 0x0F0F0F0F) << 4);
+    v = ((v >> 8) & 0x00FF00FF) | ((v & 0x00FF00FF) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+/**
+ * @brief Make a mask of rows within a 32 row word, clipped to the word
+ *
+ * @param first The first row to set, inclusive
+ * @param last  The last row to set, inclusive
+ * @return A mask with bits first through last set
+ */
+static inline uint32_t rowRangeMask(int16_t first, int16_t last)
+{
+    if(first < 0)
+    {
+        first = 0;
+    }
+    if(last > 31)
+    {
+        last = 31;
+    }
+    if(first > last)
+    {
+        return 0;
+    }
+    uint32_t upper = (31 == last) ? 0xFFFFFFFF : ((1u << (last + 1)) - 1);
+    return upper & ~((1u << first) - 1);
+}
+
+/**
+ * @brief Convert one column of rows into the bytes of each page in currentFb.
+ * The OLED is mounted upside down and the odd and even rows are interleaved
+ * between the top and bottom halves of the display RAM, see drawPixel()
+ *
+ * @param lo    Rows 0-31, bit 0 is row 0
+ * @param hi    Rows 32-63, bit 0 is row 32
+ * @param pages The SSD1306_NUM_PAGES bytes to write, one per page
+ */
+void ICACHE_FLASH_ATTR columnToPages(uint32_t lo, uint32_t hi, uint8_t* pages)
+{
+    // Odd rows are stored in reverse in the top half of RAM, pages 0-3
+    uint32_t odd = reverseBits(evenBits(lo >> 1) | (evenBits(hi >> 1) << 16));
+    // Even rows are stored in reverse in the bottom half of RAM, pages 4-7
+    uint32_t even = reverseBits(evenBits(lo) | (evenBits(hi) << 16));
+
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES / 2; page++)
+    {
+        pages[page] = (odd >> (8 * page)) & 0xFF;
+        pages[page + (SSD1306_NUM_PAGES / 2)] = (even >> (8 * page)) & 0xFF;
+    }
+}
+
+/**
+ * @brief Apply page masks to one column of currentFb
+ *
+ * @param x     Column of display, 0 is at the left. Must be on the display
+ * @param pages The SSD1306_NUM_PAGES masks to apply, from columnToPages()
+ * @param c     Pixel color, one of: BLACK, WHITE or INVERSE
+ */
+void ICACHE_FLASH_ATTR applyColumn(int16_t x, const uint8_t* pages, color c)
+{
+    int16_t col = (OLED_WIDTH - 1) - x;
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        if(0 == pages[page])
+        {
+            continue;
+        }
+        fbChanges = true;
+        markSpan(dirtySpans[page], col);
+        switch (c)
+        {
+            case WHITE:
+                markSpan(inkSpans[page], col);
+                currentFb[col + (page * OLED_WIDTH)] |= pages[page];
+                break;
+            case BLACK:
+                currentFb[col + (page * OLED_WIDTH)] &= ~pages[page];
+                break;
+            case INVERSE:
+                markSpan(inkSpans[page], col);
+                currentFb[col + (page * OLED_WIDTH)] ^= pages[page];
+                break;
+            default:
+            {
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find where a pixel is stored in the framebuffer. The OLED is mounted
+ * upside down, and even and odd rows are interleaved between the top and
+ * bottom halves of the display RAM
+ *
+ * @param x   Column of display, 0 is at the left
+ * @param y   Row of the display, 0 is at the top
+ * @param col Returns the framebuffer column
+ * @param row Returns the framebuffer row, the page is row / 8
+ * @return true if the pixel is on the display, false otherwise
+ */
+static inline bool fbLocation(int16_t x, int16_t y, int16_t* col, int16_t* row)
 {
     if ((0 <= x) && (x < OLED_WIDTH) &&
             (0 <= y) && (y < OLED_HEIGHT))
     {
-        fbChanges = true;
-        x = (OLED_WIDTH - 1) - x;
+        *col = (OLED_WIDTH - 1) - x;
         y = (OLED_HEIGHT - 1) - y;
         if (y % 2 == 0)
         {
-            y = (y >> 1);
+            *row = (y >> 1);
         }
         else
         {
-            y = (y >> 1) + (OLED_HEIGHT >> 1);
+            *row = (y >> 1) + (OLED_HEIGHT >> 1);
         }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Set/clear/invert a single pixel.
+ *
+ * @param x Column of display, 0 is at the left
+ * @param y Row of the display, 0 is at the top
+ * @param c Pixel color, one of: BLACK, WHITE or INVERT
+ */
+void ICACHE_FLASH_ATTR drawPixel(int16_t x, int16_t y, color c)
+{
+    if (fbLocation(x, y, &x, &y))
+    {
+        fbChanges = true;
+        markSpan(dirtySpans[y / 8], x);
         switch (c)
         {
             case WHITE:
+                markSpan(inkSpans[y / 8], x);
                 currentFb[(x + (y / 8) * OLED_WIDTH)] |= (1 << (y & 7));
                 break;
             case BLACK:
                 currentFb[(x + (y / 8) * OLED_WIDTH)] &= ~(1 << (y & 7));
                 break;
             case INVERSE:
+                markSpan(inkSpans[y / 8], x);
                 currentFb[(x + (y / 8) * OLED_WIDTH)] ^= (1 << (y & 7));
                 break;
             default:
@@ -217,20 +668,8 @@ void ICACHE_FLASH_ATTR drawPixel(int16_t x, int16_t y, color c)
  */
 color ICACHE_FLASH_ATTR getPixel(int16_t x, int16_t y)
 {
-    if ((0 <= x) && (x < OLED_WIDTH) &&
-            (0 <= y) && (y < OLED_HEIGHT))
+    if (fbLocation(x, y, &x, &y))
     {
-        x = (OLED_WIDTH - 1) - x;
-        y = (OLED_HEIGHT - 1) - y;
-        if (y % 2 == 0)
-        {
-            y = (y >> 1);
-        }
-        else
-        {
-            y = (y >> 1) + (OLED_HEIGHT >> 1);
-        }
-
         if(currentFb[(x + (y / 8) * OLED_WIDTH)] & (1 << (y & 7)))
         {
             return WHITE;
@@ -321,69 +760,184 @@ bool ICACHE_FLASH_ATTR setOLEDparams(bool turnOnOff)
 }
 
 /**
- * @brief Find the first and last differences in a page
+ * @brief Find the runs of differences in a page, only looking within the
+ * given column span. Two runs are merged when resending the unchanged gap
+ * between them is cheaper than addressing a new run. If there are more runs
+ * than MAX_RUNS_PER_PAGE, the two with the smallest gap are merged
  *
  * @param prior The prior framebuffer to compare
  * @param curr  The current framebuffer to compare
- * @param bounds A pointer to return the first and last difference index through
- * @return true if there are any differences, false otherwise
+ * @param searchBounds The first and last column index to compare
+ * @param runs An array of MAX_RUNS_PER_PAGE {first, last} column pairs to
+ *             return the runs through
+ * @return the number of runs found, 0 if there are no differences
  */
-inline bool ICACHE_FLASH_ATTR findDiffBounds(uint8_t* prior, uint8_t* curr, int16_t* bounds)
+uint8_t ICACHE_FLASH_ATTR findDiffRuns(uint8_t* prior, uint8_t* curr, int16_t* searchBounds, int16_t runs[][2])
 {
     int16_t col;
-    bool anyDiffs = false;
-    // Look for the first difference
-    for (col = 0; col < SSD1306_NUM_COLS; col++)
+    uint8_t numRuns = 0;
+    for (col = searchBounds[0]; col <= searchBounds[1]; col++)
     {
         // If there's a difference
         if (prior[col] != curr[col])
         {
-            // Mark it
-            bounds[0] = col;
-            // Then look for the last difference
-            for (col = SSD1306_NUM_COLS - 1; col >= 0; col--)
+            if (0 < numRuns && (col - runs[numRuns - 1][1] - 1) <= RUN_SETUP_COST)
             {
-                // If there's a difference
-                if (prior[col] != curr[col])
+                // Close enough to the last run, extend it
+                runs[numRuns - 1][1] = col;
+            }
+            else if (MAX_RUNS_PER_PAGE == numRuns)
+            {
+                // Out of runs. Find the smallest gap, starting with the one
+                // before this column
+                int16_t minGap = col - runs[numRuns - 1][1] - 1;
+                uint8_t minRun = numRuns - 1;
+                uint8_t run;
+                for (run = 0; run < numRuns - 1; run++)
                 {
-                    // Mark it
-                    bounds[1] = col;
-                    break;
+                    int16_t gap = runs[run + 1][0] - runs[run][1] - 1;
+                    if (gap < minGap)
+                    {
+                        minGap = gap;
+                        minRun = run;
+                    }
                 }
+
+                if (numRuns - 1 != minRun)
+                {
+                    // Merge two earlier runs, shift the rest down and start a
+                    // new run here
+                    runs[minRun][1] = runs[minRun + 1][1];
+                    for (run = minRun + 1; run < numRuns - 1; run++)
+                    {
+                        runs[run][0] = runs[run + 1][0];
+                        runs[run][1] = runs[run + 1][1];
+                    }
+                    runs[numRuns - 1][0] = col;
+                }
+                // Either way the last run ends here
+                runs[numRuns - 1][1] = col;
+            }
+            else
+            {
+                // Start a new run
+                runs[numRuns][0] = col;
+                runs[numRuns][1] = col;
+                numRuns++;
             }
-            anyDiffs = true;
-            break;
         }
     }
-    return anyDiffs;
+    return numRuns;
 }
 
 /**
- * Send the differences between the prior frame and the current frame to the
- * OLED using the fewest number of SPI bytes
+ * Send one run of a page to the OLED
  *
- * @param prior The prior frame
- * @param curr  The current frame
- * @param bounds The indices of the first and last differences
+ * @param fb The framebuffer to send data from
+ * @param run The page and the first and last column to send
+ * @param addressPage true to address the page first, false if the OLED is
+ *                    already addressing this page
  */
-inline void ICACHE_FLASH_ATTR checkPage(uint8_t page, uint8_t* prior, uint8_t* curr, int16_t* bounds)
+void ICACHE_FLASH_ATTR sendRun(uint8_t* fb, oledRun_t* run, bool addressPage)
 {
-    // Address the page
-    setPageAddressPagingMode(page);
+    if(addressPage)
+    {
+        setPageAddressPagingMode(run->page);
+    }
 
-    // Suppresses a warning
-    (void)prior;
+    setLowerColAddrPagingMode(run->firstCol & 0x0F);
+    setUpperColAddrPagingMode((run->firstCol >> 4) & 0x0F);
 
-    setLowerColAddrPagingMode(bounds[0] & 0x0F);
-    setUpperColAddrPagingMode((bounds[0] >> 4) & 0x0F);
+    uint8_t numBytes = run->lastCol - run->firstCol + 1;
+    uint8_t data[1 + numBytes];
+    data[0] = SSD1306_DATA;
+    ets_memcpy(&data[1], &fb[(run->page * SSD1306_NUM_COLS) + run->firstCol], numBytes);
 
-    uint8_t numBytesDifferent = bounds[1] - bounds[0] + 1;
-    uint8_t diffs[1 + numBytesDifferent];
-    diffs[0] = SSD1306_DATA;
-    ets_memcpy(&diffs[1], &curr[bounds[0]], numBytesDifferent);
+    // Write the data
+    cnlohr_i2c_write(data, sizeof(data), false);
+}
+
+/**
+ * Send a few columns across several pages to the OLED in one data write.
+ * The OLED is switched to vertical addressing for the window, so the bytes go
+ * down each column's pages before moving to the next column, then back to
+ * page addressing for the runs after it
+ *
+ * @param fb The framebuffer to send data from
+ * @param run The first and last page and the first and last column to send
+ */
+void ICACHE_FLASH_ATTR sendColumnWindow(uint8_t* fb, oledRun_t* run)
+{
+    setMemoryAddressingMode(VERTICAL_ADDRESSING);
+    setColumnAddress(run->firstCol, run->lastCol);
+    setPageAddress(run->page, run->lastPage);
+
+    uint8_t numPages = run->lastPage - run->page + 1;
+    uint8_t data[1 + (numPages * (run->lastCol - run->firstCol + 1))];
+    uint8_t* dst = &data[1];
+    data[0] = SSD1306_DATA;
+
+    uint8_t col, page;
+    for (col = run->firstCol; col <= run->lastCol; col++)
+    {
+        for (page = run->page; page <= run->lastPage; page++)
+        {
+            *(dst++) = fb[(page * SSD1306_NUM_COLS) + col];
+        }
+    }
 
     // Write the data
-    cnlohr_i2c_write(diffs, sizeof(diffs), false);
+    cnlohr_i2c_write(data, sizeof(data), false);
+
+    setMemoryAddressingMode(PAGE_ADDRESSING);
+}
+
+/**
+ * If every run queued for this frame falls within WINDOW_MAX_COLS columns,
+ * and sending them as one window down those columns costs less than a run
+ * per page, replace the runs with that window. A column drawn down the
+ * display, like the waterfall's, changes a run in most pages. The pages and
+ * columns in the window which didn't change are resent from priorFb, which
+ * already matches the OLED there
+ */
+void ICACHE_FLASH_ATTR queueColumnWindow(void)
+{
+    if(oledFlush.numRuns < 2)
+    {
+        return;
+    }
+
+    oledRun_t window = oledFlush.runs[0];
+    uint32_t runsCost = 0;
+    uint8_t run;
+    for (run = 0; run < oledFlush.numRuns; run++)
+    {
+        oledRun_t* r = &oledFlush.runs[run];
+        if(r->firstCol < window.firstCol)
+        {
+            window.firstCol = r->firstCol;
+        }
+        if(r->lastCol > window.lastCol)
+        {
+            window.lastCol = r->lastCol;
+        }
+        // Runs are queued in page order
+        window.lastPage = r->page;
+
+        runsCost += RUN_SETUP_COST + (r->lastCol - r->firstCol + 1);
+        if(0 == run || oledFlush.runs[run - 1].page != r->page)
+        {
+            runsCost += PAGE_SETUP_COST;
+        }
+    }
+
+    uint8_t numCols = window.lastCol - window.firstCol + 1;
+    uint32_t windowCost = WINDOW_SETUP_COST + (numCols * (window.lastPage - window.page + 1));
+    if(window.page != window.lastPage && numCols <= WINDOW_MAX_COLS && windowCost < runsCost)
+    {
+        oledFlush.runs[0] = window;
+        oledFlush.numRuns = 1;
+    }
 }
 
 /**
@@ -391,8 +945,8 @@ inline void ICACHE_FLASH_ATTR checkPage(uint8_t page, uint8_t* prior, uint8_t* c
  */
 void ICACHE_FLASH_ATTR zeroMenuBar(void)
 {
-    fbChanges = true;
     mBarLen = 0;
+    oledSetOverlayVisible(&menuBarOverlay, false);
 }
 
 /**
@@ -402,20 +956,205 @@ void ICACHE_FLASH_ATTR zeroMenuBar(void)
  */
 uint8_t ICACHE_FLASH_ATTR incrementMenuBar(void)
 {
-    fbChanges = true;
-    return ++mBarLen;
+    mBarLen++;
+    if(1 == mBarLen)
+    {
+        // The bar covers the whole bottom row, black past its length
+        fillOverlayArea(&menuBarOverlay, 0, OLED_HEIGHT - 1, OLED_WIDTH - 1, OLED_HEIGHT - 1, BLACK);
+        fillOverlayArea(&menuBarOverlay, 0, OLED_HEIGHT - 1, mBarLen, OLED_HEIGHT - 1, WHITE);
+        oledSetOverlayVisible(&menuBarOverlay, true);
+    }
+    else
+    {
+        oledOverlayDrawPixel(&menuBarOverlay, mBarLen, OLED_HEIGHT - 1, WHITE);
+    }
+    return mBarLen;
+}
+
+/**
+ * Start sending a new frame to the OLED. The runs to send are queued and the
+ * frame, with overlays composited on top, is snapshotted into priorFb.
+ * Nothing is sent yet
+ *
+ * @param drawDifference true to only queue differences from the prior frame
+ *                       false to queue the entire frame
+ * @return true if there is anything to send, false otherwise
+ */
+bool ICACHE_FLASH_ATTR beginFlush(bool drawDifference)
+{
+    uint8_t page;
+    uint8_t run;
+
+    oledFlush.numRuns = 0;
+    oledFlush.nextRun = 0;
+    oledFlush.err = false;
+    oledFlush.frameBytes = 0;
+    oledFlush.frameTransfers = 0;
+    oledFlush.framePasses = 0;
+
+    int16_t diffRuns[MAX_RUNS_PER_PAGE][2];
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        uint8_t numDiffRuns;
+        uint8_t* prior = &priorFb[page * SSD1306_NUM_COLS];
+        uint8_t* curr;
+        if(drawDifference)
+        {
+            // Compare the prior and current framebuffers, looking for any
+            // differences. Only the columns which were written since the last
+            // update can differ
+            curr = composePage(page, dirtySpans[page][0], dirtySpans[page][1]);
+            numDiffRuns = findDiffRuns(prior, curr, dirtySpans[page], diffRuns);
+            if(dirtySpans[page][0] <= dirtySpans[page][1])
+            {
+                oledStats.totalCompared += dirtySpans[page][1] - dirtySpans[page][0] + 1;
+                if(composedPage == curr)
+                {
+                    oledStats.totalCopied += dirtySpans[page][1] - dirtySpans[page][0] + 1;
+                }
+            }
+        }
+        else
+        {
+            // Queue the whole page
+            curr = composePage(page, 0, SSD1306_NUM_COLS - 1);
+            diffRuns[0][0] = 0;
+            diffRuns[0][1] = SSD1306_NUM_COLS - 1;
+            numDiffRuns = 1;
+            if(composedPage == curr)
+            {
+                oledStats.totalCopied += SSD1306_NUM_COLS;
+            }
+        }
+
+        for (run = 0; run < numDiffRuns; run++)
+        {
+            oledFlush.runs[oledFlush.numRuns].page = page;
+            oledFlush.runs[oledFlush.numRuns].lastPage = page;
+            oledFlush.runs[oledFlush.numRuns].firstCol = diffRuns[run][0];
+            oledFlush.runs[oledFlush.numRuns].lastCol = diffRuns[run][1];
+            oledFlush.numRuns++;
+
+            // Snapshot the run into the prior framebuffer. Runs are sent from
+            // there, so the mode can keep drawing into currentFb during the flush
+            ets_memcpy(&prior[diffRuns[run][0]], &curr[diffRuns[run][0]], diffRuns[run][1] - diffRuns[run][0] + 1);
+            oledStats.totalCopied += diffRuns[run][1] - diffRuns[run][0] + 1;
+        }
+    }
+    resetSpans(dirtySpans);
+
+    if(drawDifference)
+    {
+        queueColumnWindow();
+    }
+
+    oledFlush.inProgress = (0 < oledFlush.numRuns);
+    return oledFlush.inProgress;
+}
+
+/**
+ * Send queued runs of the current flush to the OLED. At least one run is
+ * always sent, then more are sent until a limit is hit
+ *
+ * @param maxRuns The most runs to send, 0 for no limit
+ * @param maxUs   The most microseconds to spend sending, 0 for no limit
+ * @return FRAME_IN_PROGRESS if there are runs left to send,
+ *         FRAME_DRAWN if the frame finished sending,
+ *         FRAME_NOT_DRAWN if the frame finished but there was some I2C error,
+ *         NOTHING_TO_DO if there was no flush in progress
+ */
+oledResult_t ICACHE_FLASH_ATTR pumpFlush(uint8_t maxRuns, uint32_t maxUs)
+{
+    if(false == oledFlush.inProgress)
+    {
+        return NOTHING_TO_DO;
+    }
+
+    uint32_t startTime = system_get_time();
+    uint8_t runsSent = 0;
+    int16_t lastPage = -1;
+
+    uint32_t startBytes, startTransfers;
+    cnlohr_i2c_get_stats(&startBytes, &startTransfers);
+
+    // Start i2c
+    cnlohr_i2c_start_transaction(OLED_ADDRESS, OLED_FREQ);
+
+    while(oledFlush.nextRun < oledFlush.numRuns)
+    {
+        oledRun_t* run = &oledFlush.runs[oledFlush.nextRun];
+        if(run->page != run->lastPage)
+        {
+            // The window moves the page pointer, address the next run's page
+            sendColumnWindow(priorFb, run);
+            lastPage = -1;
+        }
+        else
+        {
+            // Only address the page if it changed since the last run this pass
+            sendRun(priorFb, run, (lastPage != run->page));
+            lastPage = run->page;
+        }
+        oledFlush.nextRun++;
+        runsSent++;
+
+        // Check the budget
+        if((0 != maxRuns && runsSent >= maxRuns) ||
+                (0 != maxUs && (system_get_time() - startTime) >= maxUs))
+        {
+            break;
+        }
+    }
+
+    // end i2c
+    if (0 != cnlohr_i2c_end_transaction())
+    {
+        oledFlush.err = true;
+    }
+
+    // Account for the traffic
+    uint32_t endBytes, endTransfers;
+    cnlohr_i2c_get_stats(&endBytes, &endTransfers);
+    oledFlush.frameBytes += (endBytes - startBytes);
+    oledFlush.frameTransfers += (endTransfers - startTransfers);
+    oledFlush.framePasses++;
+
+    if(oledFlush.nextRun < oledFlush.numRuns)
+    {
+        return FRAME_IN_PROGRESS;
+    }
+
+    oledStats.framesSent++;
+    oledStats.totalBytes += oledFlush.frameBytes;
+    oledStats.totalTransfers += oledFlush.frameTransfers;
+    oledStats.totalRuns += oledFlush.numRuns;
+    oledStats.lastFrameBytes = oledFlush.frameBytes;
+    oledStats.lastFrameRuns = oledFlush.numRuns;
+    oledStats.lastFramePasses = oledFlush.framePasses;
+    if(oledFlush.frameBytes > oledStats.maxFrameBytes)
+    {
+        oledStats.maxFrameBytes = oledFlush.frameBytes;
+    }
+
+    oledFlush.inProgress = false;
+    return (oledFlush.err) ? FRAME_NOT_DRAWN : FRAME_DRAWN;
 }
 
 /**
- * Push data currently in RAM to SSD1306 display.
+ * Push data currently in RAM to SSD1306 display. This blocks until the whole
+ * frame is sent. Any flush already in progress is finished first
  *
  * @param drawDifference true to only draw differences from the prior frame
  *                       false to draw the entire frame
- * @return true  the data was sent
- *         false there was some I2C error
+ * @return FRAME_DRAWN the data was sent
+ *         FRAME_NOT_DRAWN there was some I2C error
+ *         NOTHING_TO_DO there were no changes to send
  */
 oledResult_t ICACHE_FLASH_ATTR updateOLED(bool drawDifference)
 {
+    // Finish the prior frame
+    pumpFlush(0, 0);
+
     if(true == drawDifference && false == fbChanges)
     {
         // We know nothing happened, just return
@@ -427,158 +1166,348 @@ oledResult_t ICACHE_FLASH_ATTR updateOLED(bool drawDifference)
         fbChanges = false;
     }
 
-    if(drawDifference)
+    if(false == beginFlush(drawDifference))
     {
-        // Just draw the differences
-        int16_t page;
-        bool anyDiffs = false;
-        int16_t diffBounds[SSD1306_NUM_PAGES][2] =
-        {
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-            {-1, -1},
-        };
-
-        color bottomBar[OLED_WIDTH] = {0};
-        saveOverwriteMenuBar(bottomBar);
+        // No framebuffer updates, just return
+        return NOTHING_TO_DO;
+    }
+    return pumpFlush(0, 0);
+}
 
-        // Compare the prior and current framebuffers, looking for any differences
-        for (page = 0; page < SSD1306_NUM_PAGES; page++)
+/**
+ * Push data currently in RAM to SSD1306 display, without spending more than
+ * the flush budget per call. If a flush is in progress, more of it is sent.
+ * Otherwise a new flush of the current frame is started
+ *
+ * @param drawDifference true to only draw differences from the prior frame
+ *                       false to draw the entire frame. Ignored if a flush is
+ *                       already in progress
+ * @return FRAME_IN_PROGRESS part of the frame was sent, call again to send more
+ *         FRAME_DRAWN the last of the frame was sent
+ *         FRAME_NOT_DRAWN the frame was sent but there was some I2C error
+ *         NOTHING_TO_DO there were no changes to send
+ */
+oledResult_t ICACHE_FLASH_ATTR updateOLEDBudgeted(bool drawDifference)
+{
+    if(false == oledFlush.inProgress)
+    {
+        if(true == drawDifference && false == fbChanges)
         {
-            if (findDiffBounds(&priorFb[page * SSD1306_NUM_COLS], &currentFb[page * SSD1306_NUM_COLS], diffBounds[page]))
-            {
-                anyDiffs = true;
-            }
+            // We know nothing happened, just return
+            return NOTHING_TO_DO;
         }
+        fbChanges = false;
 
-        // No framebuffer updates, just return
-        if (true == drawDifference && false == anyDiffs)
+        if(false == beginFlush(drawDifference))
         {
-            restoreMenuBar(bottomBar);
             return NOTHING_TO_DO;
         }
+    }
+    return pumpFlush(oledFlush.maxRunsPerPass, oledFlush.maxUsPerPass);
+}
 
-        // Start i2c
-        cnlohr_i2c_start_transaction(OLED_ADDRESS, OLED_FREQ);
+/**
+ * @brief Set the limits for each call to updateOLEDBudgeted()
+ *
+ * @param maxRuns The most runs to send per call, 0 for no limit
+ * @param maxUs   The most microseconds to spend per call, 0 for no limit.
+ *                At least one run is always sent, so this may be exceeded
+ */
+void ICACHE_FLASH_ATTR setOLEDFlushBudget(uint8_t maxRuns, uint32_t maxUs)
+{
+    oledFlush.maxRunsPerPass = maxRuns;
+    oledFlush.maxUsPerPass = maxUs;
+}
 
-        // Find the actual differences and push them out
-        for (page = 0; page < SSD1306_NUM_PAGES; page++)
-        {
-            // If there's a difference in this page, look harder
-            if (0 <= diffBounds[page][0])
-            {
-                checkPage(page, &priorFb[page * SSD1306_NUM_COLS], &currentFb[page * SSD1306_NUM_COLS], diffBounds[page]);
-            }
-        }
+/**
+ * @return true if a frame is partially sent to the OLED, false otherwise
+ */
+bool ICACHE_FLASH_ATTR isOLEDFlushInProgress(void)
+{
+    return oledFlush.inProgress;
+}
 
-        // Copy the framebuffer to the prior
-        ets_memcpy(priorFb, currentFb, sizeof(currentFb));
+/**
+ * @brief Get the I2C traffic used to send frames to the OLED
+ *
+ * @param stats Returns a copy of the stats
+ */
+void ICACHE_FLASH_ATTR getOLEDStats(oledStats_t* stats)
+{
+    ets_memcpy(stats, &oledStats, sizeof(oledStats_t));
+}
 
-        // Restore the bottom bar
-        restoreMenuBar(bottomBar);
+/**
+ * @brief Reset the OLED traffic stats to zero
+ */
+void ICACHE_FLASH_ATTR resetOLEDStats(void)
+{
+    ets_memset(&oledStats, 0, sizeof(oledStats_t));
+}
 
-        // end i2c
-        if (0 == cnlohr_i2c_end_transaction())
+/**
+ * @brief Get the pages which hold a range of rows. Because even and odd rows
+ * are interleaved between the top and bottom halves of the display RAM, this
+ * is usually two groups of pages
+ *
+ * @param y1 The top row, inclusive
+ * @param y2 The bottom row, inclusive
+ * @return A mask of pages, bit n set for page n
+ */
+uint8_t ICACHE_FLASH_ATTR oledOverlayPagesForRows(int16_t y1, int16_t y2)
+{
+    uint8_t pages[SSD1306_NUM_PAGES];
+    columnToPages(rowRangeMask(y1, y2), rowRangeMask(y1 - 32, y2 - 32), pages);
+
+    uint8_t pageMask = 0;
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        if(0 != pages[page])
         {
-            return FRAME_DRAWN;
+            pageMask |= (1 << page);
         }
-        else
+    }
+    return pageMask;
+}
+
+/**
+ * @brief Add an overlay on top of all the others. The overlay's memory is
+ * owned by the caller and must stay valid until it is removed
+ *
+ * @param overlay The overlay to add
+ * @return true if it was added, false if there were too many overlays
+ */
+bool ICACHE_FLASH_ATTR oledAddOverlay(oledOverlay_t* overlay)
+{
+    if(numOverlays >= OLED_MAX_OVERLAYS)
+    {
+        return false;
+    }
+    overlays[numOverlays++] = overlay;
+    markOverlayDirty(overlay);
+    return true;
+}
+
+/**
+ * @brief Remove an overlay, revealing what is below it
+ *
+ * @param overlay The overlay to remove
+ */
+void ICACHE_FLASH_ATTR oledRemoveOverlay(oledOverlay_t* overlay)
+{
+    uint8_t i;
+    for (i = 0; i < numOverlays; i++)
+    {
+        if(overlays[i] == overlay)
         {
-            return FRAME_NOT_DRAWN;
+            markOverlayDirty(overlay);
+            numOverlays--;
+            for (; i < numOverlays; i++)
+            {
+                overlays[i] = overlays[i + 1];
+            }
+            return;
         }
     }
-    else // Draw the entire OLED
-    {
-        // Draw the menu bar
-        color bottomBar[OLED_WIDTH] = {0};
-        saveOverwriteMenuBar(bottomBar);
+}
 
-        // Start i2c
-        cnlohr_i2c_start_transaction(OLED_ADDRESS, OLED_FREQ);
+/**
+ * @brief Show or hide an overlay
+ *
+ * @param overlay The overlay to show or hide
+ * @param visible true to show it, false to hide it
+ */
+void ICACHE_FLASH_ATTR oledSetOverlayVisible(oledOverlay_t* overlay, bool visible)
+{
+    if(overlay->visible != visible)
+    {
+        overlay->visible = visible;
+        markOverlayDirty(overlay);
+    }
+}
 
-        // Draw every page
-        uint8_t wholePage[1 + SSD1306_NUM_COLS] = {0};
-        wholePage[0] = SSD1306_DATA;
-        uint8_t page;
-        for (page = 0; page < SSD1306_NUM_PAGES; page++)
+/**
+ * @brief Make an overlay completely transparent
+ *
+ * @param overlay The overlay to clear
+ */
+void ICACHE_FLASH_ATTR oledOverlayClear(oledOverlay_t* overlay)
+{
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        if(overlay->pageMask & (1 << page))
         {
-            // Address the page
-            setPageAddressPagingMode(page);
-            setLowerColAddrPagingMode(0);
-            setUpperColAddrPagingMode(0);
-            // Write the page
-            ets_memcpy(&wholePage[1], &currentFb[page * SSD1306_NUM_COLS], sizeof(wholePage) - 1);
-            cnlohr_i2c_write(wholePage, sizeof(wholePage), false);
+            ets_memset(&overlay->mask[overlayOffset(overlay, page)], 0, OLED_WIDTH);
         }
+    }
+    markOverlayDirty(overlay);
+}
 
-        // Copy the framebuffer to the prior
-        ets_memcpy(priorFb, currentFb, sizeof(currentFb));
-
-        // Restore the bottom bar
-        restoreMenuBar(bottomBar);
+/**
+ * @brief Draw a single pixel in an overlay. Pixels outside of the overlay's
+ * pages are ignored
+ *
+ * @param overlay The overlay to draw in
+ * @param x Column of display, 0 is at the left
+ * @param y Row of the display, 0 is at the top
+ * @param c WHITE or BLACK to draw an opaque pixel, INVERSE to invert the pixel
+ *          in the overlay. Use oledOverlayErasePixel() to make it transparent
+ */
+void ICACHE_FLASH_ATTR oledOverlayDrawPixel(oledOverlay_t* overlay, int16_t x, int16_t y, color c)
+{
+    int16_t col, row;
+    if (fbLocation(x, y, &col, &row) && (overlay->pageMask & (1 << (row / 8))))
+    {
+        uint16_t idx = overlayOffset(overlay, row / 8) + col;
+        uint8_t bit = (1 << (row & 7));
+        switch (c)
+        {
+            case WHITE:
+                overlay->data[idx] |= bit;
+                break;
+            case BLACK:
+                overlay->data[idx] &= ~bit;
+                break;
+            case INVERSE:
+                overlay->data[idx] ^= bit;
+                break;
+            default:
+            {
+                break;
+            }
+        }
+        overlay->mask[idx] |= bit;
 
-        // end i2c
-        if (0 == cnlohr_i2c_end_transaction())
+        if(overlay->visible)
         {
-            return FRAME_DRAWN;
+            fbChanges = true;
+            markSpan(dirtySpans[row / 8], col);
         }
-        else
+    }
+}
+
+/**
+ * @brief Make a single pixel in an overlay transparent again
+ *
+ * @param overlay The overlay to erase from
+ * @param x Column of display, 0 is at the left
+ * @param y Row of the display, 0 is at the top
+ */
+void ICACHE_FLASH_ATTR oledOverlayErasePixel(oledOverlay_t* overlay, int16_t x, int16_t y)
+{
+    int16_t col, row;
+    if (fbLocation(x, y, &col, &row) && (overlay->pageMask & (1 << (row / 8))))
+    {
+        overlay->mask[overlayOffset(overlay, row / 8) + col] &= ~(1 << (row & 7));
+
+        if(overlay->visible)
         {
-            return FRAME_NOT_DRAWN;
+            fbChanges = true;
+            markSpan(dirtySpans[row / 8], col);
         }
     }
 }
 
 /**
- * Copy the bottom bar into the bottomBar arg, then overwrite
- * the pixels in the framebuffer with the menu progress bar.
- * Only do this if there is a menu to draw
+ * @brief Fill a rectangle of an overlay with opaque pixels
  *
- * @param bottomBar The array to copy the pixels into
+ * @param overlay The overlay to draw in
+ * @param x1 The left column of the rectangle, inclusive
+ * @param y1 The top row of the rectangle, inclusive
+ * @param x2 The right column of the rectangle, inclusive
+ * @param y2 The bottom row of the rectangle, inclusive
+ * @param c  WHITE, BLACK or INVERSE
  */
-void ICACHE_FLASH_ATTR saveOverwriteMenuBar(color* bottomBar)
+void ICACHE_FLASH_ATTR fillOverlayArea(oledOverlay_t* overlay, int16_t x1, int16_t y1,
+                                       int16_t x2, int16_t y2, color c)
 {
-    if(mBarLen > 0)
+    int16_t x, y;
+    for (x = x1; x <= x2; x++)
     {
-        // Save the bottom bar's pixels
-        for(uint8_t i = 0; i < OLED_WIDTH; i++)
+        for (y = y1; y <= y2; y++)
         {
-            bottomBar[i] = getPixel(i, OLED_HEIGHT - 1);
+            oledOverlayDrawPixel(overlay, x, y, c);
         }
-        // overwrite with menu bar
-        for(uint8_t i = 0; i < OLED_WIDTH; i++)
+    }
+}
+
+/**
+ * @brief Get where a page is stored in an overlay's buffers. Only the covered
+ * pages are stored, in order
+ *
+ * @param overlay The overlay
+ * @param page The page, which must be covered by the overlay
+ * @return The index of the page's first byte in data and mask
+ */
+static inline uint16_t overlayOffset(oledOverlay_t* overlay, uint8_t page)
+{
+    uint8_t below = overlay->pageMask & ((1 << page) - 1);
+    uint8_t rank = 0;
+    while(below)
+    {
+        below &= (below - 1);
+        rank++;
+    }
+    return rank * OLED_WIDTH;
+}
+
+/**
+ * @brief Mark every page an overlay covers as dirty, so it is recomposited
+ *
+ * @param overlay The overlay which changed
+ */
+void ICACHE_FLASH_ATTR markOverlayDirty(oledOverlay_t* overlay)
+{
+    uint8_t page;
+    for (page = 0; page < SSD1306_NUM_PAGES; page++)
+    {
+        if(overlay->pageMask & (1 << page))
         {
-            if(i <= mBarLen)
-            {
-                drawPixel(i, OLED_HEIGHT - 1, WHITE);
-            }
-            else
-            {
-                drawPixel(i, OLED_HEIGHT - 1, BLACK);
-            }
+            markSpan(dirtySpans[page], 0);
+            markSpan(dirtySpans[page], SSD1306_NUM_COLS - 1);
         }
     }
+    fbChanges = true;
 }
 
 /**
- * Restore the bottom bar of pixels from bottomBar
+ * @brief Composite the visible overlays over part of a page of currentFb.
+ * currentFb is never modified
  *
- * @param bottomBar The original pixels to write into the framebuffer
+ * @param page The page to composite
+ * @param firstCol The first column to composite, inclusive
+ * @param lastCol  The last column to composite, inclusive
+ * @return A pointer to the page's SSD1306_NUM_COLS bytes, only valid between
+ *         firstCol and lastCol. This is currentFb if no overlay covers the page
  */
-void ICACHE_FLASH_ATTR restoreMenuBar(color* bottomBar)
+uint8_t* ICACHE_FLASH_ATTR composePage(uint8_t page, int16_t firstCol, int16_t lastCol)
 {
-    if(mBarLen > 0)
+    uint8_t* base = &currentFb[page * SSD1306_NUM_COLS];
+    bool composed = false;
+    uint8_t i;
+    for (i = 0; i < numOverlays; i++)
     {
-        for(uint8_t i = 0; i < OLED_WIDTH; i++)
+        oledOverlay_t* overlay = overlays[i];
+        if(overlay->visible && (overlay->pageMask & (1 << page)) && firstCol <= lastCol)
         {
-            drawPixel(i, OLED_HEIGHT - 1, bottomBar[i]);
+            if(false == composed)
+            {
+                ets_memcpy(&composedPage[firstCol], &base[firstCol], lastCol - firstCol + 1);
+                composed = true;
+            }
+
+            uint8_t* data = &overlay->data[overlayOffset(overlay, page)];
+            uint8_t* mask = &overlay->mask[overlayOffset(overlay, page)];
+            int16_t col;
+            for (col = firstCol; col <= lastCol; col++)
+            {
+                composedPage[col] = (composedPage[col] & ~mask[col]) | (data[col] & mask[col]);
+            }
         }
     }
+    return composed ? composedPage : base;
 }
 
 //==============================================================================
@@ -21,20 +21,67 @@ typedef enum
 {
     NOTHING_TO_DO,
     FRAME_DRAWN,
-    FRAME_NOT_DRAWN
+    FRAME_NOT_DRAWN,
+    FRAME_IN_PROGRESS
 } oledResult_t;
 
 #define OLED_WIDTH 128
 #define OLED_HEIGHT 64
 
+#define OLED_MAX_OVERLAYS 4
+
+typedef struct
+{
+    uint32_t framesSent;     ///< Frames completely sent since the stats were reset
+    uint32_t totalBytes;     ///< I2C bytes, including addresses and commands
+    uint32_t totalTransfers; ///< I2C writes and reads, each costs a start condition
+    uint32_t totalRuns;      ///< Runs of columns sent, a column window is one
+    uint16_t lastFrameBytes; ///< I2C bytes used by the last frame
+    uint16_t lastFrameRuns;  ///< Runs used by the last frame
+    uint8_t lastFramePasses; ///< Calls it took to send the last frame
+    uint16_t maxFrameBytes;  ///< The most I2C bytes used by one frame
+    uint32_t totalCompared;  ///< Framebuffer bytes compared to find differences
+    uint32_t totalCopied;    ///< Framebuffer bytes copied to snapshot and composite frames
+} oledStats_t;
+
+/**
+ * An overlay is drawn on top of the framebuffer when it is sent to the OLED,
+ * without modifying the framebuffer. Only whole pages are covered. data and
+ * mask each hold OLED_WIDTH bytes for every page set in pageMask, in page
+ * order. Where a mask bit is set, the data bit replaces the framebuffer's bit
+ */
+typedef struct
+{
+    uint8_t pageMask;
+    uint8_t* data;
+    uint8_t* mask;
+    bool visible;
+} oledOverlay_t;
+
 bool initOLED(bool reset);
 void drawPixel(int16_t x, int16_t y, color c);
 color getPixel(int16_t x, int16_t y);
 bool ICACHE_FLASH_ATTR setOLEDparams(bool turnOnOff);
 oledResult_t updateOLED(bool drawDifference);
+oledResult_t updateOLEDBudgeted(bool drawDifference);
+void setOLEDFlushBudget(uint8_t maxRuns, uint32_t maxUs);
+bool isOLEDFlushInProgress(void);
+void getOLEDStats(oledStats_t* stats);
+void resetOLEDStats(void);
 void clearDisplay(void);
 void fillDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c);
+void oledBlitColumn(int16_t x, int16_t y, uint32_t bits, uint8_t h, color c);
 void zeroMenuBar(void);
 uint8_t incrementMenuBar(void);
 
+uint8_t oledOverlayPagesForRows(int16_t y1, int16_t y2);
+bool oledAddOverlay(oledOverlay_t* overlay);
+void oledRemoveOverlay(oledOverlay_t* overlay);
+void oledSetOverlayVisible(oledOverlay_t* overlay, bool visible);
+void oledOverlayClear(oledOverlay_t* overlay);
+void oledOverlayDrawPixel(oledOverlay_t* overlay, int16_t x, int16_t y, color c);
+void oledOverlayErasePixel(oledOverlay_t* overlay, int16_t x, int16_t y);
+void fillOverlayArea(oledOverlay_t* overlay, int16_t x1, int16_t y1,
+                     int16_t x2, int16_t y2, color c);
+
 #endif /* OLED_H_ */
@@ -15,6 +15,7 @@ int16_t ICACHE_FLASH_ATTR plotSprite(int16_t x, int16_t y, const sprite_t* p_spr
 {
     uint8_t xIdx, yIdx;
     color foreground, background;
+    bool drawBackground = true;
 
     switch (col)
     {
@@ -33,8 +34,11 @@ int16_t ICACHE_FLASH_ATTR plotSprite(int16_t x, int16_t y, const sprite_t* p_spr
         }
         case INVERSE:
         {
+            // Foreground and background are both inverted, so invert the
+            // whole box in one go
             foreground = INVERSE;
             background = INVERSE;
+            drawBackground = false;
             break;
         }
     }
@@ -43,21 +47,29 @@ int16_t ICACHE_FLASH_ATTR plotSprite(int16_t x, int16_t y, const sprite_t* p_spr
     // sprite_t sprite_ram = p_sprite[0]; // Used to copy 32 bits of flash contents to RAM where 8 bit accesses are allowed
     sprite_t sprite_ram;
     ets_memcpy ( &sprite_ram, p_sprite, sizeof(sprite_t) );
+    uint32_t boxMask = (1 << sprite_ram.height) - 1;
     for (xIdx = 0; xIdx < sprite_ram.width; xIdx++)
     {
+        // Gather this column of the sprite, then blit it in one go
+        uint32_t column = 0;
         for (yIdx = 0; yIdx < sprite_ram.height; yIdx++)
         {
-            int16_t xPx = (int16_t) (x + (sprite_ram.width - xIdx) - 1);
-            int16_t yPx = (int16_t) (y + yIdx);
             if (0 != (sprite_ram.data[yIdx] & (1 << xIdx)))
             {
-                drawPixel(xPx, yPx, foreground);
-            }
-            else
-            {
-                drawPixel(xPx, yPx, background);
+                column |= (1 << yIdx);
             }
         }
+
+        int16_t xPx = (int16_t) (x + (sprite_ram.width - xIdx) - 1);
+        if(drawBackground)
+        {
+            oledBlitColumn(xPx, y, column, sprite_ram.height, foreground);
+            oledBlitColumn(xPx, y, ~column & boxMask, sprite_ram.height, background);
+        }
+        else
+        {
+            oledBlitColumn(xPx, y, boxMask, sprite_ram.height, foreground);
+        }
     }
     return (int16_t) (x + sprite_ram.width + 1);
 }
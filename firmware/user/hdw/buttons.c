@@ -61,6 +61,18 @@ void HandleButtonEventIRQ( uint8_t stat, int btn, int down )
     buttonQueue[buttonEvtTail].down = down;
     buttonQueue[buttonEvtTail].time = system_get_time();
     buttonEvtTail = (buttonEvtTail + 1) % NUM_BUTTON_EVTS;
+
+    // Make sure procTask is running to handle it
+    wakeProcTask();
+}
+
+/**
+ * @return true if there are button events waiting for
+ * HandleButtonEventSynchronous(), false otherwise
+ */
+bool ICACHE_FLASH_ATTR buttonEventsQueued(void)
+{
+    return buttonEvtHead != buttonEvtTail;
 }
 
 /**
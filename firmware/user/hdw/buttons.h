@@ -18,6 +18,7 @@ typedef enum
  *==========================================================================*/
 
 void ICACHE_FLASH_ATTR HandleButtonEventSynchronous(void);
+bool ICACHE_FLASH_ATTR buttonEventsQueued(void);
 void HandleButtonEventIRQ( uint8_t stat, int btn, int down );
 void ICACHE_FLASH_ATTR enableDebounce(bool enable);
 
@@ -20,6 +20,10 @@ int cnl_need_new_stop;
 uint8_t cnl_slave_address;
 int cnl_err;
 bool cnl_highSpeed;
+// Traffic counters, bytes include the slave address. A transfer is an
+// addressed write or read, each costs a start condition
+uint32_t cnl_bytes;
+uint32_t cnl_transfers;
 
 void ICACHE_FLASH_ATTR ConfigI2C(void)
 {
@@ -183,6 +187,8 @@ void cnlohr_i2c_write(const uint8_t* data, uint32_t no_of_bytes, bool repeated_s
     {
         cnl_err = 1;
     }
+    cnl_transfers++;
+    cnl_bytes += 1 + no_of_bytes;
     for( i = 0; i < no_of_bytes; i++ )
     {
         if( SendByte( data[i], cnl_highSpeed ) )
@@ -216,6 +222,8 @@ void cnlohr_i2c_read(uint8_t* data, uint32_t nr_of_bytes, bool repeated_start)
     {
         cnl_err = 1;
     }
+    cnl_transfers++;
+    cnl_bytes += 1 + nr_of_bytes;
 
     // if( repeated_start ) SendStart();
     unsigned i;
@@ -227,6 +235,13 @@ void cnlohr_i2c_read(uint8_t* data, uint32_t nr_of_bytes, bool repeated_start)
     SendStop(cnl_highSpeed);
 }
 
+//Get the number of bytes and transfers (writes or reads) sent since boot.
+void cnlohr_i2c_get_stats(uint32_t* bytes, uint32_t* transfers)
+{
+    *bytes = cnl_bytes;
+    *transfers = cnl_transfers;
+}
+
 uint8_t cnlohr_i2c_end_transaction(void)
 {
     SendStop(cnl_highSpeed);
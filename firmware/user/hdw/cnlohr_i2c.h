@@ -26,6 +26,7 @@ void cnlohr_i2c_write(const uint8_t* data, uint32_t no_of_bytes, bool repeated_s
 void cnlohr_i2c_start_transaction(uint8_t slave_address, uint16_t SCL_frequency_KHz);
 void cnlohr_i2c_read(uint8_t* data, uint32_t nr_of_bytes, bool repeated_start);
 uint8_t cnlohr_i2c_end_transaction(void);
+void cnlohr_i2c_get_stats(uint32_t* bytes, uint32_t* transfers);
 
 //Do nothing, will be handled on first transaction.
 void cnlohr_i2c_setup(uint32_t clock_stretch_time_out_usec);
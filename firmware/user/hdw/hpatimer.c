@@ -75,11 +75,20 @@ volatile struct
     volatile uint8_t sounddata[HPABUFFSIZE];
     volatile uint16_t soundhead;
     volatile uint16_t soundtail;
+    // Set from peekSampleBlock() until releaseSampleBlock(). While set, the
+    // ISR never moves the tail, so the peeked block can't be overwritten
+    volatile bool peeking;
+    micOverrunPolicy_t overrunPolicy;
+    bool inOverrun;
+    uint32_t samplesDropped;
+    uint32_t overruns;
+    uint16_t highWater;
 } mic =
 {
     .soundhead = 0,
     .soundtail = 0,
-    .sounddata = {0}
+    .sounddata = {0},
+    .overrunPolicy = MIC_DROP_NEWEST
 };
 
 /*============================================================================
@@ -113,8 +122,37 @@ static void timerhandle( void* v __attribute__((unused)))
         case MIC:
         {
             uint16_t r = hs_adc_read();
+            uint16_t nextHead = (mic.soundhead + 1) & (HPABUFFSIZE - 1);
+            if(nextHead == mic.soundtail)
+            {
+                // The queue is full, procTask isn't keeping up
+                if(false == mic.inOverrun)
+                {
+                    mic.inOverrun = true;
+                    mic.overruns++;
+                }
+                mic.samplesDropped++;
+                if(MIC_DROP_NEWEST == mic.overrunPolicy || mic.peeking)
+                {
+                    // The oldest samples may be being read, drop this one
+                    break;
+                }
+                // Throw away the oldest sample to make room
+                mic.soundtail = (mic.soundtail + 1) & (HPABUFFSIZE - 1);
+            }
+            else
+            {
+                mic.inOverrun = false;
+            }
             mic.sounddata[mic.soundhead] = r >> 6;
-            mic.soundhead = (mic.soundhead + 1) & (HPABUFFSIZE - 1);
+            mic.soundhead = nextHead;
+
+            // Track the fill level
+            uint16_t queued = (mic.soundhead - mic.soundtail) & (HPABUFFSIZE - 1);
+            if(queued > mic.highWater)
+            {
+                mic.highWater = queued;
+            }
             break;
         }
         case BZR:
@@ -222,6 +260,15 @@ bool ICACHE_FLASH_ATTR sampleAvailable(void)
     return mic.soundhead != mic.soundtail;
 }
 
+/**
+ * @return The number of samples read from the ADC and queued for processing.
+ * The queue overruns at HPABUFFSIZE - 1
+ */
+uint16_t ICACHE_FLASH_ATTR getSampleCount(void)
+{
+    return (mic.soundhead - mic.soundtail) & (HPABUFFSIZE - 1);
+}
+
 /**
  * Get a sample from the ADC in the queue, return it, and increment the queue so
  * the next sample is returned the next time this is called
@@ -230,9 +277,94 @@ bool ICACHE_FLASH_ATTR sampleAvailable(void)
  */
 uint8_t ICACHE_FLASH_ATTR getSample(void)
 {
-    uint8_t samp = mic.sounddata[mic.soundtail];
-    mic.soundtail = (mic.soundtail + 1) % (HPABUFFSIZE);
-    return samp;
+    const uint8_t* samp;
+    peekSampleBlock(&samp);
+    uint8_t val = *samp;
+    releaseSampleBlock(1);
+    return val;
+}
+
+/**
+ * Get the queued samples which are contiguous in the queue, without removing
+ * them. If any are returned, releaseSampleBlock() must be called before the
+ * next peek. Until then the ISR only writes past the head and won't move the
+ * tail, even with MIC_DROP_OLDEST, so the samples are safe to read. If the
+ * queued samples wrap around the end of the queue, the rest are returned by
+ * the next call
+ *
+ * @param block Returns a pointer to the first queued sample
+ * @return The number of samples at block
+ */
+uint16_t ICACHE_FLASH_ATTR peekSampleBlock(const uint8_t** block)
+{
+    // Stop the ISR from moving the tail before reading it
+    mic.peeking = true;
+    uint16_t head = mic.soundhead;
+    uint16_t tail = mic.soundtail;
+    *block = (const uint8_t*)&mic.sounddata[tail];
+
+    uint16_t n = (head >= tail) ? (head - tail) : (HPABUFFSIZE - tail);
+    if(0 == n)
+    {
+        // Nothing to release, so nothing to protect
+        mic.peeking = false;
+    }
+    return n;
+}
+
+/**
+ * Remove samples returned by peekSampleBlock() from the queue
+ *
+ * @param n The number of samples to remove
+ */
+void ICACHE_FLASH_ATTR releaseSampleBlock(uint16_t n)
+{
+    // The ISR left the tail alone since the peek. Move it and end the peek
+    // together, so the ISR can't drop the oldest sample from a stale tail
+    ets_intr_lock();
+    mic.soundtail = (mic.soundtail + n) & (HPABUFFSIZE - 1);
+    mic.peeking = false;
+    ets_intr_unlock();
+}
+
+/**
+ * Set what happens to samples when the mic queue is full
+ *
+ * @param policy MIC_DROP_NEWEST to throw away new samples, MIC_DROP_OLDEST to
+ *               overwrite the oldest queued samples
+ */
+void ICACHE_FLASH_ATTR setMicOverrunPolicy(micOverrunPolicy_t policy)
+{
+    mic.overrunPolicy = policy;
+}
+
+/**
+ * Get statistics about the mic queue since the last resetMicStats(). These can
+ * be used to size the queue and find what stalls procTask()
+ *
+ * @param stats The statistics are written here
+ */
+void ICACHE_FLASH_ATTR getMicStats(micStats_t* stats)
+{
+    ets_intr_lock();
+    stats->samplesDropped = mic.samplesDropped;
+    stats->overruns = mic.overruns;
+    stats->highWater = mic.highWater;
+    ets_intr_unlock();
+    // One slot is always empty so a full queue can be told from an empty one
+    stats->capacity = HPABUFFSIZE - 1;
+}
+
+/**
+ * Reset the mic queue statistics
+ */
+void ICACHE_FLASH_ATTR resetMicStats(void)
+{
+    ets_intr_lock();
+    mic.samplesDropped = 0;
+    mic.overruns = 0;
+    mic.highWater = 0;
+    ets_intr_unlock();
 }
 
 /*============================================================================
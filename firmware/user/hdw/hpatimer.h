@@ -9,6 +9,21 @@
 
 #include "buzzer.h"
 
+typedef enum
+{
+    MIC_DROP_NEWEST, ///< When the queue is full, new samples are thrown away
+    MIC_DROP_OLDEST  ///< When the queue is full, the oldest queued sample is overwritten.
+                     ///< While a block is peeked, new samples are thrown away instead
+} micOverrunPolicy_t;
+
+typedef struct
+{
+    uint32_t samplesDropped; ///< The number of samples lost to overruns
+    uint32_t overruns;       ///< The number of times the queue filled up
+    uint16_t highWater;      ///< The most samples which were queued at once
+    uint16_t capacity;       ///< The most samples which can be queued at once
+} micStats_t;
+
 void ICACHE_FLASH_ATTR StartHPATimer(void);
 void ContinueHPATimer(void);
 void PauseHPATimer(void);
@@ -22,6 +37,12 @@ void ICACHE_FLASH_ATTR startBuzzerSong(const song_t* song, bool shouldLoop);
 void ICACHE_FLASH_ATTR initMic(void);
 uint8_t ICACHE_FLASH_ATTR getSample(void);
 bool ICACHE_FLASH_ATTR sampleAvailable(void);
+uint16_t ICACHE_FLASH_ATTR getSampleCount(void);
+uint16_t ICACHE_FLASH_ATTR peekSampleBlock(const uint8_t** block);
+void ICACHE_FLASH_ATTR releaseSampleBlock(uint16_t n);
+void ICACHE_FLASH_ATTR setMicOverrunPolicy(micOverrunPolicy_t policy);
+void ICACHE_FLASH_ATTR getMicStats(micStats_t* stats);
+void ICACHE_FLASH_ATTR resetMicStats(void);
 
 #endif
 
@@ -3,6 +3,8 @@
 #include "DFT32.h"
 #include <string.h>
 
+#if !CC_USE_FFT32
+
 #ifndef CCEMBEDDED
     #include <stdlib.h>
     #include <stdio.h>
@@ -189,8 +191,9 @@ void UpdateOutputBins32(void)
 #endif
 
 #if APPROXNORM == 1
-        // using full 32 bit precision for isps and ispc
-        uint32_t rmux = isps > ispc ? isps + (ispc >> 1) : ispc + (isps >> 1);
+        // using full 32 bit precision for isps and ispc, summed unsigned since
+        // a clipping mic can take them past INT32_MAX
+        uint32_t rmux = isps > ispc ? (uint32_t)isps + (ispc >> 1) : (uint32_t)ispc + (isps >> 1);
         rmux = rmux >> 16; // keep most significant 16 bits
 #else
         // use the most significant 16 bits of isps and ispc when squaring
@@ -324,6 +327,16 @@ void PushSample32( int16_t dat )
     HandleInt( dat );
 }
 
+void PushSamples32( const int16_t* dats, uint16_t n )
+{
+    while( n-- )
+    {
+        int16_t dat = *(dats++);
+        HandleInt( dat );
+        HandleInt( dat );
+    }
+}
+
 
 #ifndef CCEMBEDDED
 
@@ -385,5 +398,4 @@ void DoDFTProgressive32( float* outbins, float* frequencies, int bins, const flo
 
 #endif
 
-
-
+#endif //!CC_USE_FFT32
@@ -50,7 +50,9 @@
 //notes per audio frame.
 //This is sort of working, but still have some quality issues.
 //It would theoretically be fast enough to work on an AVR.
-//NOTE: This is the only DFT available to the embedded port of ColorChord
+//NOTE: This is the only DFT available to the embedded port of ColorChord,
+//besides the block FFT in FFT32.c, which has the same interface below and is
+//selected with CC_USE_FFT32
 #ifndef CCEMBEDDED
 void DoDFTProgressive32( float* outbins, float* frequencies, int bins,
                          const float* databuffer, int place_in_data_buffer, int size_of_data_buffer,
@@ -65,6 +67,8 @@ void UpdateBins32( const uint16_t* frequencies );
 //Though it accepts an int16, it actually only takes -4095 to +4095. (13-bit)
 //Any more and you will exceed the accumulators and it will cause an overflow.
 void PushSample32( int16_t dat );
+//Same as PushSample32, for n samples at a time.
+void PushSamples32( const int16_t* dats, uint16_t n );
 
 #ifndef CCEMBEDDED
     //ColorChord regular uses this to pass in floats.
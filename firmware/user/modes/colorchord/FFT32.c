@@ -0,0 +1,276 @@
+//Copyright 2015 <>< Charles Lohr under the ColorChord License.
+
+//A block fixed-point FFT which fills embeddedbins32[] the same way DFT32.c
+//does, so the rest of ColorChord can't tell them apart.  Set CC_USE_FFT32 to
+//1 in ccconfig.h to use it instead of the progressive DFT.
+//
+//Each octave gets its own stream of samples, at half the rate of the octave
+//above it, by averaging pairs of samples.  Because of that, bin N of every
+//octave's FFT is the same note, just in a different octave, so one table of
+//FFT bin positions works for all of them.  An octave's FFT is only run once
+//FFT32_HOP new samples arrived for it, so the top octave runs once per 128
+//sample frame, the one below every other frame, and so on.
+
+#include "DFT32.h"
+#include <string.h>
+
+#if CC_USE_FFT32
+
+#define FFT32_SIZE 256
+#define FFT32_HOP  64
+
+uint16_t embeddedbins32[FIXBINS];
+
+//A table of precomputed sin() values.  Ranging -32767 to +32767 (Q15)
+static const int16_t Sfftsintable[FFT32_SIZE] =
+{
+         0,    804,   1607,   2410,   3211,   4011,   4807,   5601,
+      6392,   7179,   7961,   8739,   9511,  10278,  11038,  11792,
+     12539,  13278,  14009,  14732,  15446,  16150,  16845,  17530,
+     18204,  18867,  19519,  20159,  20787,  21402,  22004,  22594,
+     23169,  23731,  24278,  24811,  25329,  25831,  26318,  26789,
+     27244,  27683,  28105,  28510,  28897,  29268,  29621,  29955,
+     30272,  30571,  30851,  31113,  31356,  31580,  31785,  31970,
+     32137,  32284,  32412,  32520,  32609,  32678,  32727,  32757,
+     32767,  32757,  32727,  32678,  32609,  32520,  32412,  32284,
+     32137,  31970,  31785,  31580,  31356,  31113,  30851,  30571,
+     30272,  29955,  29621,  29268,  28897,  28510,  28105,  27683,
+     27244,  26789,  26318,  25831,  25329,  24811,  24278,  23731,
+     23169,  22594,  22004,  21402,  20787,  20159,  19519,  18867,
+     18204,  17530,  16845,  16150,  15446,  14732,  14009,  13278,
+     12539,  11792,  11038,  10278,   9511,   8739,   7961,   7179,
+      6392,   5601,   4807,   4011,   3211,   2410,   1607,    804,
+         0,   -804,  -1607,  -2410,  -3211,  -4011,  -4807,  -5601,
+     -6392,  -7179,  -7961,  -8739,  -9511, -10278, -11038, -11792,
+    -12539, -13278, -14009, -14732, -15446, -16150, -16845, -17530,
+    -18204, -18867, -19519, -20159, -20787, -21402, -22004, -22594,
+    -23169, -23731, -24278, -24811, -25329, -25831, -26318, -26789,
+    -27244, -27683, -28105, -28510, -28897, -29268, -29621, -29955,
+    -30272, -30571, -30851, -31113, -31356, -31580, -31785, -31970,
+    -32137, -32284, -32412, -32520, -32609, -32678, -32727, -32757,
+    -32767, -32757, -32727, -32678, -32609, -32520, -32412, -32284,
+    -32137, -31970, -31785, -31580, -31356, -31113, -30851, -30571,
+    -30272, -29955, -29621, -29268, -28897, -28510, -28105, -27683,
+    -27244, -26789, -26318, -25831, -25329, -24811, -24278, -23731,
+    -23169, -22594, -22004, -21402, -20787, -20159, -19519, -18867,
+    -18204, -17530, -16845, -16150, -15446, -14732, -14009, -13278,
+    -12539, -11792, -11038, -10278,  -9511,  -8739,  -7961,  -7179,
+     -6392,  -5601,  -4807,  -4011,  -3211,  -2410,  -1607,   -804,
+};
+
+/* The above table was created using the following code:
+#include <math.h>
+#include <stdio.h>
+
+int main()
+{
+    int i;
+    printf( "static const int16_t Sfftsintable[FFT32_SIZE] = {" );
+    for( i = 0; i < 256; i++ )
+    {
+        if( !(i & 0x7 ) )
+        {
+            printf( "\n\t" );
+        }
+        printf( "%6d,", (int)(sin( i / 256.0 * 2 * M_PI ) * 32767) );
+    }
+    printf( "};\n" );
+} */
+
+//The most recent samples for each octave, lowest octave first
+static int16_t Sffthistory[OCTAVES][FFT32_SIZE];
+static uint16_t Sffthistplace[OCTAVES];
+static uint8_t Sfftnewsamples[OCTAVES];
+
+//The first sample of a pair, waiting for the second to be averaged with
+static int16_t Sfftpending[OCTAVES];
+static uint8_t Sffthavepending[OCTAVES];
+
+//Where each note falls in every octave's FFT, 8 bits of fraction
+static uint16_t Sfftbinplace[FIXBPERO];
+
+//Working space for the FFT
+static int16_t Sfftre[FFT32_SIZE];
+static int16_t Sfftim[FFT32_SIZE];
+
+//In-place radix-2 FFT of Sfftre/Sfftim. Every stage halves the values so
+//nothing overflows, so the output is scaled by 1/FFT32_SIZE.
+static void FFT32Transform(void)
+{
+    int i, j, m, l;
+
+    //Put the samples in bit-reversed order
+    for( i = 0, j = 0; i < FFT32_SIZE; i++ )
+    {
+        if( i < j )
+        {
+            int16_t t = Sfftre[i];
+            Sfftre[i] = Sfftre[j];
+            Sfftre[j] = t;
+            t = Sfftim[i];
+            Sfftim[i] = Sfftim[j];
+            Sfftim[j] = t;
+        }
+        m = FFT32_SIZE >> 1;
+        while( m && (j & m) )
+        {
+            j ^= m;
+            m >>= 1;
+        }
+        j |= m;
+    }
+
+    //Then do the butterflies
+    for( l = 1; l < FFT32_SIZE; l <<= 1 )
+    {
+        int twiddlestep = FFT32_SIZE / (l * 2);
+        for( m = 0; m < l; m++ )
+        {
+            int place = m * twiddlestep;
+            int32_t wr = Sfftsintable[(place + FFT32_SIZE / 4) & (FFT32_SIZE - 1)];
+            int32_t wi = -Sfftsintable[place];
+            for( i = m; i < FFT32_SIZE; i += l * 2 )
+            {
+                j = i + l;
+                int32_t tr = (wr * Sfftre[j] - wi * Sfftim[j]) >> 15;
+                int32_t ti = (wr * Sfftim[j] + wi * Sfftre[j]) >> 15;
+                int32_t qr = Sfftre[i];
+                int32_t qi = Sfftim[i];
+                Sfftre[j] = (qr - tr) >> 1;
+                Sfftim[j] = (qi - ti) >> 1;
+                Sfftre[i] = (qr + tr) >> 1;
+                Sfftim[i] = (qi + ti) >> 1;
+            }
+        }
+    }
+}
+
+//Approximate magnitude of one FFT output, like APPROXNORM
+static uint32_t FFT32Magnitude( int i )
+{
+    int32_t re = Sfftre[i];
+    int32_t im = Sfftim[i];
+    re = re < 0 ? -re : re;
+    im = im < 0 ? -im : im;
+    return re > im ? re + (im >> 1) : im + (re >> 1);
+}
+
+//Window the history of one octave, FFT it and update its bins
+static void FFT32Octave( int octave )
+{
+    int i;
+    uint16_t place = Sffthistplace[octave];
+
+    //Hann window the samples, oldest first.  Samples should be at most 13
+    //bits, so scale them up to use all of the int16_t
+    for( i = 0; i < FFT32_SIZE; i++ )
+    {
+        int32_t window = (32767 - Sfftsintable[(i + FFT32_SIZE / 4) & (FFT32_SIZE - 1)]) >> 1;
+        int32_t windowed = (Sffthistory[octave][place] * window) >> 12;
+        place = (place + 1) & (FFT32_SIZE - 1);
+        if( windowed > 32767 )
+        {
+            windowed = 32767;
+        }
+        else if( windowed < -32767 )
+        {
+            windowed = -32767;
+        }
+        Sfftre[i] = windowed;
+        Sfftim[i] = 0;
+    }
+
+    FFT32Transform();
+
+    for( i = 0; i < FIXBPERO; i++ )
+    {
+        //Interpolate between the FFT bins on either side of the note
+        int bin = Sfftbinplace[i] >> 8;
+        int32_t frac = Sfftbinplace[i] & 0xff;
+        int32_t lo = FFT32Magnitude( bin );
+        int32_t hi = FFT32Magnitude( bin + 1 );
+        uint32_t rmux = lo + (((hi - lo) * frac) >> 8);
+
+        //Scale to roughly match the level of the progressive DFT.  Its nerf
+        //by octave only makes up for upper octaves being updated more often,
+        //so there is nothing to nerf here
+        embeddedbins32[octave * FIXBPERO + i] = (rmux * 13) >> 4;
+    }
+}
+
+void UpdateOutputBins32(void)
+{
+    int i;
+    for( i = 0; i < OCTAVES; i++ )
+    {
+        if( Sfftnewsamples[i] >= FFT32_HOP )
+        {
+            Sfftnewsamples[i] = 0;
+            FFT32Octave( i );
+        }
+    }
+}
+
+int SetupDFTProgressive32(void)
+{
+    memset( Sffthistory, 0, sizeof( Sffthistory ) );
+    memset( Sffthistplace, 0, sizeof( Sffthistplace ) );
+    memset( Sfftnewsamples, 0, sizeof( Sfftnewsamples ) );
+    memset( Sffthavepending, 0, sizeof( Sffthavepending ) );
+    memset( embeddedbins32, 0, sizeof( embeddedbins32 ) );
+    return 0;
+}
+
+void UpdateBins32( const uint16_t* frequencies )
+{
+    int i;
+    for( i = 0; i < FIXBPERO; i++ )
+    {
+        //frequencies[] are (65536 * 16 / CC_SAMPLE_RATE) * Hz for the lowest
+        //octave. The lowest octave runs at CC_SAMPLE_RATE >> OCTAVES, so its
+        //FFT bin is Hz * FFT32_SIZE / (CC_SAMPLE_RATE >> OCTAVES)
+        uint32_t place = ((uint32_t)frequencies[i] * FFT32_SIZE << OCTAVES) >> 12;
+        //Leave room to interpolate with the next bin
+        if( place > ((FFT32_SIZE / 2 - 2) << 8) )
+        {
+            place = (FFT32_SIZE / 2 - 2) << 8;
+        }
+        Sfftbinplace[i] = place;
+    }
+}
+
+void PushSample32( int16_t dat )
+{
+    int32_t sample = dat;
+    int i;
+
+    //Feed the octaves from the top down, halving the rate each time
+    for( i = OCTAVES - 1; i >= 0; i-- )
+    {
+        if( !Sffthavepending[i] )
+        {
+            Sfftpending[i] = sample;
+            Sffthavepending[i] = 1;
+            return;
+        }
+        Sffthavepending[i] = 0;
+        sample = (Sfftpending[i] + sample) >> 1;
+
+        Sffthistory[i][Sffthistplace[i]] = sample;
+        Sffthistplace[i] = (Sffthistplace[i] + 1) & (FFT32_SIZE - 1);
+        if( Sfftnewsamples[i] < FFT32_HOP )
+        {
+            Sfftnewsamples[i]++;
+        }
+    }
+}
+
+void PushSamples32( const int16_t* dats, uint16_t n )
+{
+    while( n-- )
+    {
+        PushSample32( *(dats++) );
+    }
+}
+
+#endif
@@ -1,14 +1,39 @@
 #ifndef _CCCONFIG_H
 #define _CCCONFIG_H
 
-#include <c_types.h>
+#ifdef ICACHE_FLASH
+    #include <c_types.h> //If on ESP8266
+#else
+    //So the pipeline can be built and run on a PC
+    #include <stdint.h>
+    #include <stdbool.h>
+    #include <string.h>
+    #define ICACHE_FLASH_ATTR
+    #define ets_memset memset
+    #define ets_memcpy memcpy
+#endif
 
 #define HPABUFFSIZE 512
 
 #define CCEMBEDDED
+
+//Set to 1 to fill embeddedbins32[] with the block FFT in FFT32.c instead of
+//the progressive DFT in DFT32.c
+#ifndef CC_USE_FFT32
+    #define CC_USE_FFT32 0
+#endif
 #define NUM_LIN_LEDS 6
 #define DFREQ 16000
 
+//How much the mic's samples are decimated before ColorChord gets them. The top
+//octave ends at 1760Hz, so 2 halves the DFT's work without losing notes. 4
+//attenuates the top of the top octave
+#ifndef CC_DECIMATION
+    #define CC_DECIMATION 1
+#endif
+//The rate ColorChord actually gets samples at
+#define CC_SAMPLE_RATE (DFREQ / CC_DECIMATION)
+
 #define ROOT_NOTE_OFFSET     CCS.gROOT_NOTE_OFFSET
 #define DFTIIR               CCS.gDFTIIR
 #define FUZZ_IIR_BITS        CCS.gFUZZ_IIR_BITS
@@ -27,6 +52,10 @@
 #define COLORCHORD_OUTPUT_DRIVER CCS.gCOLORCHORD_OUTPUT_DRIVER
 #define COLORCHORD_ACTIVE    CCS.gCOLORCHORD_ACTIVE
 #define INITIAL_AMP          CCS.gINITIAL_AMP
+#define AGC_ENABLE           CCS.gAGC_ENABLE
+#define AGC_TARGET           CCS.gAGC_TARGET
+#define AGC_ATTACK_BITS      CCS.gAGC_ATTACK_BITS
+#define AGC_RELEASE_BITS     CCS.gAGC_RELEASE_BITS
 
 //We are not enabling these for the ESP8266 port.
 #define LIN_WRAPAROUND 0
@@ -52,6 +81,10 @@ struct CCSettings
     uint8_t gCOLORCHORD_ACTIVE;
     uint8_t gCOLORCHORD_OUTPUT_DRIVER;
     uint8_t gINITIAL_AMP;
+    uint8_t gAGC_ENABLE;        //=0 When set, gain is automatic, not gINITIAL_AMP
+    uint8_t gAGC_TARGET;        //=64 Peak level to aim for, in units of 32
+    uint8_t gAGC_ATTACK_BITS;   //=1 How fast gain drops when it gets loud
+    uint8_t gAGC_RELEASE_BITS;  //=8 How fast gain rises when it gets quiet
 };
 
 extern struct CCSettings CCS;
@@ -0,0 +1,197 @@
+#include "embeddedbeat.h"
+#ifdef ICACHE_FLASH
+    #include "osapi.h"
+#endif
+#include "DFT32.h"
+
+#define BEAT_MIN_LAG (60 * BEAT_FRAME_RATE / BEAT_MAX_BPM)
+#define BEAT_MAX_LAG (60 * BEAT_FRAME_RATE / BEAT_MIN_BPM)
+#define BEAT_NUM_LAGS (BEAT_MAX_LAG - BEAT_MIN_LAG + 1)
+//Must be a power of two bigger than BEAT_MAX_LAG
+#define BEAT_HISTORY 128
+
+uint8_t  beat_bpm;
+uint8_t  beat_confidence;
+uint16_t beat_strength;
+
+static uint16_t Sbandlog[OCTAVES];          //Log energy of each octave, last frame
+static uint16_t Sonsethistory[BEAT_HISTORY]; //Onset strength, by frame
+static uint8_t  Sonsetplace;
+static int32_t  Sacf[BEAT_NUM_LAGS];         //Autocorrelation of onset strength
+static uint32_t Sfluxmean;                  //<<4
+static uint32_t Sfluxdev;                   //<<4
+static uint16_t Sstrengthpeak;              //Decaying peak of onset strength
+static uint16_t Sframessinceonset;
+static uint16_t Sframessincebeat;
+static uint8_t  Sflywheel;                  //The last beat was guessed, not heard
+static uint8_t  Soffbeats;                  //Onsets in a row between beats
+static uint8_t  Speriod;                    //Frames between beats
+
+//log2(val) << 4, with the fraction roughly linear.  0 for 0.
+static uint16_t ICACHE_FLASH_ATTR FixLog2( uint32_t val )
+{
+    uint16_t ret = 0;
+    if( !val )
+    {
+        return 0;
+    }
+    while( val >= 32 )
+    {
+        val >>= 1;
+        ret += 16;
+    }
+    while( val < 16 )
+    {
+        val <<= 1;
+        ret -= 16;
+    }
+    //val is now 16..31, 4 bits of fraction
+    return ret + 64 + (val - 16);
+}
+
+void ICACHE_FLASH_ATTR InitBeat(void)
+{
+    ets_memset( Sbandlog, 0, sizeof( Sbandlog ) );
+    ets_memset( Sonsethistory, 0, sizeof( Sonsethistory ) );
+    ets_memset( Sacf, 0, sizeof( Sacf ) );
+    Sonsetplace = 0;
+    Sfluxmean = 0;
+    Sfluxdev = 0;
+    Sstrengthpeak = 0;
+    Sframessinceonset = 0;
+    Sframessincebeat = 0;
+    Sflywheel = 0;
+    Soffbeats = 0;
+    Speriod = (BEAT_MIN_LAG + BEAT_MAX_LAG) / 2;
+    beat_bpm = 0;
+    beat_confidence = 0;
+    beat_strength = 0;
+}
+
+uint8_t ICACHE_FLASH_ATTR HandleBeatFrame(void)
+{
+    int i, j;
+    uint8_t flags = 0;
+
+    PullFrameStage( FRAME_STAGE_BINS );
+
+    //Spectral flux: how much the log energy of each octave rose
+    uint32_t flux = 0;
+    for( i = 0; i < OCTAVES; i++ )
+    {
+        uint32_t energy = 0;
+        for( j = 0; j < FIXBPERO; j++ )
+        {
+            energy += embeddedbins32[i * FIXBPERO + j];
+        }
+        uint16_t bandlog = FixLog2( energy );
+        if( bandlog > Sbandlog[i] )
+        {
+            flux += bandlog - Sbandlog[i];
+        }
+        Sbandlog[i] = bandlog;
+    }
+
+    //Adaptive threshold, the mean plus twice the mean deviation
+    uint32_t flux4 = flux << 4;
+    uint32_t dev4 = flux4 > Sfluxmean ? flux4 - Sfluxmean : Sfluxmean - flux4;
+    Sfluxdev = Sfluxdev + (dev4 >> 4) - (Sfluxdev >> 4);
+    Sfluxmean = Sfluxmean + (flux4 >> 4) - (Sfluxmean >> 4);
+
+    //Onset strength is how far the flux is past the mean
+    beat_strength = flux4 > Sfluxmean ? (flux4 - Sfluxmean) >> 4 : 0;
+
+    if( Sframessinceonset < 0xffff )
+    {
+        Sframessinceonset++;
+    }
+    //Quiet ripples after a loud onset can pass the threshold on their own, so
+    //onsets must also be a fair fraction of the recent loudest one.
+    Sstrengthpeak -= Sstrengthpeak >> 6;
+    if( beat_strength > Sstrengthpeak )
+    {
+        Sstrengthpeak = beat_strength;
+    }
+    if( flux4 > Sfluxmean + (Sfluxdev << 1) && beat_strength &&
+            beat_strength >= (Sstrengthpeak >> 2) &&
+            Sframessinceonset >= BEAT_MIN_ONSET_GAP )
+    {
+        flags |= BEAT_FLAG_ONSET;
+        Sframessinceonset = 0;
+    }
+
+    //Autocorrelation of the onset strength for every lag which could be a beat
+    Sonsethistory[Sonsetplace] = beat_strength;
+    for( i = 0; i < BEAT_NUM_LAGS; i++ )
+    {
+        uint8_t lag = BEAT_MIN_LAG + i;
+        uint16_t then = Sonsethistory[(Sonsetplace - lag) & (BEAT_HISTORY - 1)];
+        int32_t prod = (int32_t)beat_strength * then;
+        Sacf[i] += (prod - Sacf[i]) >> BEAT_ACF_IIR_BITS;
+    }
+    Sonsetplace = (Sonsetplace + 1) & (BEAT_HISTORY - 1);
+
+    //A period which isn't a whole number of frames splits between two lags,
+    //so blur neighbouring lags before picking, or else twice the period (which
+    //lands whole) can win.
+    int32_t best = 0;
+    int32_t total = 0;
+    uint8_t bestlag = Speriod;
+    for( i = 1; i < BEAT_NUM_LAGS - 1; i++ )
+    {
+        int32_t score = Sacf[i - 1] + (Sacf[i] << 1) + Sacf[i + 1];
+        total += score;
+        if( score > best )
+        {
+            best = score;
+            bestlag = BEAT_MIN_LAG + i;
+        }
+    }
+
+    //Every other beat lines up too, so if half the period is nearly as good,
+    //it's the real one
+    i = bestlag / 2 - BEAT_MIN_LAG;
+    if( i >= 1 && i < BEAT_NUM_LAGS - 1 &&
+            Sacf[i - 1] + (Sacf[i] << 1) + Sacf[i + 1] > best / 2 )
+    {
+        bestlag /= 2;
+    }
+
+    //How much the best lag stands out from the average
+    int32_t mean = total / (BEAT_NUM_LAGS - 2);
+    beat_confidence = best > 0 ? ((best - mean) * 255) / best : 0;
+    Speriod = bestlag;
+    beat_bpm = (60 * BEAT_FRAME_RATE) / Speriod;
+
+    //Put beats on onsets near where the next beat should be, and keep the beat
+    //going through quiet parts
+    Sframessincebeat++;
+    if( flags & BEAT_FLAG_ONSET )
+    {
+        if( Sflywheel && Sframessincebeat <= Speriod / 4 )
+        {
+            //The guessed beat was a little early, line up with this onset
+            Sframessincebeat = 0;
+            Sflywheel = 0;
+            Soffbeats = 0;
+        }
+        else if( Sframessincebeat >= (Speriod * 3) / 4 ||
+                 ++Soffbeats >= BEAT_RELOCK_ONSETS )
+        {
+            //On time, or enough onsets in a row between beats that the
+            //phase must be wrong
+            flags |= BEAT_FLAG_BEAT;
+            Sframessincebeat = 0;
+            Sflywheel = 0;
+            Soffbeats = 0;
+        }
+    }
+    if( Sframessincebeat >= Speriod )
+    {
+        flags |= BEAT_FLAG_BEAT;
+        Sframessincebeat = 0;
+        Sflywheel = 1;
+    }
+
+    return flags;
+}
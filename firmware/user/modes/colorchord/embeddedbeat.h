@@ -0,0 +1,57 @@
+#ifndef _EMBEDDEDBEAT_H
+#define _EMBEDDEDBEAT_H
+
+#include "embeddednf.h"
+
+//An integer-only onset and beat tracker which runs on the DFT bins.  Call
+//HandleBeatFrame() once per frame, after NewFrameInfo().
+//
+//Onsets are found with spectral flux: the rise of the log energy of each
+//octave, summed, compared to an adaptive threshold.  The tempo is the lag with
+//the most autocorrelation of the onset strength, and beats are placed on
+//onsets which land near where the tempo says the next beat should be.  The
+//work per frame is fixed.
+
+//How many times a second HandleBeatFrame() is called
+#ifndef BEAT_FRAME_RATE
+    #define BEAT_FRAME_RATE (DFREQ / 128)
+#endif
+
+//The range of tempos to look for
+#ifndef BEAT_MIN_BPM
+    #define BEAT_MIN_BPM 60
+#endif
+#ifndef BEAT_MAX_BPM
+    #define BEAT_MAX_BPM 180
+#endif
+
+//Onsets closer than this many frames are counted as one
+#ifndef BEAT_MIN_ONSET_GAP
+    #define BEAT_MIN_ONSET_GAP (BEAT_FRAME_RATE / 10)
+#endif
+
+//After this many onsets in a row land between beats, the beat moves to them
+#ifndef BEAT_RELOCK_ONSETS
+    #define BEAT_RELOCK_ONSETS 3
+#endif
+
+//The higher the number, the longer the tempo estimate remembers
+#ifndef BEAT_ACF_IIR_BITS
+    #define BEAT_ACF_IIR_BITS 7
+#endif
+
+//Flags returned by HandleBeatFrame()
+#define BEAT_FLAG_ONSET 0x01 //Something started this frame
+#define BEAT_FLAG_BEAT  0x02 //This frame is on the beat
+
+extern uint8_t  beat_bpm;        //The current tempo estimate
+extern uint8_t  beat_confidence; //0..255 How much the tempo stands out
+extern uint16_t beat_strength;   //The onset strength of the latest frame
+
+//Call this when starting.
+void ICACHE_FLASH_ATTR InitBeat(void);
+
+//Returns BEAT_FLAG_* for this frame
+uint8_t ICACHE_FLASH_ATTR HandleBeatFrame(void);
+
+#endif
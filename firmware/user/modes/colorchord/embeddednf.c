@@ -1,7 +1,9 @@
 //Copyright 2015 <>< Charles Lohr under the ColorChord License.
 
 #include "embeddednf.h"
-#include "osapi.h"
+#ifdef ICACHE_FLASH
+    #include "osapi.h"
+#endif
 #include "DFT32.h"
 
 uint16_t folded_bins[FIXBPERO];
@@ -11,6 +13,22 @@ uint16_t note_peak_amps[MAXNOTES];
 uint16_t note_peak_amps2[MAXNOTES];
 uint8_t  note_jumped_to[MAXNOTES];
 
+static void ICACHE_FLASH_ATTR FrameStageBins(void);
+static void ICACHE_FLASH_ATTR FrameStageFuzz(void);
+static void ICACHE_FLASH_ATTR FrameStageFold(void);
+static void ICACHE_FLASH_ATTR FrameStageNotes(void);
+
+//The stages of HandleFrameInfo(), in frameStage_t order
+static void (*const SframeStages[FRAME_NUM_STAGES])(void) =
+{
+    FrameStageBins,
+    FrameStageFuzz,
+    FrameStageFold,
+    FrameStageNotes,
+};
+//How many stages are up to date with the latest frame
+static uint8_t SframeStagesDone;
+
 
 #ifndef PRECOMPUTE_FREQUENCY_TABLE
 static const float bf_table[24] =
@@ -66,11 +84,11 @@ void ICACHE_FLASH_ATTR UpdateFreqs()
     for( i = 0; i < FIXBPERO; i++ )
     {
         float frq =  ( bf_table[i] * BASE_FREQ );
-        fbins[i] = ( 65536.0 ) / ( DFREQ ) * frq * 16 + 0.5;
+        fbins[i] = ( 65536.0 ) / ( CC_SAMPLE_RATE ) * frq * 16 + 0.5;
     }
 #else
 
-#define PCOMP( f )  (uint16_t)((65536.0)/(DFREQ) * (f * BASE_FREQ) * 16 + 0.5)
+#define PCOMP( f )  (uint16_t)((65536.0)/(CC_SAMPLE_RATE) * (f * BASE_FREQ) * 16 + 0.5)
 
     static const uint16_t fbins[FIXBPERO] =
     {
@@ -101,6 +119,8 @@ void ICACHE_FLASH_ATTR InitColorChord(void)
 
     ets_memset( folded_bins, 0, sizeof( folded_bins ) );
     ets_memset( fuzzed_bins, 0, sizeof( fuzzed_bins ) );
+    //There's no frame yet, the zeroed outputs are up to date
+    SframeStagesDone = FRAME_NUM_STAGES;
 
     //Step 1: Initialize the Integer DFT.
 #ifdef USE_32DFT
@@ -114,16 +134,18 @@ void ICACHE_FLASH_ATTR InitColorChord(void)
     UpdateFreqs();
 }
 
-void ICACHE_FLASH_ATTR HandleFrameInfo(void)
+static void ICACHE_FLASH_ATTR FrameStageBins(void)
 {
-    int i, j, k;
-    uint8_t hitnotes[MAXNOTES];
-    ets_memset( hitnotes, 0, sizeof( hitnotes ) );
-
 #ifdef USE_32DFT
-    uint16_t* strens;
     UpdateOutputBins32();
-    strens = embeddedbins32;
+#endif
+}
+
+static void ICACHE_FLASH_ATTR FrameStageFuzz(void)
+{
+    int i;
+#ifdef USE_32DFT
+    uint16_t* strens = embeddedbins32;
 #else
     uint16_t* strens = embeddedbins;
 #endif
@@ -149,6 +171,11 @@ void ICACHE_FLASH_ATTR HandleFrameInfo(void)
         uint32_t taperamt = (65536 / FIXBPERO) * i;
         fuzzed_bins[newi] = (taperamt * fuzzed_bins[newi]) >> 16;
     }
+}
+
+static void ICACHE_FLASH_ATTR FrameStageFold(void)
+{
+    int i, j, k;
 
     //Fold the bins from fuzzedbins into one octave.
     for( i = 0; i < FIXBPERO; i++ )
@@ -200,6 +227,13 @@ void ICACHE_FLASH_ATTR HandleFrameInfo(void)
             folded_bins[i] = folded_out[i];
         }
     }
+}
+
+static void ICACHE_FLASH_ATTR FrameStageNotes(void)
+{
+    int i, j;
+    uint8_t hitnotes[MAXNOTES];
+    ets_memset( hitnotes, 0, sizeof( hitnotes ) );
 
     //Next, we have to find the peaks, this is what "decompose" does in our
     //normal tool.  As a warning, it expects that the values in foolded_bins
@@ -468,4 +502,26 @@ void ICACHE_FLASH_ATTR HandleFrameInfo(void)
 
 }
 
+void ICACHE_FLASH_ATTR NewFrameInfo(void)
+{
+    SframeStagesDone = 0;
+
+    //The fuzz IIR's time constant is in frames, so it steps every frame no
+    //matter who pulls the later stages, or how often
+    PullFrameStage( FRAME_STAGE_FUZZ );
+}
+
+void ICACHE_FLASH_ATTR PullFrameStage(frameStage_t stage)
+{
+    //Every stage needs the one before it, so run them in order up to stage
+    while( SframeStagesDone <= stage )
+    {
+        SframeStages[SframeStagesDone++]();
+    }
+}
 
+void ICACHE_FLASH_ATTR HandleFrameInfo(void)
+{
+    NewFrameInfo();
+    PullFrameStage( FRAME_STAGE_NOTES );
+}
@@ -13,6 +13,10 @@
     #define DFREQ     8000
 #endif
 
+#ifndef CC_SAMPLE_RATE
+    #define CC_SAMPLE_RATE DFREQ
+#endif
+
 //You may make this a float. If PRECOMPUTE_FREQUENCY_TABLE is defined, then
 //it will create the table at compile time, and the float will never be used
 //runtime.
@@ -96,8 +100,26 @@ extern uint16_t note_peak_amps2[MAXNOTES]; // (Responds quicker)
 extern uint8_t  note_jumped_to[MAXNOTES]; // When a note combines into another one,
 //this records where it went.  I.e. if your note just disappeared, check this flag.
 
+//The stages of processing a frame, in order.  Each stage needs the one before
+//it and fills in the arrays listed.
+typedef enum
+{
+    FRAME_STAGE_BINS,  //embeddedbins32
+    FRAME_STAGE_FUZZ,  //fuzzed_bins
+    FRAME_STAGE_FOLD,  //folded_bins
+    FRAME_STAGE_NOTES, //note_peak_freqs, note_peak_amps, note_peak_amps2, note_jumped_to
+    FRAME_NUM_STAGES
+} frameStage_t;
+
 void ICACHE_FLASH_ATTR UpdateFreqs(void);        //Not user-useful on most systems.
-void ICACHE_FLASH_ATTR HandleFrameInfo(void);    //Not user-useful on most systems
+void ICACHE_FLASH_ATTR HandleFrameInfo(void);    //Runs every stage for a new frame
+
+//Call this once a frame worth of samples has been pushed.  The bins and the
+//fuzz IIR are updated right away, the fold and the notes wait to be pulled.
+void ICACHE_FLASH_ATTR NewFrameInfo(void);
+//Run the stages needed to bring this stage up to date with the latest frame.
+//Stages which are already up to date aren't run again.
+void ICACHE_FLASH_ATTR PullFrameStage(frameStage_t stage);
 
 
 
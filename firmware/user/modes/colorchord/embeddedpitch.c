@@ -0,0 +1,113 @@
+#include "embeddedpitch.h"
+#include "DFT32.h"
+
+//log2(val) << 8, less a constant.  Only differences of these are used.
+static int32_t ICACHE_FLASH_ATTR PitchLog2( uint32_t val )
+{
+    int32_t ret = 0;
+    int i;
+    if( !val )
+    {
+        return 0;
+    }
+
+    //Bring val to 1.0 .. 2.0 in 1.15 fixed point
+    while( val >= ( 2 << 15 ) )
+    {
+        val >>= 1;
+        ret += 256;
+    }
+    while( val < ( 1 << 15 ) )
+    {
+        val <<= 1;
+        ret -= 256;
+    }
+
+    //Each squaring that passes 2.0 is another bit of the fraction
+    for( i = 7; i >= 0; i-- )
+    {
+        val = ( val * val ) >> 15;
+        if( val >= ( 2 << 15 ) )
+        {
+            val >>= 1;
+            ret += 1 << i;
+        }
+    }
+    return ret;
+}
+
+int32_t ICACHE_FLASH_ATTR FindPitch( uint16_t minamp )
+{
+    int i;
+    uint16_t maxamp = 0;
+
+    for( i = 0; i < FIXBINS; i++ )
+    {
+        if( embeddedbins32[i] > maxamp )
+        {
+            maxamp = embeddedbins32[i];
+        }
+    }
+    if( maxamp < minamp )
+    {
+        return PITCH_NONE;
+    }
+
+    //Find the lowest local maximum that's at least half the biggest one
+    for( i = 0; i < FIXBINS; i++ )
+    {
+        uint16_t b = embeddedbins32[i];
+        if( b < ( maxamp >> 1 ) )
+        {
+            continue;
+        }
+        if( i > 0 && embeddedbins32[i - 1] > b )
+        {
+            continue;
+        }
+        if( i < FIXBINS - 1 && embeddedbins32[i + 1] > b )
+        {
+            continue;
+        }
+        break;
+    }
+
+    //No neighbours to interpolate against at the ends
+    if( i == 0 || i == FIXBINS - 1 )
+    {
+        return i * PITCH_BIN_FRAC;
+    }
+
+    //Fit a parabola through the log of the peak and its neighbours, the top
+    //of it is where the note really is.  The bins' response is close to a
+    //gaussian, so this is a good deal better than fitting the bins themselves.
+    int32_t a = PitchLog2( embeddedbins32[i - 1] + 1 );
+    int32_t b = PitchLog2( embeddedbins32[i] + 1 );
+    int32_t c = PitchLog2( embeddedbins32[i + 1] + 1 );
+    int32_t den = 2 * ( a - 2 * b + c );
+    int32_t offset = 0;
+    if( den )
+    {
+        offset = ( ( a - c ) * PITCH_BIN_FRAC ) / den;
+    }
+    if( offset > PITCH_BIN_FRAC / 2 )
+    {
+        offset = PITCH_BIN_FRAC / 2;
+    }
+    else if( offset < -PITCH_BIN_FRAC / 2 )
+    {
+        offset = -PITCH_BIN_FRAC / 2;
+    }
+
+    return i * PITCH_BIN_FRAC + offset;
+}
+
+void ICACHE_FLASH_ATTR PitchToNote( int32_t pitch, uint8_t* note, uint8_t* octave,
+                                     int8_t* cents )
+{
+    int32_t semi = ( pitch + PITCH_SEMITONE / 2 ) / PITCH_SEMITONE;
+    *cents = ( ( pitch - semi * PITCH_SEMITONE ) * 100 ) / PITCH_SEMITONE;
+    *note = semi % 12;
+    //Octaves start at C, which is 3 semitones above A
+    *octave = 1 + ( semi + 9 ) / 12;
+}
@@ -0,0 +1,27 @@
+#ifndef _EMBEDDEDPITCH_H
+#define _EMBEDDEDPITCH_H
+
+#include "embeddednf.h"
+
+//Finds the pitch of a single note in embeddedbins32 to a few cents, for
+//tuning.  This uses the unfolded bins, since folding and the IIR's in
+//HandleFrameInfo() smear the peak.
+//
+//Pitches are in 1/PITCH_BIN_FRAC's of a bin from the bottom bin (BASE_FREQ),
+//so one semitone is 2*PITCH_BIN_FRAC.
+
+#define PITCH_BIN_FRAC 256
+#define PITCH_SEMITONE (PITCH_BIN_FRAC * FIXBINS / (OCTAVES * 12))
+#define PITCH_NONE     (-1)
+
+//Returns the pitch of the lowest strong peak in embeddedbins32, or PITCH_NONE
+//if no bin is at least minamp.  The lowest peak at least half as big as the
+//biggest is used, so loud harmonics don't make the note jump up.
+int32_t ICACHE_FLASH_ATTR FindPitch( uint16_t minamp );
+
+//Splits a pitch into a note (0 = A, 1 = A#, ... 11 = G#), an octave in
+//scientific pitch notation (BASE_FREQ is A1) and cents from the note (-50..50)
+void ICACHE_FLASH_ATTR PitchToNote( int32_t pitch, uint8_t* note, uint8_t* octave,
+                                     int8_t* cents );
+
+#endif
@@ -18,6 +18,8 @@
 #include "oled.h"
 #include "embeddednf.h"
 #include "embeddedout.h"
+#include "embeddedbeat.h"
+#include "font.h"
 
 /*============================================================================
  * Defines
@@ -27,6 +29,18 @@
 #define AMP_STEPS     6
 #define AMP_STEP_SIZE 6
 
+// Keep the same frame rate no matter how the samples are decimated
+#define SAMPLES_PER_FRAME (128 / CC_DECIMATION)
+
+// How many animation frames the beat indicator stays lit
+#define BEAT_FLASH_FRAMES 4
+
+// The king turns this far each animation frame. Its angles are rounded to the
+// rotation cache's step, which has room for every one of them, about 19KB
+#define KING_TURN_DEG 4
+#define KING_CACHE_STEP_DEG 15
+#define KING_CACHE_BYTES (20 * 1024)
+
 /*============================================================================
  * Prototypes
  *==========================================================================*/
@@ -34,6 +48,8 @@
 void ICACHE_FLASH_ATTR colorchordEnterMode(void);
 void ICACHE_FLASH_ATTR colorchordExitMode(void);
 void ICACHE_FLASH_ATTR colorchordSampleHandler(int32_t samp);
+void ICACHE_FLASH_ATTR colorchordSampleBlockHandler(const int16_t* samples, uint16_t n);
+void ICACHE_FLASH_ATTR colorchordProcessFrame(void);
 void ICACHE_FLASH_ATTR colorchordButtonCallback(uint8_t state __attribute__((unused)),
         int button, int down);
 void ICACHE_FLASH_ATTR ccLedOverrideReset(void* timer_arg __attribute__((unused)));
@@ -50,6 +66,7 @@ swadgeMode colorchordMode =
     .fnExitMode = colorchordExitMode,
     .fnButtonCallback = colorchordButtonCallback,
     .fnAudioCallback = colorchordSampleHandler,
+    .fnAudioBlockCallback = colorchordSampleBlockHandler,
     .wifiMode = NO_WIFI,
     .fnEspNowRecvCb = NULL,
     .fnEspNowSendCb = NULL,
@@ -61,6 +78,8 @@ struct
     syncedTimer_t ccLedOverrideTimer;
     bool ccOverrideLeds;
     syncedTimer_t ccAnimationTimer;
+    assetHandle_t kingHandle;
+    uint8_t beatFlash;
 } cc;
 
 struct CCSettings CCS =
@@ -82,7 +101,11 @@ struct CCSettings CCS =
     .gUSE_NUM_LIN_LEDS     = NUM_LIN_LEDS,
     .gCOLORCHORD_ACTIVE    = 1,
     .gCOLORCHORD_OUTPUT_DRIVER = 1,
-    .gINITIAL_AMP          = 80
+    .gINITIAL_AMP          = 80,
+    .gAGC_ENABLE           = 0,
+    .gAGC_TARGET           = 64,
+    .gAGC_ATTACK_BITS      = 1,
+    .gAGC_RELEASE_BITS     = 8
 };
 
 /*============================================================================
@@ -95,6 +118,8 @@ struct CCSettings CCS =
 void ICACHE_FLASH_ATTR colorchordEnterMode(void)
 {
     InitColorChord();
+    InitBeat();
+    setAudioDecimation(CC_DECIMATION);
 
     ets_memset(&cc, 0, sizeof(cc));
 
@@ -102,6 +127,11 @@ void ICACHE_FLASH_ATTR colorchordEnterMode(void)
 
     cc.ccOverrideLeds = false;
 
+    // Look up the image once, it's drawn every frame
+    getAssetHandle("king.png", &cc.kingHandle);
+    // It spins, so cache each angle instead of transforming every pixel
+    setAssetRotationCache(KING_CACHE_BYTES, KING_CACHE_STEP_DEG);
+
     // Setup the LED override timer, but don't arm it
     ets_memset(&cc.ccLedOverrideTimer, 0, sizeof(syncedTimer_t));
     syncedTimerDisarm(&cc.ccLedOverrideTimer);
@@ -116,10 +146,11 @@ void ICACHE_FLASH_ATTR ccAnimation(void* arg __attribute__((unused)))
 {
     clearDisplay();
     static uint16_t rotation = 0;
-    rotation = (rotation + 4) % 360;
-    drawBitmapFromAsset("king.png", (128 - 37) / 2, 0, false, false, rotation);
+    rotation = (rotation + KING_TURN_DEG) % 360;
+    drawBitmapFromHandle(&cc.kingHandle, (128 - 37) / 2, 0, false, false, rotation);
 
-    // Draw a bar graph
+    // Draw a bar graph, which only needs the folded bins
+    PullFrameStage(FRAME_STAGE_FOLD);
     uint8_t numBins = sizeof(folded_bins) / sizeof(folded_bins[0]);
     uint8_t binWidth = OLED_WIDTH / numBins;
     uint8_t i;
@@ -128,15 +159,31 @@ void ICACHE_FLASH_ATTR ccAnimation(void* arg __attribute__((unused)))
         uint8_t height = (16 * folded_bins[i]) / 2048;
         fillDisplayArea(i * binWidth, OLED_HEIGHT - height, (i + 1) * binWidth, OLED_HEIGHT, WHITE);
     }
+
+    // Flash a box on the beat, and show the tempo once there is one
+    if(cc.beatFlash)
+    {
+        cc.beatFlash--;
+        fillDisplayArea(0, 0, 8, 8, WHITE);
+    }
+    if(beat_confidence > 128)
+    {
+        char bpmStr[8];
+        ets_snprintf(bpmStr, sizeof(bpmStr), "%d", beat_bpm);
+        plotText(11, 1, bpmStr, TOM_THUMB, WHITE);
+    }
 }
 
 /**
- * Called when colorchord is exited, it disarms the timer
+ * Called when colorchord is exited, it disarms the timer and frees the
+ * rotation cache
  */
 void ICACHE_FLASH_ATTR colorchordExitMode(void)
 {
     // Disarm the timer
     syncedTimerDisarm(&cc.ccLedOverrideTimer);
+    setAudioDecimation(1);
+    setAssetRotationCache(0, 1);
 }
 
 /**
@@ -153,44 +200,94 @@ void ICACHE_FLASH_ATTR colorchordSampleHandler(int32_t samp)
     cc.samplesProcessed++;
 
     // If at least 128 samples have been processed
-    if( cc.samplesProcessed >= 128 )
+    if( cc.samplesProcessed >= SAMPLES_PER_FRAME )
+    {
+        colorchordProcessFrame();
+    }
+}
+
+/**
+ * This is called with blocks of audio samples read from the ADC
+ * This processes the samples and will display update the LEDs every
+ * 128 samples
+ *
+ * @param samples An array of audio samples read from the ADC (microphone)
+ * @param n       The number of samples in the array
+ */
+void ICACHE_FLASH_ATTR colorchordSampleBlockHandler(const int16_t* samples, uint16_t n)
+{
+    while(0 < n)
     {
-        // Don't bother if colorchord is inactive
-        if( !COLORCHORD_ACTIVE )
+        // Push samples up to the end of the current frame
+        uint16_t toPush = n;
+        if(cc.samplesProcessed < SAMPLES_PER_FRAME &&
+                toPush > SAMPLES_PER_FRAME - cc.samplesProcessed)
         {
-            return;
+            toPush = SAMPLES_PER_FRAME - cc.samplesProcessed;
         }
+        PushSamples32(samples, toPush);
+        cc.samplesProcessed += toPush;
+        samples += toPush;
+        n -= toPush;
 
-        // Colorchord magic
-        HandleFrameInfo();
-
-        // Update the LEDs as necessary
-        switch( COLORCHORD_OUTPUT_DRIVER )
+        // If at least 128 samples have been processed
+        if( cc.samplesProcessed >= SAMPLES_PER_FRAME )
         {
-            case 0:
-            {
-                UpdateLinearLEDs();
-                break;
-            }
-            case 1:
-            {
-                UpdateAllSameLEDs();
-                break;
-            }
-            default:
-            {
-                break;
-            }
-        };
+            colorchordProcessFrame();
+        }
+    }
+}
+
+/**
+ * Mark that a new frame of samples was pushed and, if colorchord is active,
+ * find the notes and update the LEDs. Other consumers, like the bar graph,
+ * pull only the stages they need
+ */
+void ICACHE_FLASH_ATTR colorchordProcessFrame(void)
+{
+    NewFrameInfo();
+
+    // Reset the sample count
+    cc.samplesProcessed = 0;
 
-        // Push out the LED data
-        if(!cc.ccOverrideLeds)
+    // Look for beats even if colorchord is inactive, the display shows them
+    if(HandleBeatFrame() & BEAT_FLAG_BEAT)
+    {
+        cc.beatFlash = BEAT_FLASH_FRAMES;
+    }
+
+    // Don't bother finding notes if colorchord is inactive
+    if( !COLORCHORD_ACTIVE )
+    {
+        return;
+    }
+
+    // Colorchord magic
+    PullFrameStage(FRAME_STAGE_NOTES);
+
+    // Update the LEDs as necessary
+    switch( COLORCHORD_OUTPUT_DRIVER )
+    {
+        case 0:
+        {
+            UpdateLinearLEDs();
+            break;
+        }
+        case 1:
         {
-            setLeds( (led_t*)ledOut, NUM_LIN_LEDS * 3 );
+            UpdateAllSameLEDs();
+            break;
         }
+        default:
+        {
+            break;
+        }
+    };
 
-        // Reset the sample count
-        cc.samplesProcessed = 0;
+    // Push out the LED data
+    if(!cc.ccOverrideLeds)
+    {
+        setLeds( (led_t*)ledOut, NUM_LIN_LEDS * 3 );
     }
 }
 
@@ -58,7 +58,8 @@ swadgeMode magpetMode =
     .wifiMode = ESP_NOW,
     .fnEspNowRecvCb = magpetEspNowRecvCb,
     .fnEspNowSendCb = magpetEspNowSendCb,
-    .fnAccelerometerCallback = NULL
+    .fnAccelerometerCallback = NULL,
+    .allowIdle = true
 };
 
 p2pInfo connection;
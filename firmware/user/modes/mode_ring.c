@@ -69,7 +69,8 @@ swadgeMode ringMode =
     .wifiMode = ESP_NOW,
     .fnEspNowRecvCb = ringEspNowRecvCb,
     .fnEspNowSendCb = ringEspNowSendCb,
-    .fnAccelerometerCallback = NULL
+    .fnAccelerometerCallback = NULL,
+    .allowIdle = true
 };
 
 ringCon_t connections[3];
@@ -0,0 +1,306 @@
+/*==============================================================================
+ * Includes
+ *============================================================================*/
+
+#include "mode_tuner.h"
+#include "DFT32.h"
+#include "embeddednf.h"
+#include "embeddedpitch.h"
+#include "oled.h"
+#include "font.h"
+#include "printControl.h"
+
+/*==============================================================================
+ * Defines
+ *============================================================================*/
+
+// Keep the same frame rate no matter how the samples are decimated
+#define SAMPLES_PER_FRAME (128 / CC_DECIMATION)
+
+// Bins quieter than this are not a note
+#define TUNER_MIN_AMP 256
+
+// Notes this many cents from true are in tune
+#define TUNER_IN_TUNE_CENTS 5
+
+// A jump bigger than this starts a new average rather than smearing two notes
+#define TUNER_MAX_JUMP (PITCH_SEMITONE / 2)
+
+#define lengthof(a) (sizeof(a) / sizeof(a[0]))
+
+/*==============================================================================
+ * Structs
+ *============================================================================*/
+
+typedef struct
+{
+    char* name;
+    uint8_t framesPerUpdate;
+} tunerResponse_t;
+
+/*==============================================================================
+ * Function Prototypes
+ *============================================================================*/
+
+void tunerEnterMode(void);
+void tunerExitMode(void);
+void tunerButtonCallback(uint8_t state, int button, int down);
+void tunerSampleBlockHandler(const int16_t* samples, uint16_t n);
+
+void tunerProcessFrame(void);
+void tunerUpdateDisplay(void* arg __attribute__((unused)));
+void tunerUpdateLeds(void);
+
+/*==============================================================================
+ * Variables
+ *============================================================================*/
+
+swadgeMode tunerMode =
+{
+    .modeName = "tuner",
+    .fnEnterMode = tunerEnterMode,
+    .fnExitMode = tunerExitMode,
+    .fnButtonCallback = tunerButtonCallback,
+    .fnAudioBlockCallback = tunerSampleBlockHandler,
+    .wifiMode = NO_WIFI,
+    .fnEspNowRecvCb = NULL,
+    .fnEspNowSendCb = NULL,
+    .fnAccelerometerCallback = NULL
+};
+
+// Averaging more frames is steadier and more precise, but slower to follow
+static const tunerResponse_t tunerResponses[] =
+{
+    {.name = "FAST",    .framesPerUpdate = 1},
+    {.name = "NORMAL",  .framesPerUpdate = 4},
+    {.name = "PRECISE", .framesPerUpdate = 16},
+};
+
+static const char* noteNames[] =
+{
+    "A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#"
+};
+
+struct
+{
+    int samplesProcessed;
+    syncedTimer_t displayTimer;
+    uint8_t response;
+
+    // The average being built, frame by frame
+    int32_t pitchSum;
+    uint8_t pitchFrames;
+    uint8_t silentFrames;
+
+    // The last finished average
+    int32_t pitch;
+} tuner;
+
+/*==============================================================================
+ * Functions
+ *============================================================================*/
+
+/**
+ * Initialize the tuner mode
+ */
+void ICACHE_FLASH_ATTR tunerEnterMode(void)
+{
+    ets_memset(&tuner, 0, sizeof(tuner));
+    tuner.response = 1;
+    tuner.pitch = PITCH_NONE;
+
+    // The tuner shares colorchord's DFT
+    InitColorChord();
+    setAudioDecimation(CC_DECIMATION);
+
+    // The display is redrawn on a timer, the notes come in much faster
+    syncedTimerSetFn(&tuner.displayTimer, tunerUpdateDisplay, NULL);
+    syncedTimerArm(&tuner.displayTimer, 25, true);
+}
+
+/**
+ * De-initialize the tuner mode
+ */
+void ICACHE_FLASH_ATTR tunerExitMode(void)
+{
+    syncedTimerDisarm(&tuner.displayTimer);
+    setAudioDecimation(1);
+}
+
+/**
+ * Tuner button press handler. Button 2 cycles how fast the tuner responds
+ *
+ * @param state  A bitmask of all button states, unused
+ * @param button The button which triggered this event
+ * @param down   true if the button was pressed, false if it was released
+ */
+void ICACHE_FLASH_ATTR tunerButtonCallback(uint8_t state __attribute__((unused)),
+        int button, int down)
+{
+    if(down && 2 == button)
+    {
+        tuner.response = (tuner.response + 1) % lengthof(tunerResponses);
+        tuner.pitchSum = 0;
+        tuner.pitchFrames = 0;
+    }
+}
+
+/**
+ * This is called with blocks of audio samples read from the ADC. The samples
+ * are pushed into the DFT, and the pitch is found every frame
+ *
+ * @param samples An array of audio samples read from the ADC (microphone)
+ * @param n       The number of samples in the array
+ */
+void ICACHE_FLASH_ATTR tunerSampleBlockHandler(const int16_t* samples, uint16_t n)
+{
+    while(0 < n)
+    {
+        // Push samples up to the end of the current frame
+        uint16_t toPush = n;
+        if(toPush > SAMPLES_PER_FRAME - tuner.samplesProcessed)
+        {
+            toPush = SAMPLES_PER_FRAME - tuner.samplesProcessed;
+        }
+        PushSamples32(samples, toPush);
+        tuner.samplesProcessed += toPush;
+        samples += toPush;
+        n -= toPush;
+
+        if( tuner.samplesProcessed >= SAMPLES_PER_FRAME )
+        {
+            tuner.samplesProcessed = 0;
+            tunerProcessFrame();
+        }
+    }
+}
+
+/**
+ * Find the pitch of this frame and add it to the average. When enough frames
+ * are averaged, publish the pitch for the display
+ */
+void ICACHE_FLASH_ATTR tunerProcessFrame(void)
+{
+    // Only the raw bins are needed, none of the note finding
+    NewFrameInfo();
+    PullFrameStage(FRAME_STAGE_BINS);
+
+    uint8_t framesPerUpdate = tunerResponses[tuner.response].framesPerUpdate;
+    int32_t pitch = FindPitch(TUNER_MIN_AMP);
+    if(PITCH_NONE == pitch)
+    {
+        // Let go of the note once it's been quiet for a whole update
+        if(++tuner.silentFrames >= framesPerUpdate)
+        {
+            tuner.silentFrames = 0;
+            tuner.pitchSum = 0;
+            tuner.pitchFrames = 0;
+            if(PITCH_NONE != tuner.pitch)
+            {
+                tuner.pitch = PITCH_NONE;
+                tunerUpdateLeds();
+            }
+        }
+        return;
+    }
+    tuner.silentFrames = 0;
+
+    // Start over if the note changed partway through the average
+    if(tuner.pitchFrames)
+    {
+        int32_t diff = pitch - (tuner.pitchSum / tuner.pitchFrames);
+        if(diff > TUNER_MAX_JUMP || diff < -TUNER_MAX_JUMP)
+        {
+            tuner.pitchSum = 0;
+            tuner.pitchFrames = 0;
+        }
+    }
+
+    tuner.pitchSum += pitch;
+    if(++tuner.pitchFrames >= framesPerUpdate)
+    {
+        tuner.pitch = tuner.pitchSum / tuner.pitchFrames;
+        tuner.pitchSum = 0;
+        tuner.pitchFrames = 0;
+        tunerUpdateLeds();
+    }
+}
+
+/**
+ * Light the LEDs green when in tune. Otherwise light the left side when flat
+ * or the right side when sharp, brighter the further off it is
+ */
+void ICACHE_FLASH_ATTR tunerUpdateLeds(void)
+{
+    led_t leds[6] = {{0}};
+
+    if(PITCH_NONE != tuner.pitch)
+    {
+        uint8_t note, octave;
+        int8_t cents;
+        PitchToNote(tuner.pitch, &note, &octave, &cents);
+
+        uint8_t i;
+        if(cents <= TUNER_IN_TUNE_CENTS && cents >= -TUNER_IN_TUNE_CENTS)
+        {
+            for(i = 0; i < lengthof(leds); i++)
+            {
+                leds[i].g = 0x40;
+            }
+        }
+        else
+        {
+            uint8_t brightness = (cents < 0 ? -cents : cents) * 5;
+            for(i = 0; i < lengthof(leds) / 2; i++)
+            {
+                leds[cents < 0 ? i : lengthof(leds) - 1 - i].r = brightness;
+            }
+        }
+    }
+    setLeds(leds, sizeof(leds));
+}
+
+/**
+ * Draw the note, how many cents off it is and a needle
+ *
+ * @param arg unused
+ */
+void ICACHE_FLASH_ATTR tunerUpdateDisplay(void* arg __attribute__((unused)))
+{
+    clearDisplay();
+
+    // The center of the needle's scale
+    fillDisplayArea(OLED_WIDTH / 2, 36, OLED_WIDTH / 2, 44, WHITE);
+    fillDisplayArea(4, 40, OLED_WIDTH - 4, 40, WHITE);
+
+    if(PITCH_NONE == tuner.pitch)
+    {
+        plotText(OLED_WIDTH / 2 - 8, 8, "--", RADIOSTARS, WHITE);
+    }
+    else
+    {
+        uint8_t note, octave;
+        int8_t cents;
+        PitchToNote(tuner.pitch, &note, &octave, &cents);
+
+        char str[16];
+        ets_snprintf(str, sizeof(str), "%s%d", noteNames[note], octave);
+        plotText(OLED_WIDTH / 2 - 16, 8, str, RADIOSTARS, WHITE);
+        ets_snprintf(str, sizeof(str), "%s%d", (cents > 0) ? "+" : "", cents);
+        plotText(OLED_WIDTH - 24, 8, str, TOM_THUMB, WHITE);
+
+        // 50 cents is the edge of the screen
+        int16_t needle = OLED_WIDTH / 2 + (cents * (OLED_WIDTH / 2 - 4)) / 50;
+        if(needle < OLED_WIDTH / 2)
+        {
+            fillDisplayArea(needle, 38, OLED_WIDTH / 2, 42, WHITE);
+        }
+        else
+        {
+            fillDisplayArea(OLED_WIDTH / 2, 38, needle, 42, WHITE);
+        }
+    }
+
+    plotText(0, OLED_HEIGHT - FONT_HEIGHT_TOMTHUMB - 1,
+             tunerResponses[tuner.response].name, TOM_THUMB, WHITE);
+}
@@ -0,0 +1,8 @@
+#ifndef _MODE_TUNER_H_
+#define _MODE_TUNER_H_
+
+#include "user_main.h"
+
+extern swadgeMode tunerMode;
+
+#endif
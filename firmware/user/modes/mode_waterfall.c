@@ -0,0 +1,228 @@
+/*==============================================================================
+ * Includes
+ *============================================================================*/
+
+#include "mode_waterfall.h"
+#include "DFT32.h"
+#include "embeddednf.h"
+#include "oled.h"
+
+/*==============================================================================
+ * Defines
+ *============================================================================*/
+
+// Keep the same frame rate no matter how the samples are decimated
+#define SAMPLES_PER_FRAME (128 / CC_DECIMATION)
+
+// How many audio frames go by between columns. At 1 the waterfall crosses
+// the display in about a second
+#define WATERFALL_FRAMES_PER_COLUMN 1
+
+// How many shades of gray per octave of amplitude. The 4x4 dither has 16
+// shades, so the brightest is four octaves above the floor
+#define WATERFALL_LOG_FRAC 2
+
+#define lengthof(a) (sizeof(a) / sizeof(a[0]))
+
+/*==============================================================================
+ * Function Prototypes
+ *============================================================================*/
+
+void waterfallEnterMode(void);
+void waterfallExitMode(void);
+void waterfallButtonCallback(uint8_t state, int button, int down);
+void waterfallSampleBlockHandler(const int16_t* samples, uint16_t n);
+
+void waterfallProcessFrame(void);
+void waterfallDrawColumn(void);
+static uint8_t waterfallLog2(uint16_t val);
+
+/*==============================================================================
+ * Variables
+ *============================================================================*/
+
+swadgeMode waterfallMode =
+{
+    .modeName = "waterfall",
+    .fnEnterMode = waterfallEnterMode,
+    .fnExitMode = waterfallExitMode,
+    .fnButtonCallback = waterfallButtonCallback,
+    .fnAudioBlockCallback = waterfallSampleBlockHandler,
+    .wifiMode = NO_WIFI,
+    .fnEspNowRecvCb = NULL,
+    .fnEspNowSendCb = NULL,
+    .fnAccelerometerCallback = NULL
+};
+
+// Bins quieter than the floor are black. Button 2 cycles through these
+static const uint16_t waterfallFloors[] = {16, 32, 64, 128, 256};
+
+// 4x4 ordered dither thresholds
+static const uint8_t bayer4[4][4] =
+{
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5},
+};
+
+struct
+{
+    int samplesProcessed;
+    uint8_t framesSinceColumn;
+    uint8_t floor;
+
+    // The column the next spectrum is written to. The display isn't scrolled,
+    // the write position sweeps across it and wraps around
+    uint8_t head;
+} waterfall;
+
+/*==============================================================================
+ * Functions
+ *============================================================================*/
+
+/**
+ * Initialize the waterfall mode
+ */
+void ICACHE_FLASH_ATTR waterfallEnterMode(void)
+{
+    ets_memset(&waterfall, 0, sizeof(waterfall));
+    waterfall.floor = 2;
+
+    // The waterfall shares colorchord's DFT
+    InitColorChord();
+    setAudioDecimation(CC_DECIMATION);
+
+    clearDisplay();
+}
+
+/**
+ * De-initialize the waterfall mode
+ */
+void ICACHE_FLASH_ATTR waterfallExitMode(void)
+{
+    setAudioDecimation(1);
+}
+
+/**
+ * Waterfall button press handler. Button 2 cycles the sensitivity
+ *
+ * @param state  A bitmask of all button states, unused
+ * @param button The button which triggered this event
+ * @param down   true if the button was pressed, false if it was released
+ */
+void ICACHE_FLASH_ATTR waterfallButtonCallback(uint8_t state __attribute__((unused)),
+        int button, int down)
+{
+    if(down && 2 == button)
+    {
+        waterfall.floor = (waterfall.floor + 1) % lengthof(waterfallFloors);
+    }
+}
+
+/**
+ * This is called with blocks of audio samples read from the ADC. The samples
+ * are pushed into the DFT, and a column is drawn every frame
+ *
+ * @param samples An array of audio samples read from the ADC (microphone)
+ * @param n       The number of samples in the array
+ */
+void ICACHE_FLASH_ATTR waterfallSampleBlockHandler(const int16_t* samples, uint16_t n)
+{
+    while(0 < n)
+    {
+        // Push samples up to the end of the current frame
+        uint16_t toPush = n;
+        if(toPush > SAMPLES_PER_FRAME - waterfall.samplesProcessed)
+        {
+            toPush = SAMPLES_PER_FRAME - waterfall.samplesProcessed;
+        }
+        PushSamples32(samples, toPush);
+        waterfall.samplesProcessed += toPush;
+        samples += toPush;
+        n -= toPush;
+
+        if( waterfall.samplesProcessed >= SAMPLES_PER_FRAME )
+        {
+            waterfall.samplesProcessed = 0;
+            waterfallProcessFrame();
+        }
+    }
+}
+
+/**
+ * Update the bins for this frame and draw them when it's time for a column
+ */
+void ICACHE_FLASH_ATTR waterfallProcessFrame(void)
+{
+    NewFrameInfo();
+
+    if(++waterfall.framesSinceColumn < WATERFALL_FRAMES_PER_COLUMN)
+    {
+        return;
+    }
+    waterfall.framesSinceColumn = 0;
+
+    // Only the raw bins are needed, none of the note finding
+    PullFrameStage(FRAME_STAGE_BINS);
+    waterfallDrawColumn();
+}
+
+/**
+ * Draw the spectrum as one column at the head, low notes at the bottom, and
+ * blank the column after it to mark where the sweep is.
+ *
+ * Only these two columns change in the framebuffer, so the difference pass in
+ * updateOLED() sends them as one column window down the pages that changed,
+ * a single data write of at most 16 bytes, rather than the whole display.
+ * The SSD1306 can only scroll horizontally on its own clock, not a column at
+ * a time, so the display is swept instead of scrolled.
+ */
+void ICACHE_FLASH_ATTR waterfallDrawColumn(void)
+{
+    uint8_t x = waterfall.head;
+    uint8_t floorLog = waterfallLog2(waterfallFloors[waterfall.floor]);
+    uint32_t rows[2] = {0, 0};
+
+    int16_t y;
+    for(y = 0; y < OLED_HEIGHT; y++)
+    {
+        uint16_t bin = ((OLED_HEIGHT - 1 - y) * FIXBINS) / OLED_HEIGHT;
+        uint8_t binLog = waterfallLog2(embeddedbins32[bin]);
+        if(binLog <= floorLog)
+        {
+            continue;
+        }
+
+        uint8_t shade = binLog - floorLog;
+        if(shade > bayer4[y & 3][x & 3])
+        {
+            rows[y / 32] |= (1u << (y & 31));
+        }
+    }
+
+    fillDisplayArea(x, 0, x, OLED_HEIGHT - 1, BLACK);
+    oledBlitColumn(x, 0, rows[0], 32, WHITE);
+    oledBlitColumn(x, 32, rows[1], 32, WHITE);
+
+    waterfall.head = (x + 1) % OLED_WIDTH;
+    fillDisplayArea(waterfall.head, 0, waterfall.head, OLED_HEIGHT - 1, BLACK);
+}
+
+/**
+ * @brief Find log2 of a value, with WATERFALL_LOG_FRAC bits of fraction
+ *
+ * @param val The value
+ * @return log2(val) in fixed point, 0 for 0
+ */
+static uint8_t ICACHE_FLASH_ATTR waterfallLog2(uint16_t val)
+{
+    uint8_t bits = 0;
+    while((val >> bits) > ((1 << (WATERFALL_LOG_FRAC + 1)) - 1))
+    {
+        bits++;
+    }
+
+    // val >> bits is now the leading bit and the fraction bits after it
+    return (bits << WATERFALL_LOG_FRAC) + (val >> bits);
+}
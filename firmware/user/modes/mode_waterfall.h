@@ -0,0 +1,8 @@
+#ifndef _MODE_WATERFALL_H_
+#define _MODE_WATERFALL_H_
+
+#include "user_main.h"
+
+extern swadgeMode waterfallMode;
+
+#endif
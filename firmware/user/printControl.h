@@ -29,6 +29,7 @@
 // #define RING_PRINTF(fmt, ...) os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 // #define PET_PRINTF(fmt, ...)  os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 // #define TIME_PRINTF(fmt, ...) os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
+// #define OLED_PRINTF(fmt, ...) os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 
 /*==============================================================================
  * These defines turn debugging off
@@ -43,5 +44,6 @@
 #define RING_PRINTF(fmt, ...)
 #define PET_PRINTF(fmt, ...)
 #define TIME_PRINTF(fmt, ...)
+#define OLED_PRINTF(fmt, ...)
 
 #endif
\ No newline at end of file
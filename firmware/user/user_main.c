@@ -37,6 +37,8 @@
 #include "mode_magpet.h"
 #include "mode_swadgepass.h"
 #include "mode_colorchord.h"
+#include "mode_tuner.h"
+#include "mode_waterfall.h"
 
 #include "ccconfig.h"
 
@@ -49,6 +51,33 @@
 
 #define RTC_MEM_ADDR 64
 
+// The most audio samples to filter and pass to a mode at once
+#define AUDIO_BLOCK_LEN 64
+
+// The CIC decimator's number of integrator and comb stages
+#define CIC_ORDER 3
+// The largest supported decimation, must be a power of two
+#define AUDIO_MAX_DECIMATION 8
+
+// Gain is 8.8 fixed point. These limits match what gINITIAL_AMP can do
+#define AGC_MIN_GAIN (1 << 4)
+#define AGC_MAX_GAIN (255 << 4)
+// Samples past this overflow the DFT's accumulators
+#define AUDIO_CLIP_LEVEL 4095
+
+// Full OLED redraws and stats happen every this many frames, about every 15s
+#define FRAMES_PER_FULL_REDRAW 1000
+
+// procTask only idles if no timer is due for at least this long
+#define IDLE_MIN_US 5000
+// An idle procTask wakes at least this often, so no idle stretch is long enough
+// for system_get_time() to wrap within it
+#define IDLE_MAX_MS 60000
+
+// A class deferred this many passes in a row runs anyway, so a mode that keeps
+// the mic's queue full can't starve the buttons or the display
+#define SCHED_MAX_DEFERRALS 8
+
 /*============================================================================
  * Structs
  *==========================================================================*/
@@ -59,6 +88,29 @@ typedef struct __attribute__((aligned(4)))
 }
 rtcMem_t;
 
+typedef struct
+{
+    uint32_t integrators[CIC_ORDER];
+    uint32_t combs[CIC_ORDER];
+    uint8_t phase;
+    uint8_t factor;
+    uint8_t shift;
+} cicDecimator_t;
+
+typedef struct
+{
+    uint32_t envelope;
+    uint16_t gain;
+    uint32_t clipCount;
+} audioAgc_t;
+
+typedef struct
+{
+    void (*fn)(uint32_t budgetUs); ///< Does the class's work, stopping near the budget
+    uint32_t budgetUs;             ///< Time the class gets per pass, 0 for no limit
+    uint16_t maxBacklog;           ///< The class is skipped while more samples than this are queued
+} schedClassDef_t;
+
 /*============================================================================
  * Variables
  *==========================================================================*/
@@ -75,6 +127,8 @@ swadgeMode* swadgeModes[] =
     &testMode,
     &magpetMode,
     &ringMode,
+    &tunerMode,
+    &waterfallMode,
 };
 
 bool swadgeModeInit = false;
@@ -83,6 +137,9 @@ rtcMem_t rtcMem = {0};
 bool QMA6981_init = false;
 uint16_t framesDrawn = 0;
 
+static cicDecimator_t decimator = {.factor = 1};
+static audioAgc_t agc = {0};
+
 /*============================================================================
  * Prototypes
  *==========================================================================*/
@@ -91,6 +148,18 @@ void ICACHE_FLASH_ATTR user_pre_init(void);
 void ICACHE_FLASH_ATTR user_init(void);
 
 static void ICACHE_FLASH_ATTR procTask(os_event_t* events);
+static void ICACHE_FLASH_ATTR runSchedClass(schedClass_t cls);
+static void ICACHE_FLASH_ATTR schedAudio(uint32_t budgetUs);
+static void ICACHE_FLASH_ATTR schedInput(uint32_t budgetUs);
+static void ICACHE_FLASH_ATTR schedTimers(uint32_t budgetUs);
+static void ICACHE_FLASH_ATTR schedDisplay(uint32_t budgetUs);
+static void ICACHE_FLASH_ATTR schedBackground(uint32_t budgetUs);
+static bool ICACHE_FLASH_ATTR tryToIdle(void);
+static void wakeTimerFunc(void* arg);
+static bool ICACHE_FLASH_ATTR modeUsesMic(const swadgeMode* mode);
+static uint16_t ICACHE_FLASH_ATTR filterAudioBlock(const uint8_t* raw, int16_t* filtered, uint16_t n);
+static void ICACHE_FLASH_ATTR updateAudioGain(uint32_t blockPeak);
+static void ICACHE_FLASH_ATTR dispatchAudioBlock(const int16_t* samples, uint16_t n);
 static void ICACHE_FLASH_ATTR pollAccel(void* arg);
 void ICACHE_FLASH_ATTR initializeAccelerometer(void);
 static void ICACHE_FLASH_ATTR returnToMenuTimerFunc(void* arg);
@@ -99,6 +168,36 @@ static void ICACHE_FLASH_ATTR returnToMenuTimerFunc(void* arg);
     void ICACHE_FLASH_ATTR incrementSwadgeMode(void);
 #endif
 
+/*============================================================================
+ * Scheduler Variables
+ *==========================================================================*/
+
+// procTask()'s work, in priority order. Audio has a 32ms queue, so lower
+// classes back off as it fills to keep audio from overrunning under UI load
+static const schedClassDef_t schedClasses[SCHED_NUM_CLASSES] =
+{
+    [SCHED_AUDIO]      = {.fn = schedAudio,      .budgetUs = 8000, .maxBacklog = HPABUFFSIZE},
+    [SCHED_INPUT]      = {.fn = schedInput,      .budgetUs = 0,    .maxBacklog = (3 * HPABUFFSIZE) / 4},
+    [SCHED_TIMERS]     = {.fn = schedTimers,     .budgetUs = 6000, .maxBacklog = HPABUFFSIZE / 2},
+    [SCHED_DISPLAY]    = {.fn = schedDisplay,    .budgetUs = 4000, .maxBacklog = HPABUFFSIZE / 4},
+    [SCHED_BACKGROUND] = {.fn = schedBackground, .budgetUs = 0,    .maxBacklog = HPABUFFSIZE / 4},
+};
+static schedClassStats_t schedStats[SCHED_NUM_CLASSES] = {{0}};
+// Passes in a row each class has been deferred, not reset with the stats
+static uint8_t schedDeferredPasses[SCHED_NUM_CLASSES] = {0};
+
+// When procTask is idle, it isn't posted again until this timer, a button
+// or an ESP NOW callback wakes it
+static os_timer_t procTaskWakeTimer = {0};
+static volatile bool procTaskIdle = false;
+// For getIdlePercent(). system_get_time() wraps every 71 minutes, so the
+// totals are 64 bit and only added to in steps shorter than that
+static bool idleCounting = false;
+static uint32_t idleSince = 0;
+static uint64_t idleUs = 0;
+static uint32_t idleStatsLast = 0;
+static uint64_t idleStatsUs = 0;
+
 /*============================================================================
  * Initialization Functions
  *==========================================================================*/
@@ -185,7 +284,7 @@ void ICACHE_FLASH_ATTR user_init(void)
     if(SWADGE_PASS != swadgeModes[rtcMem.currentSwadgeMode]->wifiMode)
     {
         // Initialize GPIOs
-        SetupGPIO(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback);
+        SetupGPIO(modeUsesMic(swadgeModes[rtcMem.currentSwadgeMode]));
 
 #ifdef PROFILE
         GPIO_OUTPUT_SET(GPIO_ID_PIN(0), 0);
@@ -228,7 +327,7 @@ void ICACHE_FLASH_ATTR user_init(void)
         framesDrawn = 0;
 
         // Initialize either the buzzer or the mic
-        if(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback)
+        if(modeUsesMic(swadgeModes[rtcMem.currentSwadgeMode]))
         {
             initMic();
         }
@@ -259,6 +358,10 @@ void ICACHE_FLASH_ATTR user_init(void)
     // Add a process to filter queued ADC samples and output LED signals
     // This is faster than every 100ms
     system_os_task(procTask, PROC_TASK_PRIO, procTaskQueue, PROC_TASK_QUEUE_LEN);
+    os_timer_disarm(&procTaskWakeTimer);
+    os_timer_setfn(&procTaskWakeTimer, wakeTimerFunc, NULL);
+    // schedDisplay() only spends its budget on I2C each pass
+    setOLEDFlushBudget(0, schedClasses[SCHED_DISPLAY].budgetUs);
     system_os_post(PROC_TASK_PRIO, 0, 0 );
 
     // Setup a software timer to return to the menu
@@ -274,76 +377,545 @@ void ICACHE_FLASH_ATTR user_init(void)
  * This task is constantly called by posting itself instead of being in an
  * infinite loop. ESP doesn't like infinite loops.
  *
- * It handles synchronous button events and audio samples which have been read
- * and are queued for processing
+ * Each pass is a small cooperative scheduler. The classes of work run in
+ * priority order, each within its time budget, and lower classes are skipped
+ * while the mic's queue is filling up
  *
  * @param events Checked before posting this task again
  */
 static void ICACHE_FLASH_ATTR procTask(os_event_t* events __attribute__((unused)))
 {
-    // Post another task to this thread
-    system_os_post(PROC_TASK_PRIO, 0, 0 );
-
     // For profiling so we can see how much CPU is spent in this loop.
 #ifdef PROFILE
     WRITE_PERI_REG( PERIPHS_GPIO_BASEADDR + GPIO_ID_PIN(0), 1 );
 #endif
 
-    // Process queued button presses synchronously
+    // Count the time since the last pass, and since this task went idle, if it did
+    uint32_t now = system_get_time();
+    idleStatsUs += now - idleStatsLast;
+    idleStatsLast = now;
+    if(idleCounting)
+    {
+        idleUs += now - idleSince;
+        idleCounting = false;
+    }
+
+    schedClass_t cls;
+    for(cls = 0; cls < SCHED_NUM_CLASSES; cls++)
+    {
+        runSchedClass(cls);
+    }
+
+    // Post another task to this thread, unless there's nothing to do for a while
+    if(false == tryToIdle())
+    {
+        system_os_post(PROC_TASK_PRIO, 0, 0 );
+    }
+
+#ifdef PROFILE
+    WRITE_PERI_REG( PERIPHS_GPIO_BASEADDR + GPIO_ID_PIN(0), 0 );
+#endif
+}
+
+/**
+ * Check if procTask can stop polling until the next synced timer is due. If
+ * it can, arm a timer to wake it then. The CPU waits for interrupts in the
+ * SDK's idle loop meanwhile.
+ *
+ * This doesn't use forced light sleep, which needs WiFi off and stops the
+ * os_timer that wakes procTask. The modes that opt in use ESP NOW anyway
+ *
+ * @return true if procTask is idle and shouldn't be posted, false otherwise
+ */
+static bool ICACHE_FLASH_ATTR tryToIdle(void)
+{
+    const swadgeMode* mode = swadgeModes[rtcMem.currentSwadgeMode];
+    if(false == swadgeModeInit || false == mode->allowIdle || modeUsesMic(mode) ||
+            isOLEDFlushInProgress())
+    {
+        return false;
+    }
+
+    uint32_t untilNextUs = syncedTimersUsUntilNextDeadline();
+    if(untilNextUs < IDLE_MIN_US)
+    {
+        return false;
+    }
+
+    // A button interrupt between checking the queue and setting the flag would
+    // be lost, so do both with interrupts off
+    bool idle = false;
+    ets_intr_lock();
+    if(false == buttonEventsQueued())
+    {
+        procTaskIdle = true;
+        idle = true;
+    }
+    ets_intr_unlock();
+    if(false == idle)
+    {
+        return false;
+    }
+
+    // Wake up for the next timer, or after IDLE_MAX_MS if that's sooner.
+    // os_timer has millisecond resolution, so round down and wake a little early
+    uint32_t untilWakeMs = IDLE_MAX_MS;
+    if(SYNCED_TIMER_NO_DEADLINE != untilNextUs && untilNextUs / 1000 < untilWakeMs)
+    {
+        untilWakeMs = untilNextUs / 1000;
+    }
+    os_timer_disarm(&procTaskWakeTimer);
+    os_timer_arm(&procTaskWakeTimer, untilWakeMs, false);
+    idleSince = system_get_time();
+    idleCounting = true;
+    return true;
+}
+
+/**
+ * Post procTask if it's idle. This is called from interrupts, so it can't be
+ * ICACHE_FLASH_ATTR
+ */
+void wakeProcTask(void)
+{
+    if(procTaskIdle)
+    {
+        procTaskIdle = false;
+        system_os_post(PROC_TASK_PRIO, 0, 0 );
+    }
+}
+
+/**
+ * Wake procTask when the next synced timer is due
+ *
+ * @param arg unused
+ */
+static void wakeTimerFunc(void* arg __attribute__((unused)))
+{
+    wakeProcTask();
+}
+
+/**
+ * @return The percentage of time procTask was idle since the scheduler stats
+ * were reset
+ */
+uint8_t ICACHE_FLASH_ATTR getIdlePercent(void)
+{
+    uint32_t now = system_get_time();
+    uint64_t totalUs = idleStatsUs + (now - idleStatsLast);
+    uint64_t currentIdleUs = idleUs;
+    if(idleCounting)
+    {
+        currentIdleUs += now - idleSince;
+    }
+    if(0 == totalUs)
+    {
+        return 0;
+    }
+    return (currentIdleUs * 100) / totalUs;
+}
+
+/**
+ * Run one class of work, unless audio is backing up, and count the time it took.
+ * A class which has been deferred SCHED_MAX_DEFERRALS passes in a row runs
+ * regardless of the backlog
+ *
+ * @param cls The class of work to run
+ */
+static void ICACHE_FLASH_ATTR runSchedClass(schedClass_t cls)
+{
+    const schedClassDef_t* def = &schedClasses[cls];
+    schedClassStats_t* stats = &schedStats[cls];
+
+    if(getSampleCount() > def->maxBacklog)
+    {
+        if(schedDeferredPasses[cls] < SCHED_MAX_DEFERRALS)
+        {
+            schedDeferredPasses[cls]++;
+            stats->deferrals++;
+            return;
+        }
+        stats->forcedRuns++;
+    }
+    schedDeferredPasses[cls] = 0;
+
+    uint32_t start = system_get_time();
+    def->fn(def->budgetUs);
+    uint32_t usedUs = system_get_time() - start;
+
+    stats->usedUs += usedUs;
+    stats->runs++;
+    if(usedUs > stats->maxUs)
+    {
+        stats->maxUs = usedUs;
+    }
+    if(0 != def->budgetUs && usedUs > def->budgetUs)
+    {
+        stats->overruns++;
+    }
+}
+
+/**
+ * While there are samples available from the ADC, filter and pass them to the
+ * mode a block at a time
+ *
+ * @param budgetUs No more blocks are started after this long
+ */
+static void ICACHE_FLASH_ATTR schedAudio(uint32_t budgetUs)
+{
+    uint32_t start = system_get_time();
+    const uint8_t* rawSamples;
+    uint16_t numSamples;
+    while(0 < (numSamples = peekSampleBlock(&rawSamples)))
+    {
+        if(numSamples > AUDIO_BLOCK_LEN)
+        {
+            numSamples = AUDIO_BLOCK_LEN;
+        }
+        int16_t samples[AUDIO_BLOCK_LEN];
+        uint16_t numFiltered = filterAudioBlock(rawSamples, samples, numSamples);
+        releaseSampleBlock(numSamples);
+        if(0 < numFiltered)
+        {
+            dispatchAudioBlock(samples, numFiltered);
+        }
+
+        if(0 != budgetUs && (system_get_time() - start) >= budgetUs)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Process a queued button press synchronously
+ *
+ * @param budgetUs unused, one event is handled per pass
+ */
+static void ICACHE_FLASH_ATTR schedInput(uint32_t budgetUs __attribute__((unused)))
+{
     HandleButtonEventSynchronous();
+}
+
+/**
+ * Process the synchronous timers which are due
+ *
+ * @param budgetUs No more timer functions are started after this long
+ */
+static void ICACHE_FLASH_ATTR schedTimers(uint32_t budgetUs)
+{
+    syncedTimersCheckBudgeted(budgetUs);
+}
 
-    // While there are samples available from the ADC
-    while( sampleAvailable() )
+/**
+ * Update the display as fast as possible. Each pass only spends the budget on
+ * I2C so samples don't pile up in the mic buffer
+ *
+ * @param budgetUs unused, the OLED's flush budget is set to it in user_init()
+ */
+static void ICACHE_FLASH_ATTR schedDisplay(uint32_t budgetUs __attribute__((unused)))
+{
+    // This only sends I2C data if there was some pixel change, or if a
+    // frame is partially sent
+    if(FRAME_DRAWN == updateOLEDBudgeted(true))
+    {
+        framesDrawn++;
+    }
+}
+
+/**
+ * Every FRAMES_PER_FULL_REDRAW frames, reset OLED params, redraw the entire
+ * OLED and print the stats gathered since the last time
+ *
+ * @param budgetUs unused, this is rare and short
+ */
+static void ICACHE_FLASH_ATTR schedBackground(uint32_t budgetUs __attribute__((unused)))
+{
+    if(FRAMES_PER_FULL_REDRAW > framesDrawn || isOLEDFlushInProgress())
+    {
+        return;
+    }
+
+    oledStats_t stats;
+    getOLEDStats(&stats);
+    OLED_PRINTF("%d frames, %d bytes, %d transfers, %d runs, max %d bytes/frame\n",
+                stats.framesSent, stats.totalBytes, stats.totalTransfers,
+                stats.totalRuns, stats.maxFrameBytes);
+    resetOLEDStats();
+    // Print which timers ran late or long over the same stretch
+    syncedTimersDumpStats();
+    syncedTimersResetStats();
+    // And how the time was split between the kinds of work
+    schedClass_t cls;
+    for(cls = 0; cls < SCHED_NUM_CLASSES; cls++)
+    {
+        TIME_PRINTF("class %d: %dus used, %dus max, %d runs, %d overruns, %d deferrals, %d forced\n",
+                    cls, schedStats[cls].usedUs, schedStats[cls].maxUs, schedStats[cls].runs,
+                    schedStats[cls].overruns, schedStats[cls].deferrals, schedStats[cls].forcedRuns);
+    }
+    TIME_PRINTF("%d%% idle\n", getIdlePercent());
+    resetSchedulerStats();
+
+    // The full redraw is budgeted like any other, and finishes over the next
+    // passes of schedDisplay()
+    setOLEDparams(false);
+    updateOLEDBudgeted(false);
+    framesDrawn = 0;
+
+    // Debug code to print time between full redraws
+    // static uint32_t lastFullDraw = 0;
+    // uint32_t time = system_get_time();
+    // if(0 != lastFullDraw)
+    // {
+    //     os_printf("rd %dus\n", time - lastFullDraw);
+    // }
+    // lastFullDraw = time;
+}
+
+/**
+ * Get how much time procTask() spent on each class of work
+ *
+ * @param stats An array of SCHED_NUM_CLASSES to copy the stats into, indexed
+ *              by schedClass_t
+ */
+void ICACHE_FLASH_ATTR getSchedulerStats(schedClassStats_t* stats)
+{
+    ets_memcpy(stats, schedStats, sizeof(schedStats));
+}
+
+/**
+ * Reset the stats returned by getSchedulerStats()
+ */
+void ICACHE_FLASH_ATTR resetSchedulerStats(void)
+{
+    ets_memset(schedStats, 0, sizeof(schedStats));
+    idleUs = 0;
+    idleStatsUs = 0;
+    idleStatsLast = system_get_time();
+    if(idleCounting)
+    {
+        idleSince = idleStatsLast;
+    }
+}
+
+/**
+ * @param mode A swadge mode
+ * @return true if the mode wants audio samples from the mic, false otherwise
+ */
+static bool ICACHE_FLASH_ATTR modeUsesMic(const swadgeMode* mode)
+{
+    return (NULL != mode->fnAudioCallback) || (NULL != mode->fnAudioBlockCallback);
+}
+
+/**
+ * Remove the DC offset from raw ADC samples, amplify them, and decimate them
+ * if setAudioDecimation() was called. The gain is either gINITIAL_AMP or set
+ * by the AGC, which is updated once per block
+ *
+ * @param raw      Raw samples from the ADC
+ * @param filtered Filtered samples are written here
+ * @param n        The number of samples to filter
+ * @return The number of filtered samples written, which is less than n when
+ *         decimating
+ */
+static uint16_t ICACHE_FLASH_ATTR filterAudioBlock(const uint8_t* raw, int16_t* filtered, uint16_t n)
+{
+    static uint32_t samp_iir = 0;
+    // gINITIAL_AMP is 4.4 fixed point, the AGC's gain is 8.8
+    if(0 == agc.gain)
+    {
+        // The AGC hasn't run yet, so start where the manual gain is
+        agc.gain = CCS.gINITIAL_AMP << 4;
+    }
+    int32_t gain = AGC_ENABLE ? agc.gain : (CCS.gINITIAL_AMP << 4);
+    uint32_t blockPeak = 0;
+    uint16_t numOut = 0;
+    uint16_t i;
+    for(i = 0; i < n; i++)
     {
-        // Get the sample
-        int32_t samp = getSample();
+        int32_t samp = raw[i];
         // Run the sample through an IIR filter
-        static uint32_t samp_iir = 0;
         samp_iir = samp_iir - (samp_iir >> 10) + samp;
         samp = (samp - (samp_iir >> 10)) * 16;
+
+        // Track the peak for the AGC
+        uint32_t mag = (samp < 0) ? -samp : samp;
+        if(mag > blockPeak)
+        {
+            blockPeak = mag;
+        }
+
         // Amplify the sample
-        samp = (samp * CCS.gINITIAL_AMP) >> 4;
+        samp = (samp * gain) >> 8;
+        if(samp > AUDIO_CLIP_LEVEL || samp < -AUDIO_CLIP_LEVEL)
+        {
+            agc.clipCount++;
+        }
 
-        // Pass the button to the mode
-        if(swadgeModeInit && NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback)
+        if(1 < decimator.factor)
         {
-            swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback(samp);
+            // The CIC integrators run at the input rate. These are unsigned
+            // because they're meant to wrap around
+            uint32_t acc = samp;
+            uint8_t stage;
+            for(stage = 0; stage < CIC_ORDER; stage++)
+            {
+                decimator.integrators[stage] += acc;
+                acc = decimator.integrators[stage];
+            }
+
+            // And the combs run at the output rate
+            decimator.phase++;
+            if(decimator.phase < decimator.factor)
+            {
+                continue;
+            }
+            decimator.phase = 0;
+            for(stage = 0; stage < CIC_ORDER; stage++)
+            {
+                uint32_t prev = decimator.combs[stage];
+                decimator.combs[stage] = acc;
+                acc -= prev;
+            }
+
+            // Remove the CIC's gain of factor^CIC_ORDER
+            samp = ((int32_t)acc) >> (CIC_ORDER * decimator.shift);
         }
-    }
 
-    // Process all the synchronous timers
-    syncedTimersCheck();
+        // Saturate it to 16 bits
+        if(samp > INT16_MAX)
+        {
+            samp = INT16_MAX;
+        }
+        else if(samp < INT16_MIN)
+        {
+            samp = INT16_MIN;
+        }
+        filtered[numOut++] = samp;
+    }
 
-    // Update the display as fast as possible.
-    if(1000 <= framesDrawn)
+    if(AGC_ENABLE)
     {
-        // Every 1000 frames, reset OLED params and redraw the entire OLED
-        // Experimentally, this is about every 15s
-        setOLEDparams(false);
-        updateOLED(false);
-        framesDrawn = 0;
+        updateAudioGain(blockPeak);
+    }
+    return numOut;
+}
 
-        // Debug code to print time between full redraws
-        // static uint32_t lastFullDraw = 0;
-        // uint32_t time = system_get_time();
-        // if(0 != lastFullDraw)
-        // {
-        //     os_printf("rd %dus\n", time - lastFullDraw);
-        // }
-        // lastFullDraw = time;
+/**
+ * Move the AGC's gain so that the loudest recent samples land at gAGC_TARGET.
+ * The envelope rises at a rate set by gAGC_ATTACK_BITS and falls at a rate
+ * set by gAGC_RELEASE_BITS
+ *
+ * @param blockPeak The largest sample magnitude in the last block, before gain
+ */
+static void ICACHE_FLASH_ATTR updateAudioGain(uint32_t blockPeak)
+{
+    // Follow the peaks
+    if(blockPeak > agc.envelope)
+    {
+        agc.envelope += (blockPeak - agc.envelope) >> AGC_ATTACK_BITS;
     }
     else
     {
-        // This only sends I2C data if there was some pixel change
-        if(FRAME_DRAWN == updateOLED(true))
+        agc.envelope -= (agc.envelope - blockPeak) >> AGC_RELEASE_BITS;
+    }
+
+    // Pick the gain which puts the envelope at the target
+    uint32_t gain = AGC_MAX_GAIN;
+    if(0 < agc.envelope)
+    {
+        gain = ((uint32_t)AGC_TARGET << 13) / agc.envelope;
+    }
+    if(gain > AGC_MAX_GAIN)
+    {
+        gain = AGC_MAX_GAIN;
+    }
+    else if(gain < AGC_MIN_GAIN)
+    {
+        gain = AGC_MIN_GAIN;
+    }
+    agc.gain = gain;
+}
+
+/**
+ * @return The gain applied to mic samples, 8.8 fixed point. This is set by
+ *         the AGC if gAGC_ENABLE is set, otherwise it's from gINITIAL_AMP
+ */
+uint16_t ICACHE_FLASH_ATTR getAudioGain(void)
+{
+    return AGC_ENABLE ? agc.gain : (CCS.gINITIAL_AMP << 4);
+}
+
+/**
+ * @return The number of amplified samples which were beyond what the DFT can
+ *         handle since the last resetAudioClipCount()
+ */
+uint32_t ICACHE_FLASH_ATTR getAudioClipCount(void)
+{
+    return agc.clipCount;
+}
+
+/**
+ * Reset the count returned by getAudioClipCount()
+ */
+void ICACHE_FLASH_ATTR resetAudioClipCount(void)
+{
+    agc.clipCount = 0;
+}
+
+/**
+ * Set how much the mic's samples are decimated before they are passed to the
+ * mode. This is done with a CIC filter, which also keeps the decimation from
+ * aliasing. The mode will get samples at DFREQ / factor
+ *
+ * @param factor The decimation, 1 for none. This is rounded down to a power of
+ *               two, up to AUDIO_MAX_DECIMATION
+ */
+void ICACHE_FLASH_ATTR setAudioDecimation(uint8_t factor)
+{
+    ets_memset(&decimator, 0, sizeof(decimator));
+    while(((1 << (decimator.shift + 1)) <= factor) &&
+            ((1 << (decimator.shift + 1)) <= AUDIO_MAX_DECIMATION))
+    {
+        decimator.shift++;
+    }
+    decimator.factor = 1 << decimator.shift;
+}
+
+/**
+ * @return The current audio decimation factor, set by setAudioDecimation()
+ */
+uint8_t ICACHE_FLASH_ATTR getAudioDecimation(void)
+{
+    return decimator.factor;
+}
+
+/**
+ * Pass a block of filtered samples to the mode, either all at once or one at
+ * a time, depending on which callback the mode has
+ *
+ * @param samples Filtered audio samples
+ * @param n       The number of samples
+ */
+static void ICACHE_FLASH_ATTR dispatchAudioBlock(const int16_t* samples, uint16_t n)
+{
+    if(false == swadgeModeInit)
+    {
+        return;
+    }
+
+    const swadgeMode* mode = swadgeModes[rtcMem.currentSwadgeMode];
+    if(NULL != mode->fnAudioBlockCallback)
+    {
+        mode->fnAudioBlockCallback(samples, n);
+    }
+    else if(NULL != mode->fnAudioCallback)
+    {
+        uint16_t i;
+        for(i = 0; i < n; i++)
         {
-            framesDrawn++;
+            mode->fnAudioCallback(samples[i]);
         }
     }
-
-#ifdef PROFILE
-    WRITE_PERI_REG( PERIPHS_GPIO_BASEADDR + GPIO_ID_PIN(0), 0 );
-#endif
 }
 
 /**
@@ -650,6 +1222,8 @@ void ICACHE_FLASH_ATTR swadgeModeEspNowRecvCb(uint8_t* mac_addr, uint8_t* data,
     {
         swadgeModes[rtcMem.currentSwadgeMode]->fnEspNowRecvCb(mac_addr, data, len, rssi);
     }
+    // The mode may have armed a timer, so make sure procTask checks
+    wakeProcTask();
 }
 
 /**
@@ -664,6 +1238,7 @@ void ICACHE_FLASH_ATTR swadgeModeEspNowSendCb(uint8_t* mac_addr, mt_tx_status st
         ENOW_PRINTF("%s::%d\n", __func__, __LINE__);
         swadgeModes[rtcMem.currentSwadgeMode]->fnEspNowSendCb(mac_addr, (mt_tx_status)status);
     }
+    wakeProcTask();
 }
 
 /*============================================================================
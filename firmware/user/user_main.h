@@ -40,6 +40,19 @@ typedef enum
     MT_TX_STATUS_FAILED,
 } mt_tx_status;
 
+/**
+ * The kinds of work procTask() does, from highest to lowest priority
+ */
+typedef enum
+{
+    SCHED_AUDIO,      ///< Filtering mic samples and passing them to the mode
+    SCHED_INPUT,      ///< Queued button events
+    SCHED_TIMERS,     ///< Synced timer functions
+    SCHED_DISPLAY,    ///< Sending the framebuffer to the OLED
+    SCHED_BACKGROUND, ///< Periodic upkeep, like full OLED redraws and stats
+    SCHED_NUM_CLASSES
+} schedClass_t;
+
 /*============================================================================
  * Structs
  *==========================================================================*/
@@ -59,6 +72,16 @@ typedef struct
     int16_t z;
 } accel_t;
 
+typedef struct
+{
+    uint32_t usedUs;     ///< Time spent in this class since the stats were reset
+    uint32_t maxUs;      ///< The longest this class ran in one pass
+    uint32_t runs;       ///< Passes this class ran in
+    uint32_t overruns;   ///< Passes this class ran past its budget
+    uint32_t deferrals;  ///< Passes this class was skipped because audio was backing up
+    uint32_t forcedRuns; ///< Passes this class ran anyway after too many deferrals in a row
+} schedClassStats_t;
+
 /**
  * A struct of all the function pointers necessary for a swadge mode. If a mode
  * does not need a particular function, say it doesn't do audio handling, it
@@ -101,6 +124,15 @@ typedef struct _swadgeMode
      * @param audoSample A 32 bit audio sample
      */
     void (*fnAudioCallback)(int32_t audoSample);
+    /**
+     * This function is called with blocks of audio samples which were read
+     * from the microphone (ADC), are filtered, and are ready for processing.
+     * If this is set, fnAudioCallback() is not called
+     *
+     * @param samples An array of filtered audio samples
+     * @param n       The number of samples in the array
+     */
+    void (*fnAudioBlockCallback)(const int16_t* samples, uint16_t n);
     /**
      * This is a setting, not a function pointer. Set it to one of these
      * values to have the system configure the swadge's WiFi
@@ -109,6 +141,13 @@ typedef struct _swadgeMode
      * SWADGE_PASS - Low power, mostly sleeping, passive connectivity
      */
     wifiMode_t wifiMode;
+    /**
+     * This is a setting, not a function pointer. Set it to true to let the
+     * system stop polling and idle the CPU while no synced timer is due soon.
+     * Only set it if the mode does all its work in synced timers and button
+     * and ESP NOW callbacks
+     */
+    bool allowIdle;
     /**
      * This function is called whenever an ESP NOW packet is received.
      *
@@ -181,6 +220,15 @@ uint8_t ICACHE_FLASH_ATTR getSwadgeModes(swadgeMode***  modePtr);
 void ICACHE_FLASH_ATTR switchToSwadgeMode(uint8_t newMode);
 
 void setAccelPollTime(uint32_t pollTimeMs);
+void ICACHE_FLASH_ATTR setAudioDecimation(uint8_t factor);
+uint8_t ICACHE_FLASH_ATTR getAudioDecimation(void);
+uint16_t ICACHE_FLASH_ATTR getAudioGain(void);
+uint32_t ICACHE_FLASH_ATTR getAudioClipCount(void);
+void ICACHE_FLASH_ATTR resetAudioClipCount(void);
+void ICACHE_FLASH_ATTR getSchedulerStats(schedClassStats_t* stats);
+void ICACHE_FLASH_ATTR resetSchedulerStats(void);
+uint8_t ICACHE_FLASH_ATTR getIdlePercent(void);
+void wakeProcTask(void);
 
 void ICACHE_FLASH_ATTR enterDeepSleep(wifiMode_t wifiMode, uint32_t timeUs);
 
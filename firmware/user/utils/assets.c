@@ -69,13 +69,211 @@ const uint32_t tan1024[] =
     -108, -90, -72, -54, -36, -18
 };
 
+#define ASSET_NAME_LEN 16
+#define ASSET_NAME_WORDS (ASSET_NAME_LEN / sizeof(uint32_t))
+// Each index item is a 16 byte name, an address and a length
+#define ASSET_INDEX_WORDS (ASSET_NAME_WORDS + 2)
+
+// Bitmaps up to this wide are drawn unrotated a column at a time
+#define BITMAP_FAST_MAX_WIDTH 64
+
+typedef enum
+{
+    CODE_WHITE,
+    CODE_BLACK,
+    CODE_CLEAR
+} pxCode_t;
+
+// Reads the bitmap's code stream: 1 is black, 00 is white, 01 is transparent
+typedef struct
+{
+    const uint32_t* data;
+    uint32_t chunk;
+    uint8_t bitIdx;
+} codeStream_t;
+
+// The parts of transformPixel() which are the same for every pixel
+typedef struct
+{
+    int16_t transX;
+    int16_t transY;
+    bool flipLR;
+    bool flipUD;
+    bool rotate;
+    int16_t quadDeg;
+    int16_t shearDeg;
+    uint32_t tanHalf;
+    uint32_t sinFull;
+    int16_t width;
+    int16_t height;
+} pxTransform_t;
+
+// A bitmap which was already transformed, allocated along with its planes. For
+// each column, then each 32 row band, there is a word of white pixels then a
+// word of black pixels
+typedef struct _rotCacheEntry_t
+{
+    struct _rotCacheEntry_t* next;
+    const uint32_t* assetPtr;
+    int16_t rotateDeg;
+    bool flipLR;
+    bool flipUD;
+    int16_t offX;
+    int16_t offY;
+    uint8_t boxW;
+    uint8_t boxH;
+    uint8_t bands;
+    uint32_t size;
+    uint32_t lastUsed;
+    uint32_t planes[];
+} rotCacheEntry_t;
+
+#ifndef ICACHE_FLASH
+// Built for a PC, the test harness builds an assets partition here
+uint32_t* hostAssetPartition = NULL;
+#endif
+
+static uint16_t* assetHashTable = NULL;
+static uint16_t assetHashTableMask = 0;
+static bool assetHashTableBuilt = false;
+
+// Rotated bitmaps, see setAssetRotationCache()
+static rotCacheEntry_t* rotCache = NULL;
+static uint32_t rotCacheBytes = 0;
+static uint32_t rotCacheMaxBytes = 0;
+static uint8_t rotCacheStepDeg = 1;
+static uint32_t rotCacheUseCnt = 0;
+
+// Gif deltas are decompressed here before being XORed into the frame. Only
+// one gif frame is decoded at a time, so every gif shares this buffer
+static uint8_t* gifDeltaBuf = NULL;
+static uint32_t gifDeltaBufSize = 0;
+static uint8_t gifDeltaBufUsers = 0;
+
 void ICACHE_FLASH_ATTR gifTimerFn(void* arg);
+static inline void markGifDirty(gifHandle* handle, uint16_t x, uint16_t y);
+void ICACHE_FLASH_ATTR markGifDelta(gifHandle* handle, uint16_t x, uint16_t y, uint8_t delta);
+void ICACHE_FLASH_ATTR drawGifFrame(gifHandle* handle);
+uint32_t ICACHE_FLASH_ATTR hashAssetName(const char* name);
+void ICACHE_FLASH_ATTR readAssetName(const uint32_t* entry, uint32_t* nameWords);
+void ICACHE_FLASH_ATTR buildAssetHashTable(void);
 void ICACHE_FLASH_ATTR transformPixel(int16_t* x, int16_t* y, int16_t transX,
                                       int16_t transY, bool flipLR, bool flipUD,
                                       int16_t rotateDeg, int16_t width, int16_t height);
+void ICACHE_FLASH_ATTR prepareTransform(pxTransform_t* t, int16_t transX,
+                                        int16_t transY, bool flipLR, bool flipUD,
+                                        int16_t rotateDeg, int16_t width, int16_t height);
+static inline void applyTransform(const pxTransform_t* t, int16_t* x, int16_t* y);
+static inline void initCodeStream(codeStream_t* cs, const uint32_t* assetPtr);
+static inline pxCode_t nextPxCode(codeStream_t* cs);
+void ICACHE_FLASH_ATTR drawBitmapUnrotated(const uint32_t* assetPtr, int16_t xp, int16_t yp,
+        bool flipLR, bool flipUD);
+void ICACHE_FLASH_ATTR evictRotCacheEntry(void);
+rotCacheEntry_t* ICACHE_FLASH_ATTR getRotCacheEntry(const uint32_t* assetPtr,
+        bool flipLR, bool flipUD, int16_t rotateDeg);
+
+/**
+ * @return A pointer to the start of the asset partition in memory mapped flash
+ */
+static inline uint32_t* ICACHE_FLASH_ATTR getAssetPartition(void)
+{
+    /* Note assets are placed immediately after irom0
+     * See "irom0_0_seg" in "eagle.app.v6.ld" for where this value comes from
+     * The makefile flashes ASSETS_FILE to 0x6C000
+     */
+#ifdef ICACHE_FLASH
+    return (uint32_t*)(0x40200000 + ASSETS_ADDR);
+#else
+    return hostAssetPartition;
+#endif
+}
+
+/**
+ * @brief Hash an asset name with 32 bit FNV-1a
+ *
+ * @param name The name to hash, at most ASSET_NAME_LEN chars are used
+ * @return The hash
+ */
+uint32_t ICACHE_FLASH_ATTR hashAssetName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    uint8_t i;
+    for(i = 0; i < ASSET_NAME_LEN && 0 != name[i]; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Read an asset's name out of the index. Flash must be read with
+ * aligned 32 bit loads, so the name is copied a word at a time
+ *
+ * @param entry     A pointer to the index entry
+ * @param nameWords ASSET_NAME_WORDS + 1 words to copy the name into. The last
+ *                  word is zeroed so the name is always terminated
+ */
+void ICACHE_FLASH_ATTR readAssetName(const uint32_t* entry, uint32_t* nameWords)
+{
+    uint8_t i;
+    for(i = 0; i < ASSET_NAME_WORDS; i++)
+    {
+        nameWords[i] = entry[i];
+    }
+    nameWords[ASSET_NAME_WORDS] = 0;
+}
+
+/**
+ * @brief Build a hash table of the asset index in RAM. This is done once, the
+ * first time an asset is looked up. Empty slots are 0, otherwise a slot holds
+ * the index item's position plus one. Collisions are resolved with linear
+ * probing
+ */
+void ICACHE_FLASH_ATTR buildAssetHashTable(void)
+{
+    uint32_t* assets = getAssetPartition();
+    uint32_t numIndexItems = assets[0];
+
+    // Keep the table at most half full so probe chains stay short
+    uint16_t size = 8;
+    while(size < 2 * numIndexItems && size < 0x8000)
+    {
+        size <<= 1;
+    }
+    if(numIndexItems >= size)
+    {
+        // Too many items, getAsset() will fall back to scanning
+        return;
+    }
+
+    assetHashTable = (uint16_t*)os_zalloc(size * sizeof(uint16_t));
+    if(NULL == assetHashTable)
+    {
+        return;
+    }
+    assetHashTableMask = size - 1;
+
+    for(uint32_t ni = 0; ni < numIndexItems; ni++)
+    {
+        uint32_t nameWords[ASSET_NAME_WORDS + 1];
+        readAssetName(&assets[1 + (ni * ASSET_INDEX_WORDS)], nameWords);
+        const char* assetName = (const char*)nameWords;
+
+        uint16_t slot = hashAssetName(assetName) & assetHashTableMask;
+        while(0 != assetHashTable[slot])
+        {
+            slot = (slot + 1) & assetHashTableMask;
+        }
+        assetHashTable[slot] = ni + 1;
+    }
+    AST_PRINTF("Hashed %d items into %d slots\n", numIndexItems, size);
+}
 
 /**
- * @brief Get a pointer to an asset
+ * @brief Get a pointer to an asset. The first lookup builds a hash table of
+ * the asset index, after that each lookup only compares the names which
+ * hash to the same slot
  *
  * @param name   The name of the asset to fetch
  * @param retLen A pointer to a uint32_t where the asset length will be written
@@ -83,32 +281,55 @@ void ICACHE_FLASH_ATTR transformPixel(int16_t* x, int16_t* y, int16_t transX,
  */
 uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
 {
-    /* Note assets are placed immediately after irom0
-     * See "irom0_0_seg" in "eagle.app.v6.ld" for where this value comes from
-     * The makefile flashes ASSETS_FILE to 0x6C000
-     */
-    uint32_t* assets = (uint32_t*)(0x40200000 + ASSETS_ADDR);
-    uint32_t idx = 0;
-    uint32_t numIndexItems = assets[idx++];
-    AST_PRINTF("Scanning %d items\n", numIndexItems);
+    uint32_t* assets = getAssetPartition();
+    uint32_t numIndexItems = assets[0];
 
+    if(false == assetHashTableBuilt)
+    {
+        buildAssetHashTable();
+        assetHashTableBuilt = true;
+    }
+
+    if(NULL != assetHashTable)
+    {
+        uint16_t slot = hashAssetName(name) & assetHashTableMask;
+        while(0 != assetHashTable[slot])
+        {
+            uint32_t* entry = &assets[1 + ((assetHashTable[slot] - 1) * ASSET_INDEX_WORDS)];
+            uint32_t nameWords[ASSET_NAME_WORDS + 1];
+            readAssetName(entry, nameWords);
+            const char* assetName = (const char*)nameWords;
+            if(0 == ets_strncmp(name, assetName, ASSET_NAME_LEN))
+            {
+                AST_PRINTF("Found asset %s\n", assetName);
+                *retLen = entry[5];
+                return &assets[entry[4] / sizeof(uint32_t)];
+            }
+            slot = (slot + 1) & assetHashTableMask;
+        }
+        *retLen = 0;
+        return NULL;
+    }
+
+    // No hash table, scan the index
+    AST_PRINTF("Scanning %d items\n", numIndexItems);
     for(uint32_t ni = 0; ni < numIndexItems; ni++)
     {
-        // Read the name from the index
-        char assetName[16] = {0};
-        ets_memcpy(assetName, &assets[idx], sizeof(uint32_t) * 4);
-        idx += 4;
+        uint32_t* entry = &assets[1 + (ni * ASSET_INDEX_WORDS)];
 
-        // Read the address from the index
-        uint32_t assetAddress = assets[idx++];
+        // Read the name from the index
+        uint32_t nameWords[ASSET_NAME_WORDS + 1];
+        readAssetName(entry, nameWords);
+        const char* assetName = (const char*)nameWords;
 
-        // Read the length from the index
-        uint32_t assetLen = assets[idx++];
+        // Read the address and length from the index
+        uint32_t assetAddress = entry[4];
+        uint32_t assetLen = entry[5];
 
         AST_PRINTF("%s, addr: %d, len: %d\n", assetName, assetAddress, assetLen);
 
         // Compare names
-        if(0 == ets_strcmp(name, assetName))
+        if(0 == ets_strncmp(name, assetName, ASSET_NAME_LEN))
         {
             AST_PRINTF("Found asset\n");
             *retLen = assetLen;
@@ -119,6 +340,20 @@ uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
     return NULL;
 }
 
+/**
+ * @brief Look up an asset once so it can be drawn many times without looking
+ * up its name again
+ *
+ * @param name   The name of the asset to fetch
+ * @param handle The handle to fill in
+ * @return true if the asset was found, false otherwise
+ */
+bool ICACHE_FLASH_ATTR getAssetHandle(const char* name, assetHandle_t* handle)
+{
+    handle->assetPtr = getAsset(name, &handle->len);
+    return (NULL != handle->assetPtr);
+}
+
 /**
  * Transform a pixel's coordinates by rotation around the sprite's center point,
  * then reflection over Y axis, then reflection over X axis, then translation
@@ -136,9 +371,64 @@ uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
 void ICACHE_FLASH_ATTR transformPixel(int16_t* x, int16_t* y, int16_t transX,
                                       int16_t transY, bool flipLR, bool flipUD,
                                       int16_t rotateDeg, int16_t width, int16_t height)
+{
+    pxTransform_t t;
+    prepareTransform(&t, transX, transY, flipLR, flipUD, rotateDeg, width, height);
+    applyTransform(&t, x, y);
+}
+
+/**
+ * Do the per-image work of transformPixel() once, so it isn't repeated for
+ * every pixel. The parameters are the same as transformPixel()
+ *
+ * @param t The transform to fill in
+ * @param transX The number of pixels to translate X by
+ * @param transY The number of pixels to translate Y by
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
+ * @param width  The width of the image
+ * @param height The height of the image
+ */
+void ICACHE_FLASH_ATTR prepareTransform(pxTransform_t* t, int16_t transX,
+                                        int16_t transY, bool flipLR, bool flipUD,
+                                        int16_t rotateDeg, int16_t width, int16_t height)
+{
+    t->transX = transX;
+    t->transY = transY;
+    t->flipLR = flipLR;
+    t->flipUD = flipUD;
+    t->width = width;
+    t->height = height;
+    t->rotate = (0 < rotateDeg && rotateDeg < 360);
+    if(t->rotate)
+    {
+        // Rotate by a multiple of 90 degrees first, then the rest with shears
+        t->quadDeg = rotateDeg - (rotateDeg % 90);
+        t->shearDeg = rotateDeg % 90;
+        t->tanHalf = tan1024[t->shearDeg / 2];
+        t->sinFull = sin1024[t->shearDeg];
+    }
+    else
+    {
+        t->quadDeg = 0;
+        t->shearDeg = 0;
+        t->tanHalf = 0;
+        t->sinFull = 0;
+    }
+}
+
+/**
+ * Transform a pixel's coordinates with a prepared transform
+ *
+ * @param t The transform from prepareTransform()
+ * @param x The x coordinate of the pixel location to transform
+ * @param y The y coordinate of the pixel location to trasform
+ */
+static inline void applyTransform(const pxTransform_t* t, int16_t* x, int16_t* y)
 {
     // First rotate the sprite around the sprite's center point
-    if (0 < rotateDeg && rotateDeg < 360)
+    if (t->rotate)
     {
         // This solves the aliasing problem, but because of tan() it's only safe
         // to rotate by 0 to 90 degrees. So rotate by a multiple of 90 degrees
@@ -147,66 +437,106 @@ void ICACHE_FLASH_ATTR transformPixel(int16_t* x, int16_t* y, int16_t transX,
         // See https://graphicsinterface.org/wp-content/uploads/gi1986-15.pdf
 
         // Center around (0, 0)
-        (*x) -= (width / 2);
-        (*y) -= (height / 2);
+        (*x) -= (t->width / 2);
+        (*y) -= (t->height / 2);
 
         // First rotate to the nearest 90 degree boundary, which is trivial
-        if(rotateDeg >= 270)
+        if(t->quadDeg >= 270)
         {
             // (x, y) -> (y, -x)
             int16_t tmp = (*x);
             (*x) = (*y);
             (*y) = -tmp;
         }
-        else if(rotateDeg >= 180)
+        else if(t->quadDeg >= 180)
         {
             // (x, y) -> (-x, -y)
             (*x) = -(*x);
             (*y) = -(*y);
         }
-        else if(rotateDeg >= 90)
+        else if(t->quadDeg >= 90)
         {
             // (x, y) -> (-y, x)
             int16_t tmp = (*x);
             (*x) = -(*y);
             (*y) = tmp;
         }
-        // Now that it's rotated to a 90 degree boundary, find out how much more
-        // there is to rotate by shearing
-        rotateDeg = rotateDeg % 90;
 
         // If there's any more to rotate, apply three shear matrices in order
-        // if(rotateDeg > 1 && rotateDeg < 89)
-        if(rotateDeg > 0)
+        if(t->shearDeg > 0)
         {
             // 1st shear
-            (*x) = (*x) - (((*y) * tan1024[rotateDeg / 2]) + 512) / 1024;
+            (*x) = (*x) - (((*y) * t->tanHalf) + 512) / 1024;
             // 2nd shear
-            (*y) = (((*x) * sin1024[rotateDeg]) + 512) / 1024 + (*y);
+            (*y) = (((*x) * t->sinFull) + 512) / 1024 + (*y);
             // 3rd shear
-            (*x) = (*x) - (((*y) * tan1024[rotateDeg / 2]) + 512) / 1024;
+            (*x) = (*x) - (((*y) * t->tanHalf) + 512) / 1024;
         }
 
         // Return pixel to original position
-        (*x) = (*x) + (width / 2);
-        (*y) = (*y) + (height / 2);
+        (*x) = (*x) + (t->width / 2);
+        (*y) = (*y) + (t->height / 2);
     }
 
     // Then reflect over Y axis
-    if (flipLR)
+    if (t->flipLR)
     {
-        (*x) = width - 1 - (*x);
+        (*x) = t->width - 1 - (*x);
     }
 
     // Then reflect over X axis
-    if(flipUD)
+    if(t->flipUD)
     {
-        (*y) = height - 1 - (*y);
+        (*y) = t->height - 1 - (*y);
     }
 
     // Then translate
-    (*x) += transX;
-    (*y) += transY;
+    (*x) += t->transX;
+    (*y) += t->transY;
+}
+
+/**
+ * @brief Start reading a bitmap's code stream, which follows the width and
+ * height
+ *
+ * @param cs The stream to initialize
+ * @param assetPtr The bitmap asset
+ */
+static inline void initCodeStream(codeStream_t* cs, const uint32_t* assetPtr)
+{
+    cs->data = &assetPtr[2];
+    cs->chunk = *(cs->data++);
+    cs->bitIdx = 0;
+}
+
+/**
+ * @brief 'Traverse' the huffman tree to find out what to do with the next
+ * pixel. A one is black, a zero can be followed by a zero (white) or a one
+ * (transparent)
+ *
+ * @param cs The code stream to read from
+ * @return CODE_WHITE, CODE_BLACK or CODE_CLEAR
+ */
+static inline pxCode_t nextPxCode(codeStream_t* cs)
+{
+    bool isOne = (cs->chunk & (0x80000000 >> (cs->bitIdx++)));
+    if(cs->bitIdx == 32)
+    {
+        cs->chunk = *(cs->data++);
+        cs->bitIdx = 0;
+    }
+    if(isOne)
+    {
+        return CODE_BLACK;
+    }
+
+    isOne = (cs->chunk & (0x80000000 >> (cs->bitIdx++)));
+    if(cs->bitIdx == 32)
+    {
+        cs->chunk = *(cs->data++);
+        cs->bitIdx = 0;
+    }
+    return isOne ? CODE_CLEAR : CODE_WHITE;
 }
 
 /**
@@ -223,75 +553,354 @@ void ICACHE_FLASH_ATTR drawBitmapFromAsset(const char* name, int16_t xp, int16_t
         bool flipLR, bool flipUD, int16_t rotateDeg)
 {
     // Get the image from the packed assets
-    uint32_t assetLen = 0;
-    uint32_t* assetPtr = getAsset(name, &assetLen);
+    assetHandle_t handle;
+    if(getAssetHandle(name, &handle))
+    {
+        drawBitmapFromHandle(&handle, xp, yp, flipLR, flipUD, rotateDeg);
+    }
+}
 
-    if(NULL != assetPtr)
+/**
+ * @brief Draw a bitmap asset to the OLED, from a handle which was already
+ * looked up with getAssetHandle()
+ *
+ * Unrotated bitmaps are decoded a band of columns at a time and blitted.
+ * Rotated bitmaps are drawn from the rotation cache if it's enabled, otherwise
+ * every pixel is transformed
+ *
+ * @param handle The handle of the asset to draw
+ * @param xp The x coordinate to draw the asset at
+ * @param yp The y coordinate to draw the asset at
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
+ */
+void ICACHE_FLASH_ATTR drawBitmapFromHandle(const assetHandle_t* handle, int16_t xp, int16_t yp,
+        bool flipLR, bool flipUD, int16_t rotateDeg)
+{
+    const uint32_t* assetPtr = handle->assetPtr;
+    if(NULL == assetPtr)
     {
-        uint32_t idx = 0;
+        return;
+    }
 
-        // Get the width and height
-        int32_t width = assetPtr[idx++];
-        int32_t height = assetPtr[idx++];
-        AST_PRINTF("Width: %d, height: %d\n", width, height);
+    // Get the width and height
+    int32_t width = assetPtr[0];
+    int32_t height = assetPtr[1];
+    AST_PRINTF("Width: %d, height: %d\n", width, height);
 
-        // Read 32 bits at a time
-        uint32_t chunk = assetPtr[idx++];
-        uint32_t bitIdx = 0;
+    // With the cache on, angles are rounded to its step so they can be reused
+    if(0 != rotCacheMaxBytes && 0 < rotateDeg && rotateDeg < 360)
+    {
+        rotateDeg = (((rotateDeg + (rotCacheStepDeg / 2)) / rotCacheStepDeg) * rotCacheStepDeg) % 360;
+    }
 
-        // Draw the image's pixels
-        for(int16_t h = 0; h < height; h++)
+    bool rotated = (0 < rotateDeg && rotateDeg < 360);
+    if(false == rotated && width <= BITMAP_FAST_MAX_WIDTH)
+    {
+        drawBitmapUnrotated(assetPtr, xp, yp, flipLR, flipUD);
+        return;
+    }
+
+    if(rotated && 0 != rotCacheMaxBytes)
+    {
+        rotCacheEntry_t* entry = getRotCacheEntry(assetPtr, flipLR, flipUD, rotateDeg);
+        if(NULL != entry)
         {
-            for(int16_t w = 0; w < width; w++)
+            // Blit the pre-transformed bitmap
+            const uint32_t* planes = entry->planes;
+            uint8_t col, band;
+            for(col = 0; col < entry->boxW; col++)
+            {
+                int16_t x = xp + entry->offX + col;
+                for(band = 0; band < entry->bands; band++, planes += 2)
+                {
+                    int16_t y = yp + entry->offY + (band * 32);
+                    uint8_t n = (entry->boxH - (band * 32)) < 32 ? (entry->boxH - (band * 32)) : 32;
+                    if(0 != planes[0])
+                    {
+                        oledBlitColumn(x, y, planes[0], n, WHITE);
+                    }
+                    if(0 != planes[1])
+                    {
+                        oledBlitColumn(x, y, planes[1], n, BLACK);
+                    }
+                }
+            }
+            return;
+        }
+    }
+
+    pxTransform_t t;
+    prepareTransform(&t, xp, yp, flipLR, flipUD, rotateDeg, width, height);
+    codeStream_t cs;
+    initCodeStream(&cs, assetPtr);
+
+    // Draw the image's pixels
+    for(int16_t h = 0; h < height; h++)
+    {
+        for(int16_t w = 0; w < width; w++)
+        {
+            pxCode_t code = nextPxCode(&cs);
+            if(CODE_CLEAR != code)
             {
                 // Transform this pixel's draw location as necessary
                 int16_t x = w;
                 int16_t y = h;
-                transformPixel(&x, &y, xp, yp, flipLR, flipUD, rotateDeg, width, height);
+                applyTransform(&t, &x, &y);
+                drawPixel(x, y, (CODE_BLACK == code) ? BLACK : WHITE);
+            }
+        }
+    }
+}
 
-                // 'Traverse' the huffman tree to find out what to do
-                bool isZero = true;
-                if(chunk & (0x80000000 >> (bitIdx++)))
-                {
-                    // If it's a one, draw a black pixel
-                    drawPixel(x, y, BLACK);
-                    isZero = false;
-                }
+/**
+ * @brief Draw an unrotated bitmap. Up to 32 rows are decoded into white and
+ * black bits for each column, then each column is blitted
+ *
+ * @param assetPtr The bitmap asset, at most BITMAP_FAST_MAX_WIDTH wide
+ * @param xp The x coordinate to draw the asset at
+ * @param yp The y coordinate to draw the asset at
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ */
+void ICACHE_FLASH_ATTR drawBitmapUnrotated(const uint32_t* assetPtr, int16_t xp, int16_t yp,
+        bool flipLR, bool flipUD)
+{
+    int16_t width = assetPtr[0];
+    int16_t height = assetPtr[1];
+    uint32_t whiteCols[BITMAP_FAST_MAX_WIDTH];
+    uint32_t blackCols[BITMAP_FAST_MAX_WIDTH];
 
-                // After bitIdx was incremented, check it
-                if(bitIdx == 32)
-                {
-                    chunk = assetPtr[idx++];
-                    bitIdx = 0;
-                }
+    codeStream_t cs;
+    initCodeStream(&cs, assetPtr);
+
+    int16_t band;
+    for(band = 0; band < height; band += 32)
+    {
+        uint8_t n = (height - band) < 32 ? (height - band) : 32;
+        ets_memset(whiteCols, 0, sizeof(uint32_t) * width);
+        ets_memset(blackCols, 0, sizeof(uint32_t) * width);
 
-                // A zero can be followed by a zero or a one
-                if(isZero)
+        // Decode this band of rows into the columns
+        uint8_t i;
+        int16_t w;
+        for(i = 0; i < n; i++)
+        {
+            // Flipping upside down reverses the rows of the band
+            uint32_t bit = (1u << (flipUD ? (n - 1 - i) : i));
+            for(w = 0; w < width; w++)
+            {
+                switch(nextPxCode(&cs))
                 {
-                    if(chunk & (0x80000000 >> (bitIdx++)))
+                    case CODE_WHITE:
                     {
-                        // zero-one means transparent, so don't do anything
+                        whiteCols[w] |= bit;
+                        break;
                     }
-                    else
+                    case CODE_BLACK:
                     {
-                        // zero-zero means white, draw a pixel
-                        drawPixel(x, y, WHITE);
+                        blackCols[w] |= bit;
+                        break;
                     }
-
-                    // After bitIdx was incremented, check it
-                    if(bitIdx == 32)
+                    case CODE_CLEAR:
+                    default:
                     {
-                        chunk = assetPtr[idx++];
-                        bitIdx = 0;
+                        break;
                     }
                 }
             }
         }
+
+        // Then blit the columns
+        int16_t y = flipUD ? (yp + height - band - n) : (yp + band);
+        for(w = 0; w < width; w++)
+        {
+            int16_t x = flipLR ? (xp + width - 1 - w) : (xp + w);
+            oledBlitColumn(x, y, whiteCols[w], n, WHITE);
+            oledBlitColumn(x, y, blackCols[w], n, BLACK);
+        }
+    }
+}
+
+/**
+ * @brief Set how much RAM may be used to cache rotated bitmaps. A cached
+ * bitmap is drawn with a blit instead of transforming every pixel. Bitmaps are
+ * cached as they're drawn, and the least recently used are evicted when the
+ * cache is full. The cache is off by default.
+ *
+ * While it's on, rotations are rounded to a multiple of angleStepDeg so a
+ * spinning bitmap only has 360 / angleStepDeg angles to cache. The cache
+ * should have room for all of them, or the bitmap is transformed again every
+ * time it comes around
+ *
+ * @param maxBytes     The most bytes to use, 0 to turn off and empty the cache
+ * @param angleStepDeg Rotations are rounded to a multiple of this, 1 to 90
+ */
+void ICACHE_FLASH_ATTR setAssetRotationCache(uint32_t maxBytes, uint8_t angleStepDeg)
+{
+    rotCacheMaxBytes = maxBytes;
+    rotCacheStepDeg = (0 == angleStepDeg) ? 1 : angleStepDeg;
+
+    // Cached bitmaps were rounded to the old step, so start over
+    while(NULL != rotCache)
+    {
+        evictRotCacheEntry();
+    }
+}
+
+/**
+ * @return The bytes of RAM the rotation cache is using
+ */
+uint32_t ICACHE_FLASH_ATTR getAssetRotationCacheBytes(void)
+{
+    return rotCacheBytes;
+}
+
+/**
+ * @brief Free the least recently used bitmap in the rotation cache
+ */
+void ICACHE_FLASH_ATTR evictRotCacheEntry(void)
+{
+    rotCacheEntry_t** lru = &rotCache;
+    rotCacheEntry_t** link;
+    for(link = &rotCache; NULL != *link; link = &(*link)->next)
+    {
+        if((*link)->lastUsed < (*lru)->lastUsed)
+        {
+            lru = link;
+        }
+    }
+
+    rotCacheEntry_t* entry = *lru;
+    *lru = entry->next;
+    rotCacheBytes -= entry->size;
+    os_free(entry);
+}
+
+/**
+ * @brief Find a transformed bitmap in the rotation cache, or transform and
+ * add it
+ *
+ * @param assetPtr The bitmap asset
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 1-359
+ * @return The cache entry, or NULL if it couldn't be cached
+ */
+rotCacheEntry_t* ICACHE_FLASH_ATTR getRotCacheEntry(const uint32_t* assetPtr,
+        bool flipLR, bool flipUD, int16_t rotateDeg)
+{
+    rotCacheUseCnt++;
+
+    // Look for it first
+    rotCacheEntry_t* entry;
+    for(entry = rotCache; NULL != entry; entry = entry->next)
+    {
+        if(assetPtr == entry->assetPtr && rotateDeg == entry->rotateDeg &&
+                flipLR == entry->flipLR && flipUD == entry->flipUD)
+        {
+            entry->lastUsed = rotCacheUseCnt;
+            return entry;
+        }
+    }
+
+    // Find the bounding box of the transformed bitmap
+    int16_t width = assetPtr[0];
+    int16_t height = assetPtr[1];
+    pxTransform_t t;
+    prepareTransform(&t, 0, 0, flipLR, flipUD, rotateDeg, width, height);
+    int16_t minX = INT16_MAX, minY = INT16_MAX, maxX = INT16_MIN, maxY = INT16_MIN;
+    int16_t w, h;
+    for(h = 0; h < height; h++)
+    {
+        for(w = 0; w < width; w++)
+        {
+            int16_t x = w;
+            int16_t y = h;
+            applyTransform(&t, &x, &y);
+            minX = (x < minX) ? x : minX;
+            maxX = (x > maxX) ? x : maxX;
+            minY = (y < minY) ? y : minY;
+            maxY = (y > maxY) ? y : maxY;
+        }
+    }
+    int16_t boxW = maxX - minX + 1;
+    int16_t boxH = maxY - minY + 1;
+    if(boxW <= 0 || boxH <= 0 || boxW > UINT8_MAX || boxH > UINT8_MAX)
+    {
+        return NULL;
+    }
+    uint8_t bands = (boxH + 31) / 32;
+    uint32_t size = sizeof(rotCacheEntry_t) + (boxW * bands * 2 * sizeof(uint32_t));
+    if(size > rotCacheMaxBytes)
+    {
+        return NULL;
+    }
+
+    // Make room, evicting the least recently used bitmaps
+    while(rotCacheBytes + size > rotCacheMaxBytes)
+    {
+        evictRotCacheEntry();
+    }
+    entry = (rotCacheEntry_t*)os_zalloc(size);
+    if(NULL == entry)
+    {
+        return NULL;
+    }
+    entry->assetPtr = assetPtr;
+    entry->rotateDeg = rotateDeg;
+    entry->flipLR = flipLR;
+    entry->flipUD = flipUD;
+    entry->offX = minX;
+    entry->offY = minY;
+    entry->boxW = boxW;
+    entry->boxH = boxH;
+    entry->bands = bands;
+    entry->size = size;
+    entry->lastUsed = rotCacheUseCnt;
+    entry->next = rotCache;
+    rotCache = entry;
+    rotCacheBytes += size;
+
+    // Transform the bitmap into the box
+    codeStream_t cs;
+    initCodeStream(&cs, assetPtr);
+    for(h = 0; h < height; h++)
+    {
+        for(w = 0; w < width; w++)
+        {
+            pxCode_t code = nextPxCode(&cs);
+            if(CODE_CLEAR != code)
+            {
+                int16_t x = w;
+                int16_t y = h;
+                applyTransform(&t, &x, &y);
+                x -= minX;
+                y -= minY;
+                uint32_t* planes = &entry->planes[((x * bands) + (y / 32)) * 2];
+                uint32_t bit = (1u << (y % 32));
+                // A later pixel at the same spot wins, like drawing would
+                if(CODE_WHITE == code)
+                {
+                    planes[0] |= bit;
+                    planes[1] &= ~bit;
+                }
+                else
+                {
+                    planes[0] &= ~bit;
+                    planes[1] |= bit;
+                }
+            }
+        }
     }
+    return entry;
 }
 
 /**
- * @brief Start drawing a gif from an asset
+ * @brief Start drawing a gif from an asset. If there isn't enough memory,
+ * nothing is started and the handle stays uninitialized, so it may be tried
+ * again later
  *
  * @param name The name of the asset to draw
  * @param xp The x coordinate to draw the asset at
@@ -306,7 +915,7 @@ void ICACHE_FLASH_ATTR drawGifFromAsset(const char* name, int16_t xp, int16_t yp
                                         gifHandle* handle)
 {
     // Only do anything if the handle is uninitialized
-    if(NULL == handle->compressed)
+    if(NULL == handle->frame)
     {
         // Get the image from the packed assets
         uint32_t assetLen = 0;
@@ -333,12 +942,38 @@ void ICACHE_FLASH_ATTR drawGifFromAsset(const char* name, int16_t xp, int16_t yp
                      handle->nFrames,
                      handle->duration);
 
-            // Allocate enough space for the compressed data, decompressed data
-            // and the actual gif
+            // Allocate enough space for the actual gif. Compressed data is
+            // read straight from flash
             handle->allocedSize = ((handle->width * handle->height) + 8) / 8;
-            handle->compressed = (uint8_t*)os_malloc(handle->allocedSize);
-            handle->decompressed = (uint8_t*)os_malloc(handle->allocedSize);
-            handle->frame = (uint8_t*)os_malloc(handle->allocedSize);
+            uint8_t* frame = (uint8_t*)os_malloc(handle->allocedSize);
+            if(NULL == frame)
+            {
+                AST_PRINTF("%s: no memory for the frame\n", __func__);
+                return;
+            }
+
+            // Make sure the shared delta buffer is big enough for this gif.
+            // The old buffer is only freed once the new one is allocated,
+            // other gifs may still be using it
+            if(gifDeltaBufSize < handle->allocedSize)
+            {
+                uint8_t* deltaBuf = (uint8_t*)os_malloc(handle->allocedSize);
+                if(NULL == deltaBuf)
+                {
+                    AST_PRINTF("%s: no memory for the delta buffer\n", __func__);
+                    os_free(frame);
+                    return;
+                }
+                os_free(gifDeltaBuf);
+                gifDeltaBuf = deltaBuf;
+                gifDeltaBufSize = handle->allocedSize;
+            }
+            handle->frame = frame;
+            gifDeltaBufUsers++;
+
+            // Nothing has been drawn yet
+            handle->dirtyMinX = 1;
+            handle->dirtyMaxX = 0;
 
             // Set up a timer to draw the other frames of the gif
             syncedTimerSetFn(&handle->timer, gifTimerFn, handle);
@@ -355,16 +990,111 @@ void ICACHE_FLASH_ATTR drawGifFromAsset(const char* name, int16_t xp, int16_t yp
 void ICACHE_FLASH_ATTR freeGifMemory(gifHandle* handle)
 {
     syncedTimerDisarm(&handle->timer);
-    os_free(handle->compressed);
-    os_free(handle->decompressed);
-    os_free(handle->frame);
-    handle->compressed = NULL;
-    handle->decompressed = NULL;
-    handle->frame = NULL;
+    if(NULL != handle->frame)
+    {
+        os_free(handle->frame);
+        handle->frame = NULL;
+
+        // Free the shared delta buffer when the last gif is done with it
+        gifDeltaBufUsers--;
+        if(0 == gifDeltaBufUsers)
+        {
+            os_free(gifDeltaBuf);
+            gifDeltaBuf = NULL;
+            gifDeltaBufSize = 0;
+        }
+    }
 }
 
 /**
- * @brief Timer function to draw gifs
+ * @brief Grow a gif's dirty box to include a pixel
+ *
+ * @param handle The gif state
+ * @param x The x coordinate of the pixel, in the gif
+ * @param y The y coordinate of the pixel, in the gif
+ */
+static inline void markGifDirty(gifHandle* handle, uint16_t x, uint16_t y)
+{
+    if(handle->dirtyMinX > handle->dirtyMaxX)
+    {
+        // The box was empty
+        handle->dirtyMinX = handle->dirtyMaxX = x;
+        handle->dirtyMinY = handle->dirtyMaxY = y;
+        return;
+    }
+    if(x < handle->dirtyMinX)
+    {
+        handle->dirtyMinX = x;
+    }
+    if(x > handle->dirtyMaxX)
+    {
+        handle->dirtyMaxX = x;
+    }
+    if(y < handle->dirtyMinY)
+    {
+        handle->dirtyMinY = y;
+    }
+    if(y > handle->dirtyMaxY)
+    {
+        handle->dirtyMaxY = y;
+    }
+}
+
+/**
+ * @brief Grow a gif's dirty box to include every pixel changed by a delta byte.
+ * The caller tracks where each byte starts, so there's no divide per pixel
+ *
+ * @param handle The gif state
+ * @param x The x coordinate of the byte's first pixel, in the gif
+ * @param y The y coordinate of the byte's first pixel, in the gif
+ * @param delta The nonzero delta which was XORed into that byte
+ */
+void ICACHE_FLASH_ATTR markGifDelta(gifHandle* handle, uint16_t x, uint16_t y, uint8_t delta)
+{
+    // The first and last changed pixels, most significant bit first
+    uint8_t first = 0;
+    while(0 == (delta & (0x80 >> first)))
+    {
+        first++;
+    }
+    uint8_t last = 7;
+    while(0 == (delta & (0x80 >> last)))
+    {
+        last--;
+    }
+
+    if(x + last < handle->width)
+    {
+        // The changed pixels are all in this row. Skip the padding at the end
+        // of the frame
+        if(y < handle->height)
+        {
+            markGifDirty(handle, x + first, y);
+            markGifDirty(handle, x + last, y);
+        }
+        return;
+    }
+
+    // The byte wraps onto the next row, so walk it a pixel at a time
+    uint8_t bit;
+    for(bit = 0; bit <= last; bit++)
+    {
+        if((delta & (0x80 >> bit)) && y < handle->height)
+        {
+            markGifDirty(handle, x, y);
+        }
+        if(++x == handle->width)
+        {
+            x = 0;
+            y++;
+        }
+    }
+}
+
+/**
+ * @brief Timer function to draw gifs. If the timer fell behind, the frames
+ * which were missed are decoded but not drawn, and the next drawn frame covers
+ * everything they changed
  *
  * @param arg A handle containing the gif state
  */
@@ -375,7 +1105,7 @@ void ICACHE_FLASH_ATTR gifTimerFn(void* arg)
 
     // Read the compressed length of this frame
     uint32_t compressedLen = handle->assetPtr[handle->idx++];
-    // Pad the length to a 32 bit boundary for memcpy
+    // Frames are padded to a 32 bit boundary
     uint32_t paddedLen = compressedLen;
     while(paddedLen % 4 != 0)
     {
@@ -384,27 +1114,44 @@ void ICACHE_FLASH_ATTR gifTimerFn(void* arg)
     AST_PRINTF("%s\n  frame: %d\n  cLen: %d\n  pLen: %d\n", __func__,
              handle->cFrame, compressedLen, paddedLen);
 
-    // Copy the compressed data from flash to RAM
-    os_memcpy(handle->compressed, &handle->assetPtr[handle->idx], paddedLen);
+    // The compressed data is decompressed straight from flash
+    const uint32_t* compressed = &handle->assetPtr[handle->idx];
     handle->idx += (paddedLen / 4);
 
     // If this is the first frame
     if(handle->cFrame == 0)
     {
         // Decompress it straight to the frame data
-        fastlz_decompress(handle->compressed, compressedLen,
-                          handle->frame, handle->allocedSize);
+        fastlz_decompress_flash(compressed, compressedLen,
+                                handle->frame, handle->allocedSize);
+        // The whole gif has to be drawn
+        markGifDirty(handle, 0, 0);
+        markGifDirty(handle, handle->width - 1, handle->height - 1);
     }
     else
     {
-        // Otherwise decompress it to decompressed
-        fastlz_decompress(handle->compressed, compressedLen,
-                          handle->decompressed, handle->allocedSize);
-        // Then apply the changes to the current frame
+        // Otherwise decompress the delta. It can't be XORed in place because
+        // the decompressor copies from bytes it already wrote
+        fastlz_decompress_flash(compressed, compressedLen,
+                                gifDeltaBuf, handle->allocedSize);
+        // Then apply the changes to the current frame, keeping track of the
+        // box which changed. x and y are where each byte's first pixel is
         uint16_t i;
+        uint16_t x = 0;
+        uint16_t y = 0;
         for(i = 0; i < handle->allocedSize; i++)
         {
-            handle->frame[i] ^= handle->decompressed[i];
+            if(0 != gifDeltaBuf[i])
+            {
+                handle->frame[i] ^= gifDeltaBuf[i];
+                markGifDelta(handle, x, y, gifDeltaBuf[i]);
+            }
+            x += 8;
+            while(x >= handle->width)
+            {
+                x -= handle->width;
+                y++;
+            }
         }
     }
 
@@ -416,27 +1163,87 @@ void ICACHE_FLASH_ATTR gifTimerFn(void* arg)
         handle->idx = 4;
     }
 
-    // Draw the current frame to the OLED
+    // If this function is about to be called again to catch up, don't bother
+    // drawing this frame
+    if(1 < handle->timer.shouldRunCnt)
+    {
+        return;
+    }
+
+    drawGifFrame(handle);
+}
+
+/**
+ * @brief Draw the part of the current gif frame in the dirty box to the OLED,
+ * then empty the dirty box
+ *
+ * @param handle A handle containing the gif state
+ */
+void ICACHE_FLASH_ATTR drawGifFrame(gifHandle* handle)
+{
+    if(handle->dirtyMinX > handle->dirtyMaxX)
+    {
+        // Nothing changed
+        return;
+    }
+
     int16_t h, w;
-    for(h = 0; h < handle->height; h++)
+    if(0 == handle->rotateDeg)
     {
-        for(w = 0; w < handle->width; w++)
+        // Without rotation, gather each column of the frame and blit it up to
+        // 32 rows at a time
+        for(w = handle->dirtyMinX; w <= handle->dirtyMaxX; w++)
         {
-            int16_t x = w;
-            int16_t y = h;
-            transformPixel(&x, &y, handle->xp, handle->yp, handle->flipLR,
-                           handle->flipUD, handle->rotateDeg,
-                           handle->width, handle->height);
-            int16_t byteIdx = (w + (h * handle->width)) / 8;
-            int16_t bitIdx  = (w + (h * handle->width)) % 8;
-            if(handle->frame[byteIdx] & (0x80 >> bitIdx))
+            int16_t x = handle->flipLR ? (handle->xp + handle->width - 1 - w) : (handle->xp + w);
+            for(h = handle->dirtyMinY; h <= handle->dirtyMaxY; h += 32)
             {
-                drawPixel(x, y, WHITE);
+                uint8_t n = (handle->dirtyMaxY + 1 - h) < 32 ? (handle->dirtyMaxY + 1 - h) : 32;
+                uint32_t bits = 0;
+                uint8_t i;
+                for(i = 0; i < n; i++)
+                {
+                    uint32_t pxIdx = w + ((h + i) * handle->width);
+                    if(handle->frame[pxIdx / 8] & (0x80 >> (pxIdx % 8)))
+                    {
+                        // Flipping upside down reverses the rows of the chunk
+                        bits |= (1u << (handle->flipUD ? (n - 1 - i) : i));
+                    }
+                }
+                int16_t y = handle->flipUD ? (handle->yp + handle->height - h - n) : (handle->yp + h);
+                uint32_t chunkMask = (32 == n) ? 0xFFFFFFFF : ((1u << n) - 1);
+                oledBlitColumn(x, y, bits, n, WHITE);
+                oledBlitColumn(x, y, ~bits & chunkMask, n, BLACK);
             }
-            else
+        }
+    }
+    else
+    {
+        pxTransform_t t;
+        prepareTransform(&t, handle->xp, handle->yp, handle->flipLR,
+                         handle->flipUD, handle->rotateDeg,
+                         handle->width, handle->height);
+        for(h = handle->dirtyMinY; h <= handle->dirtyMaxY; h++)
+        {
+            for(w = handle->dirtyMinX; w <= handle->dirtyMaxX; w++)
             {
-                drawPixel(x, y, BLACK);
+                int16_t x = w;
+                int16_t y = h;
+                applyTransform(&t, &x, &y);
+                int16_t byteIdx = (w + (h * handle->width)) / 8;
+                int16_t bitIdx  = (w + (h * handle->width)) % 8;
+                if(handle->frame[byteIdx] & (0x80 >> bitIdx))
+                {
+                    drawPixel(x, y, WHITE);
+                }
+                else
+                {
+                    drawPixel(x, y, BLACK);
+                }
             }
         }
     }
+
+    // Empty the dirty box
+    handle->dirtyMinX = 1;
+    handle->dirtyMaxX = 0;
 }
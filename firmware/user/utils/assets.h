@@ -3,13 +3,17 @@
 
 #include "synced_timer.h"
 
+typedef struct
+{
+    uint32_t* assetPtr;
+    uint32_t len;
+} assetHandle_t;
+
 typedef struct
 {
     uint32_t* assetPtr;
     uint32_t idx;
 
-    uint8_t* compressed;
-    uint8_t* decompressed;
     uint8_t* frame;
     uint32_t allocedSize;
 
@@ -25,12 +29,24 @@ typedef struct
     uint16_t cFrame;
     uint16_t duration;
     syncedTimer_t timer;
+
+    // The box of pixels which changed since the gif was last drawn.
+    // It is empty when dirtyMinX > dirtyMaxX
+    uint16_t dirtyMinX;
+    uint16_t dirtyMaxX;
+    uint16_t dirtyMinY;
+    uint16_t dirtyMaxY;
 } gifHandle;
 
 uint32_t* getAsset(const char* name, uint32_t* retLen);
+bool getAssetHandle(const char* name, assetHandle_t* handle);
 
 void drawBitmapFromAsset(const char* name, int16_t xp, int16_t yp,
                          bool flipLR, bool flipUD, int16_t rotateDeg);
+void drawBitmapFromHandle(const assetHandle_t* handle, int16_t xp, int16_t yp,
+                          bool flipLR, bool flipUD, int16_t rotateDeg);
+void setAssetRotationCache(uint32_t maxBytes, uint8_t angleStepDeg);
+uint32_t getAssetRotationCacheBytes(void);
 
 void drawGifFromAsset(const char* name, int16_t xp, int16_t yp,
                       bool flipLR, bool flipUD, int16_t rotateDeg,
@@ -87,6 +87,17 @@ typedef unsigned int   flzuint32;
 int fastlz_compress(const void* input, int length, void* output);
 int fastlz_compress_level(int level, const void* input, int length, void* output);
 int fastlz_decompress(const void* input, int length, void* output, int maxout);
+int fastlz_decompress_flash(const void* input, int length, void* output, int maxout);
+
+/*
+ * Memory mapped flash may only be read with aligned 32-bit loads, so pick the
+ * byte out of the word which holds it (little endian)
+ */
+static inline flzuint8 fastlz_flash_byte(const flzuint8* p)
+{
+    const flzuint32* word = (const flzuint32*)((size_t)p & ~((size_t)3));
+    return (flzuint8)((*word) >> (((size_t)p & 3) << 3));
+}
 
 #define MAX_COPY       32
 #define MAX_LEN       264  /* 256 + 8 */
@@ -108,12 +119,23 @@ int fastlz_decompress(const void* input, int length, void* output, int maxout);
 
 #undef FASTLZ_COMPRESSOR
 #undef FASTLZ_DECOMPRESSOR
+#undef FASTLZ_IN_BYTE
 #define FASTLZ_COMPRESSOR fastlz1_compress
 #define FASTLZ_DECOMPRESSOR fastlz1_decompress
+#define FASTLZ_IN_BYTE(p) (*(p))
 static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void* output);
 static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
 #include "fastlz.c"
 
+/* level 1 decompressor which reads its input from flash */
+#undef FASTLZ_COMPRESSOR
+#undef FASTLZ_DECOMPRESSOR
+#undef FASTLZ_IN_BYTE
+#define FASTLZ_DECOMPRESSOR fastlz1_decompress_flash
+#define FASTLZ_IN_BYTE(p) fastlz_flash_byte(p)
+static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
 #undef FASTLZ_LEVEL
 #define FASTLZ_LEVEL 2
 
@@ -123,12 +145,23 @@ static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void
 
 #undef FASTLZ_COMPRESSOR
 #undef FASTLZ_DECOMPRESSOR
+#undef FASTLZ_IN_BYTE
 #define FASTLZ_COMPRESSOR fastlz2_compress
 #define FASTLZ_DECOMPRESSOR fastlz2_decompress
+#define FASTLZ_IN_BYTE(p) (*(p))
 static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void* output);
 static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
 #include "fastlz.c"
 
+/* level 2 decompressor which reads its input from flash */
+#undef FASTLZ_COMPRESSOR
+#undef FASTLZ_DECOMPRESSOR
+#undef FASTLZ_IN_BYTE
+#define FASTLZ_DECOMPRESSOR fastlz2_decompress_flash
+#define FASTLZ_IN_BYTE(p) fastlz_flash_byte(p)
+static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
 int ICACHE_FLASH_ATTR fastlz_compress(const void* input, int length, void* output)
 {
     /* for short block, choose fastlz1 */
@@ -159,6 +192,24 @@ int ICACHE_FLASH_ATTR fastlz_decompress(const void* input, int length, void* out
     return 0;
 }
 
+int ICACHE_FLASH_ATTR fastlz_decompress_flash(const void* input, int length, void* output, int maxout)
+{
+    /* magic identifier for compression level */
+    int level = (fastlz_flash_byte((const flzuint8*)input) >> 5) + 1;
+
+    if(level == 1)
+    {
+        return fastlz1_decompress_flash(input, length, output, maxout);
+    }
+    if(level == 2)
+    {
+        return fastlz2_decompress_flash(input, length, output, maxout);
+    }
+
+    /* unknown level, trigger error */
+    return 0;
+}
+
 int ICACHE_FLASH_ATTR fastlz_compress_level(int level, const void* input, int length, void* output)
 {
     if(level == 1)
@@ -175,6 +226,7 @@ int ICACHE_FLASH_ATTR fastlz_compress_level(int level, const void* input, int le
 
 #else /* !defined(FASTLZ_COMPRESSOR) && !defined(FASTLZ_DECOMPRESSOR) */
 
+#if defined(FASTLZ_COMPRESSOR)
 static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_COMPRESSOR(const void* input, int length, void* output)
 {
     const flzuint8* ip = (const flzuint8*) input;
@@ -484,6 +536,7 @@ literal:
 
     return op - (flzuint8*)output;
 }
+#endif /* defined(FASTLZ_COMPRESSOR) */
 
 static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout)
 {
@@ -491,7 +544,7 @@ static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_DECOMPRESSOR(const void* input
     const flzuint8* ip_limit  = ip + length;
     flzuint8* op = (flzuint8*) output;
     flzuint8* op_limit = op + maxout;
-    flzuint32 ctrl = (*ip++) & 31;
+    flzuint32 ctrl = FASTLZ_IN_BYTE(ip++) & 31;
     int loop = 1;
 
     do
@@ -509,23 +562,23 @@ static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_DECOMPRESSOR(const void* input
             ref -= ofs;
             if (len == 7 - 1)
 #if FASTLZ_LEVEL==1
-                len += *ip++;
-            ref -= *ip++;
+                len += FASTLZ_IN_BYTE(ip++);
+            ref -= FASTLZ_IN_BYTE(ip++);
 #else
                 do
                 {
-                    code = *ip++;
+                    code = FASTLZ_IN_BYTE(ip++);
                     len += code;
                 } while (code == 255);
-            code = *ip++;
+            code = FASTLZ_IN_BYTE(ip++);
             ref -= code;
 
             /* match from 16-bit distance */
             if(FASTLZ_UNEXPECT_CONDITIONAL(code == 255))
                 if(FASTLZ_EXPECT_CONDITIONAL(ofs == (31 << 8)))
                 {
-                    ofs = (*ip++) << 8;
-                    ofs += *ip++;
+                    ofs = FASTLZ_IN_BYTE(ip++) << 8;
+                    ofs += FASTLZ_IN_BYTE(ip++);
                     ref = op - ofs - MAX_DISTANCE;
                 }
 #endif
@@ -544,7 +597,7 @@ static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_DECOMPRESSOR(const void* input
 
             if(FASTLZ_EXPECT_CONDITIONAL(ip < ip_limit))
             {
-                ctrl = *ip++;
+                ctrl = FASTLZ_IN_BYTE(ip++);
             }
             else
             {
@@ -620,16 +673,16 @@ static FASTLZ_INLINE int ICACHE_FLASH_ATTR FASTLZ_DECOMPRESSOR(const void* input
             }
 #endif
 
-            *op++ = *ip++;
+            *op++ = FASTLZ_IN_BYTE(ip++);
             for(--ctrl; ctrl; ctrl--)
             {
-                *op++ = *ip++;
+                *op++ = FASTLZ_IN_BYTE(ip++);
             }
 
             loop = FASTLZ_EXPECT_CONDITIONAL(ip < ip_limit);
             if(loop)
             {
-                ctrl = *ip++;
+                ctrl = FASTLZ_IN_BYTE(ip++);
             }
         }
     } while(FASTLZ_EXPECT_CONDITIONAL(loop));
@@ -69,6 +69,13 @@ int ICACHE_FLASH_ATTR fastlz_compress(const void* input, int length, void* outpu
 
 int ICACHE_FLASH_ATTR fastlz_decompress(const void* input, int length, void* output, int maxout);
 
+/**
+  Same as fastlz_decompress, but the input is read with aligned 32-bit loads,
+  so it may be read straight from memory mapped flash. The output must be RAM.
+*/
+
+int ICACHE_FLASH_ATTR fastlz_decompress_flash(const void* input, int length, void* output, int maxout);
+
 /**
   Compress a block of data in the input buffer and returns the size of
   compressed block. The size of input buffer is specified by length. The
@@ -1,7 +1,10 @@
 //Copyright 2015 <>< Charles Lohr under the ColorChord License.
-#include <osapi.h>
 #include "hsv_utils.h"
-#include "user_main.h"
+#ifdef ICACHE_FLASH
+    #include "user_main.h" //For RODATA_ATTR
+#else
+    #define RODATA_ATTR
+#endif
 
 uint8_t ICACHE_FLASH_ATTR GAMMA_CORRECT(uint8_t val)
 {
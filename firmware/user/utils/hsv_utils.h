@@ -3,6 +3,17 @@
 #ifndef _hsv_utils_H
 #define _hsv_utils_H
 
+#ifdef ICACHE_FLASH
+    #include <c_types.h> //If on ESP8266
+#else
+    //So ColorChord's output can be built and run on a PC
+    #include <stdint.h>
+    #include <stdbool.h>
+    #ifndef ICACHE_FLASH_ATTR
+        #define ICACHE_FLASH_ATTR
+    #endif
+#endif
+
 uint32_t ICACHE_FLASH_ATTR EHSVtoHEXhelper( uint8_t hue, uint8_t sat, uint8_t val, bool applyGamma );
 uint32_t EHSVtoHEX( uint8_t hue, uint8_t sat, uint8_t val ); //hue = 0..255 // TODO: TEST ME!!!
 uint8_t ICACHE_FLASH_ATTR GAMMA_CORRECT(uint8_t val);
@@ -3,48 +3,217 @@
  *----------------------------------------------------------------------------*/
 
 #include "synced_timer.h"
-#include "linked_list.h"
+#include "user_interface.h"
+#include "printControl.h"
 
 // #define debugTmr(t) os_printf("%s::%d -- %p: armed %s, repeat %s, src %d\n", __func__, __LINE__, t, t->isArmed?"true":"false", t->isRepeat?"true":"false", t->shouldRunCnt)
 #define debugTmr(t)
 
+/*------------------------------------------------------------------------------
+ * Structs
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t deadline; // system_get_time() when the timer is due
+    syncedTimer_t* timer;
+} timerHeapEntry_t;
+
 /*------------------------------------------------------------------------------
  * Function Prototypes
  *----------------------------------------------------------------------------*/
 
-static void ICACHE_FLASH_ATTR incShouldRun(void* arg);
+static inline bool isBefore(uint32_t a, uint32_t b);
+static bool ICACHE_FLASH_ATTR isInHeap(syncedTimer_t* timer);
+static void ICACHE_FLASH_ATTR moveEntry(uint8_t from, uint8_t to);
+static void ICACHE_FLASH_ATTR siftUp(uint8_t idx);
+static void ICACHE_FLASH_ATTR siftDown(uint8_t idx);
+static void ICACHE_FLASH_ATTR removeEntry(uint8_t idx);
+static void ICACHE_FLASH_ATTR updateStats(syncedTimerStats_t* stats,
+        uint32_t deadline, uint32_t start, uint32_t runUs);
+static void ICACHE_FLASH_ATTR fillSnapshot(syncedTimer_t* timer,
+        syncedTimerSnapshot_t* record);
 
 /*------------------------------------------------------------------------------
  * Variables
  *----------------------------------------------------------------------------*/
 
-static list_t syncedTimerList = {0};
+// Armed timers in a min-heap ordered by deadline, so only the first entry has
+// to be looked at to know if anything is due. The deadline is kept here rather
+// than in the timer, so a timer zeroed without being disarmed can't break the
+// heap's order. Its entry is just dropped when it comes due
+static timerHeapEntry_t timerHeap[SYNCED_TIMER_MAX_SLOTS] = {{0}};
+static uint8_t timerHeapLen = 0;
 
 /*------------------------------------------------------------------------------
  * Functions
  *----------------------------------------------------------------------------*/
 
 /**
- * Internal function which is used as the actual timer function for os_timer.
- * All this does is is increment a count to run the actual timer function, which
- * is done in syncedTimersCheck().
+ * Compare two times from system_get_time(), which wraps about every 71
+ * minutes. Times must be within about 35 minutes of each other
  *
- * os_timers should be quick, so this allows us to register slow functions to
- * timers
+ * @param a A time
+ * @param b Another time
+ * @return true if a is before b
+ */
+static inline bool isBefore(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/**
+ * Check if a timer is in the heap. The timer's own index isn't trusted alone,
+ * since timers are often zeroed or reused without being disarmed first
  *
- * @param arg A pointer to the syncedTimer
+ * @param timer The timer struct
+ * @return true if the heap entry the timer points to points back to it
  */
-static void ICACHE_FLASH_ATTR incShouldRun(void* arg)
+static bool ICACHE_FLASH_ATTR isInHeap(syncedTimer_t* timer)
 {
-    debugTmr(((syncedTimer_t*)arg));
-    ((syncedTimer_t*)arg)->shouldRunCnt++;
+    return (0 < timer->slot) && (timer->slot <= timerHeapLen) &&
+           (timer == timerHeap[timer->slot - 1].timer);
 }
 
 /**
- * Set timer callback function. The timer callback function must be set before
- * arming a timer.
+ * Move a heap entry, and follow it with the timer's index if the entry is
+ * still the timer's. Stale entries leave the timer alone
+ *
+ * @param from The index of the entry to move
+ * @param to   The index to move it to
+ */
+static void ICACHE_FLASH_ATTR moveEntry(uint8_t from, uint8_t to)
+{
+    timerHeap[to] = timerHeap[from];
+    if(timerHeap[to].timer->slot == from + 1)
+    {
+        timerHeap[to].timer->slot = to + 1;
+    }
+}
+
+/**
+ * Move an entry towards the top of the heap until its parent is due first
+ *
+ * @param idx The index of the entry
+ */
+static void ICACHE_FLASH_ATTR siftUp(uint8_t idx)
+{
+    timerHeapEntry_t entry = timerHeap[idx];
+    bool owned = (entry.timer->slot == idx + 1);
+
+    while(0 < idx)
+    {
+        uint8_t parent = (idx - 1) / 2;
+        if(false == isBefore(entry.deadline, timerHeap[parent].deadline))
+        {
+            break;
+        }
+        moveEntry(parent, idx);
+        idx = parent;
+    }
+
+    timerHeap[idx] = entry;
+    if(owned)
+    {
+        entry.timer->slot = idx + 1;
+    }
+}
+
+/**
+ * Move an entry towards the bottom of the heap until its children are due
+ * after it
+ *
+ * @param idx The index of the entry
+ */
+static void ICACHE_FLASH_ATTR siftDown(uint8_t idx)
+{
+    timerHeapEntry_t entry = timerHeap[idx];
+    bool owned = (entry.timer->slot == idx + 1);
+
+    while(true)
+    {
+        uint8_t child = (2 * idx) + 1;
+        if(child >= timerHeapLen)
+        {
+            break;
+        }
+        // Pick the child which is due first
+        if(child + 1 < timerHeapLen &&
+                isBefore(timerHeap[child + 1].deadline, timerHeap[child].deadline))
+        {
+            child++;
+        }
+        if(false == isBefore(timerHeap[child].deadline, entry.deadline))
+        {
+            break;
+        }
+        moveEntry(child, idx);
+        idx = child;
+    }
+
+    timerHeap[idx] = entry;
+    if(owned)
+    {
+        entry.timer->slot = idx + 1;
+    }
+}
+
+/**
+ * Remove an entry from the heap. If it was the timer's entry, the timer is
+ * marked as not in the heap
  *
- * This is a wrapper for os_timer_setfn().
+ * @param idx The index of the entry to remove
+ */
+static void ICACHE_FLASH_ATTR removeEntry(uint8_t idx)
+{
+    if(timerHeap[idx].timer->slot == idx + 1)
+    {
+        timerHeap[idx].timer->slot = 0;
+    }
+
+    // Fill the hole with the last entry, then put that where it belongs
+    timerHeapLen--;
+    if(idx != timerHeapLen)
+    {
+        moveEntry(timerHeapLen, idx);
+        siftDown(idx);
+        siftUp(idx);
+    }
+}
+
+/**
+ * Record one call of a timer's function
+ *
+ * @param stats    The timer's stats
+ * @param deadline When the timer was due
+ * @param start    When the function was called
+ * @param runUs    How long the function took
+ */
+static void ICACHE_FLASH_ATTR updateStats(syncedTimerStats_t* stats,
+        uint32_t deadline, uint32_t start, uint32_t runUs)
+{
+    uint32_t lateUs = start - deadline;
+    if(lateUs > stats->maxLateUs)
+    {
+        stats->maxLateUs = lateUs;
+    }
+    if(0 == stats->calls || runUs < stats->minRunUs)
+    {
+        stats->minRunUs = runUs;
+    }
+    if(runUs > stats->maxRunUs)
+    {
+        stats->maxRunUs = runUs;
+    }
+    stats->lastDeadline = deadline;
+    stats->lastCalled = start;
+    stats->totalRunUs += runUs;
+    stats->calls++;
+}
+
+/**
+ * Set timer callback function. The timer callback function must be set before
+ * arming a timer. This disarms the timer
  *
  * @param timer     The timer struct
  * @param timerFunc The timer callback function
@@ -53,139 +222,278 @@ static void ICACHE_FLASH_ATTR incShouldRun(void* arg)
 void ICACHE_FLASH_ATTR syncedTimerSetFn(syncedTimer_t* timer,
                                         os_timer_func_t* timerFunc, void* arg)
 {
-    // os_timer_setfn() can only be invoked when the timer is not enabled, i.e.,
-    // after os_timer_disarm() or before os_timer_arm(), so call os_timer_disarm
-    os_timer_disarm(&(timer->osTimer));
+    // The timer may be armed, or may be garbage, isInHeap() handles both
+    if(isInHeap(timer))
+    {
+        removeEntry(timer->slot - 1);
+    }
 
     // Save the function parameters
     timer->timerFunc = timerFunc;
     timer->arg = arg;
 
-    // Zero out the variables
+    // Zero out the variables, the stats are for the old function
+    ets_memset(&(timer->stats), 0, sizeof(timer->stats));
+    timer->armedBy = NULL;
+    timer->period = 0;
     timer->shouldRunCnt = 0;
     timer->isArmed = false;
     timer->isRepeat = false;
-    ets_memset(&(timer->osTimer), 0, sizeof(os_timer_t));
-
-    // Set the timer function
-    os_timer_setfn(&(timer->osTimer), incShouldRun, timer);
+    timer->slot = 0;
 }
 
 /**
- * Arm a timer callback function to be called at some time or interval.
- * This is a wrapper for os_timer_arm();
+ * Arm a timer callback function to be called at some time or interval. If the
+ * timer is already armed, it is rescheduled
+ *
+ * Repeating timers are scheduled from their last deadline, not from when they
+ * were called, so they don't drift
+ *
+ * This is called through the syncedTimerArm() macro, which passes the name of
+ * the calling function
  *
  * @param timer       The timer struct
  * @param time        The number of milliseconds to call this timer in
  * @param repeat_flag true to have this timer repeat, false to have it run once
+ * @param armedBy     The name of the function arming the timer, for the stats
  */
-void ICACHE_FLASH_ATTR syncedTimerArm(syncedTimer_t* timer, uint32_t time,
-                                      bool repeat_flag)
+void ICACHE_FLASH_ATTR syncedTimerArmFrom(syncedTimer_t* timer, uint32_t time,
+        bool repeat_flag, const char* armedBy)
 {
-    // For the same timer, os_timer_arm() cannot be invoked repeatedly.
-    // os_timer_disarm() should be invoked first, so call os_timer_disarm()
-    os_timer_disarm(&(timer->osTimer));
-
-    // Then arm it with the parameters
-    os_timer_arm(&(timer->osTimer), time, repeat_flag);
+    timer->armedBy = armedBy;
+    timer->period = (0 < time) ? (time * 1000) : 1;
     timer->isArmed = true;
     timer->isRepeat = repeat_flag;
+    timer->shouldRunCnt = 0;
 
     debugTmr(timer);
 
-    // Check to see if this timer is in the list already
-    node_t* currentNode = syncedTimerList.first;
-    while (currentNode != NULL)
+    uint32_t deadline = system_get_time() + timer->period;
+
+    // If this timer is already in the heap, move it to the new deadline
+    if(isInHeap(timer))
     {
-        if(currentNode->val == timer)
-        {
-            // Already in the list, so return
-            return;
-        }
-        currentNode = currentNode->next;
+        uint8_t idx = timer->slot - 1;
+        timerHeap[idx].deadline = deadline;
+        siftDown(idx);
+        siftUp(timer->slot - 1);
+        return;
     }
 
-    // If it isn't in the list, push it into the list
-    push(&syncedTimerList, (void*)timer);
+    // Otherwise add it
+    if(timerHeapLen >= SYNCED_TIMER_MAX_SLOTS)
+    {
+        // No room, so don't leave it armed where it would never be called
+        TIME_PRINTF("No slot for timer %p\n", timer);
+        syncedTimerDisarm(timer);
+        return;
+    }
+    timerHeap[timerHeapLen].deadline = deadline;
+    timerHeap[timerHeapLen].timer = timer;
+    timer->slot = ++timerHeapLen;
+    siftUp(timerHeapLen - 1);
 }
 
 /**
  * Disarm a timer.
  *
- * This is a wrapper for os_timer_disarm()
- *
  * @param timer The timer struct
  */
 void ICACHE_FLASH_ATTR syncedTimerDisarm(syncedTimer_t* timer)
 {
     // Disarm the timer
-    os_timer_disarm(&(timer->osTimer));
     timer->isArmed = false;
     timer->isRepeat = false;
     // And make sure the function isn't called again
     timer->shouldRunCnt = 0;
-    // This will get removed from the list in syncedTimersCheck()
+    if(isInHeap(timer))
+    {
+        removeEntry(timer->slot - 1);
+    }
     debugTmr(timer);
 }
 
 /**
- * Check each synced timer and call it's respective function as many times as
- * necessary.
+ * Call the function of each timer which is due, as many times as it's due.
+ * Only the first entry of the heap is looked at when nothing is due.
  *
  * This must be called from procTask(), where functions can run for long times
  * without disrupting the system.
  */
 void ICACHE_FLASH_ATTR syncedTimersCheck(void)
 {
-    // For each timer, call the function if it's time
-    node_t* currentNode = syncedTimerList.first;
-    while (currentNode != NULL)
+    syncedTimersCheckBudgeted(0);
+}
+
+/**
+ * Call the function of each timer which is due, like syncedTimersCheck(), but
+ * don't start another function once maxUs has gone by. Timers which didn't get
+ * to run are still due on the next call, and count as late.
+ *
+ * @param maxUs The time to stop starting timer functions after, 0 for no limit
+ */
+void ICACHE_FLASH_ATTR syncedTimersCheckBudgeted(uint32_t maxUs)
+{
+    uint32_t now = system_get_time();
+
+    // Timers armed by these functions are due a whole period after now, so
+    // this can't loop forever
+    while(0 < timerHeapLen && isBefore(timerHeap[0].deadline, now))
     {
-        syncedTimer_t* timer = (syncedTimer_t*) currentNode->val;
+        if(0 != maxUs && (system_get_time() - now) >= maxUs)
+        {
+            break;
+        }
+
+        syncedTimer_t* timer = timerHeap[0].timer;
+
+        // If the timer was zeroed or disarmed without being removed, the entry
+        // is stale
+        if(1 != timer->slot || false == timer->isArmed)
+        {
+            removeEntry(0);
+            continue;
+        }
 
-        // For as many times as the function should be called
-        while(0 < timer->shouldRunCnt)
+        uint32_t deadline = timerHeap[0].deadline;
+        if(timer->isRepeat)
         {
-            debugTmr(timer);
-            // Call the function if it's still armed
-            if(true == timer->isArmed)
+            // Count how many periods were missed, skipping any past the limit
+            uint32_t due = ((now - timerHeap[0].deadline) / timer->period) + 1;
+            if(due > SYNCED_TIMER_MAX_CATCH_UP)
             {
-                // If this is not a repeating timer, mark it disarmed
-                if(false == timer->isRepeat)
-                {
-                    timer->isArmed = false;
-                }
-                // Then call the timer function, this may rearm the timer
-                timer->timerFunc(timer->arg);
-                debugTmr(timer);
+                timerHeap[0].deadline += (due - SYNCED_TIMER_MAX_CATCH_UP) * timer->period;
+                timer->stats.skipped += due - SYNCED_TIMER_MAX_CATCH_UP;
+                due = SYNCED_TIMER_MAX_CATCH_UP;
             }
-
-            // Decrement, making sure not to underflow
-            if(0 < timer->shouldRunCnt)
+            timer->shouldRunCnt = due;
+            if(1 < due)
             {
-                timer->shouldRunCnt--;
+                timer->stats.catchUps++;
             }
+
+            // Schedule the next call from this deadline, not from now
+            timerHeap[0].deadline += timer->period;
+            siftDown(0);
+        }
+        else
+        {
+            timer->shouldRunCnt = 1;
+            timer->isArmed = false;
+            removeEntry(0);
         }
 
-        // Iterate to the next timer
-        currentNode = currentNode->next;
+        // Then call the timer function, this may rearm or disarm any timer
+        debugTmr(timer);
+        uint32_t start = system_get_time();
+        timer->timerFunc(timer->arg);
+        updateStats(&(timer->stats), deadline, start, system_get_time() - start);
     }
+}
 
-    // After the functions have been called, remove disarmed timers from the list
-    currentNode = syncedTimerList.first;
-    while (currentNode != NULL)
+/**
+ * Find how long until the next timer is due. Nothing needs to run before then
+ * for the timers' sake
+ *
+ * @return Microseconds until the earliest deadline, 0 if a timer is already
+ *         due, or SYNCED_TIMER_NO_DEADLINE if no timer is armed
+ */
+uint32_t ICACHE_FLASH_ATTR syncedTimersUsUntilNextDeadline(void)
+{
+    if(0 == timerHeapLen)
+    {
+        return SYNCED_TIMER_NO_DEADLINE;
+    }
+
+    uint32_t now = system_get_time();
+    if(isBefore(timerHeap[0].deadline, now))
+    {
+        return 0;
+    }
+    return timerHeap[0].deadline - now;
+}
+
+/**
+ * Reset the stats of every armed timer
+ */
+void ICACHE_FLASH_ATTR syncedTimersResetStats(void)
+{
+    uint8_t idx;
+    for(idx = 0; idx < timerHeapLen; idx++)
+    {
+        if(timerHeap[idx].timer->slot == idx + 1)
+        {
+            ets_memset(&(timerHeap[idx].timer->stats), 0, sizeof(syncedTimerStats_t));
+        }
+    }
+}
+
+/**
+ * Print the stats of every armed timer with TIME_PRINTF(), one line each
+ */
+void ICACHE_FLASH_ATTR syncedTimersDumpStats(void)
+{
+    syncedTimerSnapshot_t record;
+    uint8_t idx;
+    TIME_PRINTF("%d timers: name period calls catchups skipped maxlate run min/avg/max (us)\n",
+                timerHeapLen);
+    for(idx = 0; idx < timerHeapLen; idx++)
     {
-        // Save the next node because currentNode may be freed below
-        node_t* next = currentNode->next;
+        if(timerHeap[idx].timer->slot == idx + 1)
+        {
+            fillSnapshot(timerHeap[idx].timer, &record);
+            TIME_PRINTF("%s %d %d %d %d %d %d/%d/%d\n", record.name,
+                        record.periodUs, record.calls, record.catchUps,
+                        record.skipped, record.maxLateUs, record.minRunUs,
+                        record.avgRunUs, record.maxRunUs);
+        }
+    }
+}
 
-        // If the timer isn't armed anymore
-        if(false == (((syncedTimer_t*) currentNode->val))->isArmed)
+/**
+ * Copy the stats of every armed timer into records which can be sent as-is to
+ * a PC
+ *
+ * @param records    The records to fill
+ * @param maxRecords The number of records there is room for
+ * @return The number of records filled
+ */
+uint8_t ICACHE_FLASH_ATTR syncedTimersSnapshot(syncedTimerSnapshot_t* records,
+        uint8_t maxRecords)
+{
+    uint8_t numRecords = 0;
+    uint8_t idx;
+    for(idx = 0; idx < timerHeapLen && numRecords < maxRecords; idx++)
+    {
+        if(timerHeap[idx].timer->slot == idx + 1)
         {
-            // Remove it from the list
-            removeEntry(&syncedTimerList, currentNode);
+            fillSnapshot(timerHeap[idx].timer, &records[numRecords++]);
         }
+    }
+    return numRecords;
+}
 
-        // Iterate!
-        currentNode = next;
+/**
+ * Fill a snapshot record from a timer
+ *
+ * @param timer  The timer struct
+ * @param record The record to fill
+ */
+static void ICACHE_FLASH_ATTR fillSnapshot(syncedTimer_t* timer,
+        syncedTimerSnapshot_t* record)
+{
+    ets_memset(record, 0, sizeof(syncedTimerSnapshot_t));
+    if(NULL != timer->armedBy)
+    {
+        ets_strncpy(record->name, timer->armedBy, SYNCED_TIMER_NAME_LEN - 1);
     }
+    record->periodUs = timer->isRepeat ? timer->period : 0;
+    record->maxLateUs = timer->stats.maxLateUs;
+    record->calls = timer->stats.calls;
+    record->catchUps = timer->stats.catchUps;
+    record->skipped = timer->stats.skipped;
+    record->minRunUs = timer->stats.minRunUs;
+    record->avgRunUs = (0 < timer->stats.calls) ?
+                       (timer->stats.totalRunUs / timer->stats.calls) : 0;
+    record->maxRunUs = timer->stats.maxRunUs;
 }
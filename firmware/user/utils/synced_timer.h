@@ -3,19 +3,74 @@
 
 #include "osapi.h"
 
+// The most timers which may be armed at once
+#define SYNCED_TIMER_MAX_SLOTS 32
+
+// A repeating timer which falls further behind than this many periods skips
+// the extra calls rather than catching up on all of them
+#define SYNCED_TIMER_MAX_CATCH_UP 16
+
+// Returned by syncedTimersUsUntilNextDeadline() when no timer is armed
+#define SYNCED_TIMER_NO_DEADLINE 0xFFFFFFFF
+
+// The longest name kept in a syncedTimerSnapshot_t, including the terminator
+#define SYNCED_TIMER_NAME_LEN 24
+
+typedef struct
+{
+    uint32_t lastDeadline; // When the timer was last due, from system_get_time()
+    uint32_t lastCalled;   // When its function was last called
+    uint32_t maxLateUs;    // The latest the function has been called
+    uint32_t calls;        // Times the function was called
+    uint32_t catchUps;     // Calls made back to back because the timer fell behind
+    uint32_t skipped;      // Calls skipped for being more than SYNCED_TIMER_MAX_CATCH_UP behind
+    uint32_t minRunUs;     // The shortest time the function took
+    uint32_t maxRunUs;     // The longest time the function took
+    uint32_t totalRunUs;   // The total time the function took, for the average
+} syncedTimerStats_t;
+
+// One timer's stats as plain little endian data, to be read on a PC
+typedef struct __attribute__((packed))
+{
+    char name[SYNCED_TIMER_NAME_LEN]; // The function which armed the timer
+    uint32_t periodUs;
+    uint32_t maxLateUs;
+    uint32_t calls;
+    uint32_t catchUps;
+    uint32_t skipped;
+    uint32_t minRunUs;
+    uint32_t avgRunUs;
+    uint32_t maxRunUs;
+} syncedTimerSnapshot_t;
+
 typedef struct
 {
-    os_timer_t osTimer;
+    uint32_t period; // Microseconds between calls of a repeating timer
+    // While the timer function runs, how many calls are due, including this
+    // one. More than 1 means the timer fell behind and will be called again
     uint8_t shouldRunCnt;
     os_timer_func_t* timerFunc;
     void* arg;
     bool isArmed;
     bool isRepeat;
+    uint8_t slot; // One more than the timer's index in the deadline heap, 0 if none
+    const char* armedBy; // The function which last armed the timer
+    syncedTimerStats_t stats;
 } syncedTimer_t;
 
 void syncedTimerDisarm(syncedTimer_t* timer);
 void syncedTimersCheck(void);
-void syncedTimerArm(syncedTimer_t* timer, uint32_t time, bool repeat_flag);
+void syncedTimersCheckBudgeted(uint32_t maxUs);
+void syncedTimerArmFrom(syncedTimer_t* timer, uint32_t time, bool repeat_flag,
+                        const char* armedBy);
 void syncedTimerSetFn(syncedTimer_t* newTimer, void (*timerFunc)(void*), void* arg);
+uint32_t syncedTimersUsUntilNextDeadline(void);
+void syncedTimersResetStats(void);
+void syncedTimersDumpStats(void);
+uint8_t syncedTimersSnapshot(syncedTimerSnapshot_t* records, uint8_t maxRecords);
+
+// Arm a timer, remembering the function which armed it for the stats
+#define syncedTimerArm(timer, time, repeat_flag) \
+    syncedTimerArmFrom(timer, time, repeat_flag, __func__)
 
-#endif
\ No newline at end of file
+#endif